@@ -0,0 +1,16 @@
+#CHECK_SHM([action-if-found], [action-if-not-found])
+# --------------------------------------------------------
+# check if POSIX shared memory support is wanted.
+AC_DEFUN([CHECK_SHM], [
+    AC_ARG_WITH([shm],
+       [AS_HELP_STRING([--with-shm],
+         [Map the symmetric heap of on-node peers using POSIX shared memory, invalid with XPMEM or CMA (default: no)])])
+
+    shm_happy="no"
+    if test "$with_shm" = "yes" ; then
+        AC_CHECK_HEADER([sys/mman.h],
+            [AC_SEARCH_LIBS([shm_open], [rt],
+                [shm_happy="yes"])])
+    fi
+    AS_IF([test "$shm_happy" = "yes"], [$1], [$2])
+])
@@ -22,9 +22,41 @@ typedef struct {
     uint64_t target;
 } shmemx_pcntr_t;
 
+/* Time spent waiting for completion or synchronization, by wait mode */
+typedef struct {
+    uint64_t spin_ns;
+    uint64_t yield_ns;
+    uint64_t block_ns;
+    uint64_t count;
+} shmemx_pcntr_wait_t;
+
 #define SHMEMX_EXTERNAL_HEAP_ZE 0
 #define SHMEMX_EXTERNAL_HEAP_CUDA 1
 
+/* Symmetric memory spaces */
+typedef struct {
+    size_t sheap_size;      /* Usable size of the space in bytes */
+    size_t page_size;       /* Backing page size, 0 for the system page size */
+    int    numa_bind;       /* Bind to the NUMA node(s) local to the PE */
+} shmemx_space_config_t;
+
+typedef int shmemx_space_t;
+
+#define SHMEMX_SPACE_INVALID (-1)
+
+/* Usage of the symmetric heap and memory spaces of the calling PE, see
+ * shmemx_heap_stats */
+typedef struct {
+    size_t heap_size;       /* Bytes the heap may grow to */
+    size_t footprint;       /* Bytes currently obtained by the allocator */
+    size_t high_water;      /* Largest footprint since initialization */
+    size_t in_use;          /* Bytes held by live objects */
+    size_t free_bytes;      /* Bytes available without growing the footprint */
+    size_t largest_free;    /* Largest free block, including room to grow */
+    size_t overhead;        /* Allocator headers and unused slab slots */
+    size_t num_allocs;      /* Number of live objects */
+} shmemx_heap_stats_t;
+
 #if SHMEM_HAVE_ATTRIBUTE_VISIBILITY == 1
     __attribute__((visibility("default"))) extern shmem_team_t SHMEMX_TEAM_NODE;
 #else
@@ -1499,7 +1499,8 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
      * of the best communication schedule for the resulting doubly-nested
      * all-to-all.  It may be preferable in some scenarios to exchange the
      * loops below to spread out the communication and decrease the exposure to
-     * incast.
+     * incast.  Peers reachable through CMA receive each strided block in
+     * vectored transfers (see shmem_internal_iput).
      */
 
     /* Send data round-robin, ending with my PE */
@@ -1508,18 +1509,12 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
                                                  PE_size);
     peer = start_pe;
     do {
-        size_t i;
         int peer_as_rank    = (peer - PE_start) / PE_stride; /* Peer's index in active set */
-        uint8_t *dest_ptr   = (uint8_t *) dest_base;
         uint8_t *source_ptr = (uint8_t *) source + peer_as_rank * nelems * sst * elem_size;
 
-        for (i = nelems ; i > 0; i--) {
-            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, (void *) dest_ptr, (uint8_t *) source_ptr,
-                                     elem_size, peer);
-
-            source_ptr += sst * elem_size;
-            dest_ptr   += dst * elem_size;
-        }
+        shmem_internal_iput(SHMEM_CTX_DEFAULT, (void *) dest_base, source_ptr,
+                            dst * elem_size, sst * elem_size, elem_size,
+                            nelems, peer);
         peer = shmem_internal_circular_iter_next(peer, PE_start, PE_stride,
                                                  PE_size);
     } while (peer != start_pe);
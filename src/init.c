@@ -37,6 +37,8 @@
 #include "runtime.h"
 #include "build_info.h"
 #include "shmem_team.h"
+#include "shmem_wait.h"
+#include "shmem_lock.h"
 
 #if defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING) && defined(__linux__)
 #include <sys/personality.h>
@@ -77,6 +79,7 @@ static vm_address_t get_base_address(mach_port_t task, size_t *region_size, void
 
 void *shmem_internal_heap_base = NULL;
 long shmem_internal_heap_length = 0;
+long shmem_internal_heap_reserve = 0;
 void *shmem_internal_data_base = NULL;
 long shmem_internal_data_length = 0;
 
@@ -96,6 +99,11 @@ int shmem_internal_global_exit_called = 0;
 
 int shmem_internal_thread_level;
 
+#ifdef USE_ON_NODE_COMMS
+size_t shmem_internal_shr_put_max = SIZE_MAX;
+size_t shmem_internal_shr_get_max = SIZE_MAX;
+#endif
+
 unsigned int shmem_internal_rand_seed;
 
 #ifdef USE_HWLOC
@@ -105,31 +113,232 @@ hwloc_topology_t shmem_internal_topology;
 
 #ifdef ENABLE_THREADS
 shmem_internal_mutex_t shmem_internal_mutex_alloc;
-shmem_internal_mutex_t shmem_internal_mutex_rand_r;
+shmem_internal_mutex_t shmem_internal_mutex_runtime;
 #endif
 
 static char *shmem_internal_thread_level_str[4] = { "SINGLE", "FUNNELED",
                                                     "SERIALIZED", "MULTIPLE" };
 
+int shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_AUTO;
+uint64_t shmem_internal_wait_spin_ns;
+uint64_t shmem_internal_wait_yield_ns;
+shmem_internal_wait_state_t shmem_internal_sync_wait_state;
+
 static void
-shmem_internal_randr_init(void)
+shmem_internal_wait_init(void)
 {
-    shmem_internal_rand_seed = shmem_internal_my_pe;
+    char *type = shmem_internal_params.WAIT_POLICY;
+
+    if (0 == strcmp(type, "auto")) {
+        shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_AUTO;
+    } else if (0 == strcmp(type, "spin")) {
+        shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_SPIN;
+    } else if (0 == strcmp(type, "block")) {
+        shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_BLOCK;
+    } else if (0 == strcmp(type, "adaptive")) {
+        shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_ADAPTIVE;
+    } else {
+        RAISE_WARN_MSG("Ignoring bad wait policy '%s'\n", type);
+        shmem_internal_wait_policy = SHMEM_INTERNAL_WAIT_POLICY_AUTO;
+    }
 
-#ifdef ENABLE_THREADS
-    SHMEM_MUTEX_INIT(shmem_internal_mutex_rand_r);
-#endif
+    if (shmem_internal_params.WAIT_SPIN_USEC < 0 ||
+        shmem_internal_params.WAIT_YIELD_USEC < 0) {
+        RAISE_WARN_STR("Ignoring negative wait policy spin/yield time");
+        shmem_internal_params.WAIT_SPIN_USEC = 20;
+        shmem_internal_params.WAIT_YIELD_USEC = 200;
+    }
 
-    return;
+    shmem_internal_wait_spin_ns  = (uint64_t) shmem_internal_params.WAIT_SPIN_USEC * 1000;
+    shmem_internal_wait_yield_ns = (uint64_t) shmem_internal_params.WAIT_YIELD_USEC * 1000;
+
+    shmem_internal_wait_state_init(&shmem_internal_sync_wait_state);
+}
+
+#if defined(USE_ON_NODE_COMMS) && (defined(USE_OFI) || defined(USE_PORTALS4) || defined(USE_UCX))
+#define SHMEM_INTERNAL_CALIBRATE_ONNODE 1
+
+/* Calibration sweeps powers of two in [MIN, MAX] bytes */
+#define CALIBRATE_MIN_SIZE 256
+#define CALIBRATE_MAX_SIZE (4 * 1024 * 1024)
+#define CALIBRATE_REPS 3
+/* Additional measurements taken at a size where the network transport first
+ * appears faster, before the crossover is accepted */
+#define CALIBRATE_RETRIES 4
+/* Lowest crossover accepted for transports without a static threshold */
+#define CALIBRATE_FLOOR_SIZE (8 * 1024)
+
+/* Time iters transfers of size bytes to peer over the shared memory
+ * transport (shr != 0) or the network transport */
+static double
+shmem_internal_calibrate_time(char *remote, char *local, size_t size, int iters,
+                              int peer, int put, int shr)
+{
+    shmem_transport_ctx_t *tctx = SHMEM_TRANSPORT_CTX(SHMEM_CTX_DEFAULT);
+    double start, best = -1.0;
+    int i, rep;
+
+    for (rep = 0; rep < CALIBRATE_REPS; rep++) {
+        start = shmem_internal_wtime();
+        for (i = 0; i < iters; i++) {
+            if (put && shr)
+                shmem_shr_transport_put(SHMEM_CTX_DEFAULT, remote, local, size, peer);
+            else if (put)
+                shmem_transport_put_nbi(tctx, remote, local, size, peer);
+            else if (shr)
+                shmem_shr_transport_get(SHMEM_CTX_DEFAULT, local, remote, size, peer);
+            else
+                shmem_transport_get(tctx, local, remote, size, peer);
+        }
+        if (!shr) {
+            if (put)
+                shmem_transport_quiet(tctx);
+            else
+                shmem_transport_get_wait(tctx);
+        }
+        if (best < 0 || shmem_internal_wtime() - start < best)
+            best = shmem_internal_wtime() - start;
+    }
+
+    return best;
 }
 
+
+/* Return the largest transfer size for which the shared memory transport
+ * is faster than the network transport, SIZE_MAX if it always is.  Results
+ * below floor are raised to it, since a single noisy measurement at a small
+ * size would otherwise disable the on-node path. */
+static size_t
+shmem_internal_calibrate_crossover(char *buf, int peer, int put, size_t floor)
+{
+    char *local = buf + CALIBRATE_MAX_SIZE;
+    size_t size, crossover = 0;
+    double t_shr, t_nic, t;
+    int iters, i;
+
+    for (size = CALIBRATE_MIN_SIZE; size <= CALIBRATE_MAX_SIZE; size *= 2) {
+        iters = (int) (CALIBRATE_MAX_SIZE / size);
+        if (iters > 1000) iters = 1000;
+        if (iters < 4) iters = 4;
+
+        t_shr = shmem_internal_calibrate_time(buf, local, size, iters, peer, put, 1);
+        t_nic = shmem_internal_calibrate_time(buf, local, size, iters, peer, put, 0);
+
+        DEBUG_MSG("Calibrate %s %zuB: shr %.2f us, nic %.2f us\n", put ? "put" : "get",
+                  size, t_shr / iters * 1.0e6, t_nic / iters * 1.0e6);
+
+        if (t_shr > t_nic) {
+            for (i = 0; i < CALIBRATE_RETRIES && t_shr > t_nic; i++) {
+                t = shmem_internal_calibrate_time(buf, local, size, iters, peer, put, 1);
+                if (t < t_shr) t_shr = t;
+                t = shmem_internal_calibrate_time(buf, local, size, iters, peer, put, 0);
+                if (t < t_nic) t_nic = t;
+            }
+
+            if (t_shr > t_nic) {
+                if (crossover < floor) {
+                    DEBUG_MSG("Calibrate %s: raising crossover %zuB to %zuB\n",
+                              put ? "put" : "get", crossover, floor);
+                    crossover = floor;
+                }
+                return crossover;
+            }
+        }
+        crossover = size;
+    }
+
+    return SIZE_MAX;
+}
+
+
+/* Measure the on-node crossover between the shared memory and network
+ * transports.  Collective; the first two PEs on each node run the
+ * benchmark and the result is shared with the other PEs on the node. */
 static void
-shmem_internal_randr_fini(void)
+shmem_internal_calibrate_onnode(void)
 {
+    char *buf;
+    size_t *result;
+    int i, peer = -1;
+
+    buf = shmem_internal_shmalloc(2 * CALIBRATE_MAX_SIZE);
+    result = shmem_internal_shmalloc(2 * sizeof(size_t));
+    if (NULL == buf || NULL == result) {
+        RAISE_WARN_STR("Out of symmetric memory, skipping on-node calibration");
+        if (buf) shmem_internal_free(buf);
+        if (result) shmem_internal_free(result);
+        return;
+    }
 
-#ifdef ENABLE_THREADS
-    SHMEM_MUTEX_DESTROY(shmem_internal_mutex_rand_r);
+#ifdef USE_CMA
+    result[0] = shmem_internal_params.CMA_PUT_MAX;
+    result[1] = shmem_internal_params.CMA_GET_MAX;
+#else
+    result[0] = shmem_internal_shr_put_max;
+    result[1] = shmem_internal_shr_get_max;
 #endif
+    memset(buf, 0, 2 * CALIBRATE_MAX_SIZE);
+
+    shmem_internal_barrier_all();
+
+    if (0 == shmem_internal_get_shr_rank(shmem_internal_my_pe)) {
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            if (1 == shmem_internal_get_shr_rank(i)) {
+                peer = i;
+                break;
+            }
+        }
+    }
+
+    if (-1 != peer) {
+        /* The static thresholds, where set, bound the calibrated ones from
+         * below */
+        for (i = 0; i < 2; i++)
+            result[i] = shmem_internal_calibrate_crossover(buf, peer, i == 0,
+                                                           SIZE_MAX == result[i] ?
+                                                           CALIBRATE_FLOOR_SIZE : result[i]);
+
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            if (i != shmem_internal_my_pe && -1 != shmem_internal_get_shr_rank(i))
+                shmem_shr_transport_put(SHMEM_CTX_DEFAULT, result, result,
+                                        2 * sizeof(size_t), i);
+        }
+    }
+
+    shmem_internal_barrier_all();
+
+#ifdef USE_CMA
+    if (!shmem_internal_params.CMA_PUT_MAX_provided)
+        shmem_internal_params.CMA_PUT_MAX = result[0];
+    if (!shmem_internal_params.CMA_GET_MAX_provided)
+        shmem_internal_params.CMA_GET_MAX = result[1];
+#else
+    shmem_internal_shr_put_max = result[0];
+    shmem_internal_shr_get_max = result[1];
+#endif
+
+    if (shmem_internal_params.INFO && 0 == shmem_internal_my_pe) {
+        printf("On-node transport calibration:\n");
+        for (i = 0; i < 2; i++) {
+            if (SIZE_MAX == result[i])
+                printf("  %s crossover: none up to %d bytes, always on-node\n",
+                       i ? "Get" : "Put", CALIBRATE_MAX_SIZE);
+            else
+                printf("  %s crossover: %zu bytes\n", i ? "Get" : "Put", result[i]);
+        }
+        printf("\n");
+    }
+
+    shmem_internal_free(result);
+    shmem_internal_free(buf);
+}
+#endif /* USE_ON_NODE_COMMS && network transport */
+
+/* Base of the per-thread random number generators, see shmem_sync_scan.h */
+static void
+shmem_internal_randr_init(void)
+{
+    shmem_internal_rand_seed = shmem_internal_my_pe;
 
     return;
 }
@@ -145,17 +354,21 @@ shmem_internal_shutdown(void)
 
     shmem_internal_barrier_all();
 
+    if (shmem_internal_params.SYMMETRIC_HEAP_STATS)
+        shmem_internal_heap_report();
+
     shmem_internal_finalized = 1;
 
     shmem_internal_team_fini();
 
+    shmem_internal_space_fini();
+
     shmem_transport_fini();
 
     shmem_shr_transport_fini();
 
     SHMEM_MUTEX_DESTROY(shmem_internal_mutex_alloc);
-
-    shmem_internal_randr_fini();
+    SHMEM_MUTEX_DESTROY(shmem_internal_mutex_runtime);
 
     shmem_internal_symmetric_fini();
     shmem_runtime_fini();
@@ -201,6 +414,7 @@ shmem_internal_heap_preinit(int tl_requested, int *tl_provided)
 
     /* set up threading */
     SHMEM_MUTEX_INIT(shmem_internal_mutex_alloc);
+    SHMEM_MUTEX_INIT(shmem_internal_mutex_runtime);
 #ifdef ENABLE_THREADS
     shmem_internal_thread_level = tl_requested;
     *tl_provided = tl_requested;
@@ -209,6 +423,9 @@ shmem_internal_heap_preinit(int tl_requested, int *tl_provided)
     *tl_provided = SHMEM_THREAD_SINGLE;
 #endif
 
+    shmem_internal_wait_init();
+    shmem_internal_lock_init();
+
 #if USE_ON_NODE_COMMS
     enable_node_ranks = 1;
 #elif USE_OFI
@@ -362,7 +579,6 @@ shmem_internal_heap_postinit(void)
 
     int transport_initialized = 0;
     int shr_initialized       = 0;
-    int randr_initialized     = 0;
     int teams_initialized     = 0;
     int enable_node_ranks     = 0;
 
@@ -460,6 +676,10 @@ shmem_internal_heap_postinit(void)
     }
 #endif // HAVE_SCHED_GETAFFINITY
 
+    /* Place the heap now that the PE's affinity is settled, and before the
+     * transports register it */
+    shmem_internal_symmetric_place();
+
     /* Initialize transport devices */
     ret = shmem_transport_init();
     if (0 != ret) {
@@ -514,8 +734,12 @@ shmem_internal_heap_postinit(void)
     }
     teams_initialized = 1;
 
+#ifdef SHMEM_INTERNAL_CALIBRATE_ONNODE
+    if (shmem_internal_params.CALIBRATE_ONNODE)
+        shmem_internal_calibrate_onnode();
+#endif
+
     shmem_internal_randr_init();
-    randr_initialized = 1;
 
     atexit(shmem_internal_shutdown_atexit);
     shmem_internal_initialized = 1;
@@ -535,10 +759,6 @@ shmem_internal_heap_postinit(void)
         shmem_shr_transport_fini();
     }
 
-    if (randr_initialized) {
-        shmem_internal_randr_fini();
-    }
-
     if (teams_initialized) {
         shmem_internal_team_fini();
     }
@@ -17,6 +17,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define SHMEM_INTERNAL_INCLUDE
 #include "shmem.h"
@@ -35,8 +36,34 @@
 #pragma weak shmem_test_lock = pshmem_test_lock
 #define shmem_test_lock pshmem_test_lock
 
+#pragma weak shmemx_ctx_clear_lock = pshmemx_ctx_clear_lock
+#define shmemx_ctx_clear_lock pshmemx_ctx_clear_lock
+
+#pragma weak shmemx_ctx_set_lock = pshmemx_ctx_set_lock
+#define shmemx_ctx_set_lock pshmemx_ctx_set_lock
+
+#pragma weak shmemx_ctx_test_lock = pshmemx_ctx_test_lock
+#define shmemx_ctx_test_lock pshmemx_ctx_test_lock
+
 #endif /* ENABLE_PROFILING */
 
+int shmem_internal_lock_placement = SHMEM_INTERNAL_LOCK_PLACEMENT_PE0;
+
+void
+shmem_internal_lock_init(void)
+{
+    char *type = shmem_internal_params.LOCK_PLACEMENT;
+
+    if (0 == strcmp(type, "pe0")) {
+        shmem_internal_lock_placement = SHMEM_INTERNAL_LOCK_PLACEMENT_PE0;
+    } else if (0 == strcmp(type, "hash")) {
+        shmem_internal_lock_placement = SHMEM_INTERNAL_LOCK_PLACEMENT_HASH;
+    } else {
+        RAISE_WARN_MSG("Ignoring bad lock placement '%s'\n", type);
+        shmem_internal_lock_placement = SHMEM_INTERNAL_LOCK_PLACEMENT_PE0;
+    }
+}
+
 
 void SHMEM_FUNCTION_ATTRIBUTES
 shmem_clear_lock(long *lockp)
@@ -44,7 +71,7 @@ shmem_clear_lock(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    shmem_internal_clear_lock(lockp);
+    shmem_internal_clear_lock(SHMEM_CTX_DEFAULT, lockp);
 }
 
 
@@ -54,7 +81,7 @@ shmem_set_lock(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    shmem_internal_set_lock(lockp);
+    shmem_internal_set_lock(SHMEM_CTX_DEFAULT, lockp);
 }
 
 
@@ -64,5 +91,38 @@ shmem_test_lock(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    return shmem_internal_test_lock(lockp);
+    return shmem_internal_test_lock(SHMEM_CTX_DEFAULT, lockp);
+}
+
+
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_ctx_clear_lock(shmem_ctx_t ctx, long *lockp)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_CTX(ctx);
+    SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
+
+    shmem_internal_clear_lock(ctx, lockp);
+}
+
+
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_ctx_set_lock(shmem_ctx_t ctx, long *lockp)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_CTX(ctx);
+    SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
+
+    shmem_internal_set_lock(ctx, lockp);
+}
+
+
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_ctx_test_lock(shmem_ctx_t ctx, long *lockp)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_CTX(ctx);
+    SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
+
+    return shmem_internal_test_lock(ctx, lockp);
 }
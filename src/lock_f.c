@@ -37,7 +37,7 @@ FC_SHMEM_CLEAR_LOCK(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    shmem_internal_clear_lock(lockp);
+    shmem_internal_clear_lock(SHMEM_CTX_DEFAULT, lockp);
 }
 
 
@@ -49,7 +49,7 @@ FC_SHMEM_SET_LOCK(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    shmem_internal_set_lock(lockp);
+    shmem_internal_set_lock(SHMEM_CTX_DEFAULT, lockp);
 }
 
 
@@ -61,5 +61,5 @@ FC_SHMEM_TEST_LOCK(long *lockp)
     SHMEM_ERR_CHECK_INITIALIZED();
     SHMEM_ERR_CHECK_SYMMETRIC(lockp, sizeof(long));
 
-    return shmem_internal_test_lock(lockp);
+    return shmem_internal_test_lock(SHMEM_CTX_DEFAULT, lockp);
 }
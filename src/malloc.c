@@ -537,6 +537,8 @@ MAX_RELEASE_CHECK_RATE   default: 4095 unless not HAVE_MMAP
 #include "shmem_internal.h"
 
 #define USE_DL_PREFIX 1
+#define MSPACES 1
+#define MALLOC_INSPECT_ALL 1
 #define HAVE_MORECORE 1
 #define MORECORE shmem_internal_get_next
 #define MORECORE_CONTIGUOUS 1
@@ -1384,6 +1386,12 @@ DLMALLOC_EXPORT void mspace_free(mspace msp, void* mem);
 */
 DLMALLOC_EXPORT void* mspace_realloc(mspace msp, void* mem, size_t newsize);
 
+/*
+  mspace_realloc_in_place behaves as realloc_in_place, but operates
+  within the given space.
+*/
+DLMALLOC_EXPORT void* mspace_realloc_in_place(mspace msp, void* oldmem, size_t bytes);
+
 /*
   mspace_calloc behaves as calloc, but operates within
   the given space.
@@ -1410,6 +1418,12 @@ DLMALLOC_EXPORT void** mspace_independent_calloc(mspace msp, size_t n_elements,
 DLMALLOC_EXPORT void** mspace_independent_comalloc(mspace msp, size_t n_elements,
                                    size_t sizes[], void* chunks[]);
 
+/*
+  mspace_bulk_free behaves as bulk_free, but operates within the
+  given space.
+*/
+DLMALLOC_EXPORT size_t mspace_bulk_free(mspace msp, void* array[], size_t nelem);
+
 /*
   mspace_footprint() returns the number of bytes obtained from the
   system for this space.
@@ -1422,6 +1436,14 @@ DLMALLOC_EXPORT size_t mspace_footprint(mspace msp);
 */
 DLMALLOC_EXPORT size_t mspace_max_footprint(mspace msp);
 
+/*
+  mspace_footprint_limit and mspace_set_footprint_limit behave as
+  malloc_footprint_limit and malloc_set_footprint_limit, but apply to
+  the given space.
+*/
+DLMALLOC_EXPORT size_t mspace_footprint_limit(mspace msp);
+DLMALLOC_EXPORT size_t mspace_set_footprint_limit(mspace msp, size_t bytes);
+
 
 #if !NO_MALLINFO
 /*
@@ -1453,6 +1475,16 @@ DLMALLOC_EXPORT int mspace_trim(mspace msp, size_t pad);
 */
 DLMALLOC_EXPORT int mspace_mallopt(int, int);
 
+#if MALLOC_INSPECT_ALL
+/*
+  mspace_inspect_all behaves as malloc_inspect_all, but traverses
+  the given space.
+*/
+DLMALLOC_EXPORT void mspace_inspect_all(mspace msp,
+                                        void(*handler)(void*, void *, size_t, void*),
+                                        void* arg);
+#endif /* MALLOC_INSPECT_ALL */
+
 #endif /* MSPACES */
 
 #ifdef __cplusplus
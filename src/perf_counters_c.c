@@ -15,6 +15,7 @@
 
 #include "shmem_internal.h"
 #include "transport.h"
+#include "shmem_wait.h"
 
 #ifdef ENABLE_PROFILING
 #include "pshmem.h"
@@ -37,6 +38,12 @@
 #pragma weak shmemx_pcntr_get_all = pshmemx_pcntr_get_all
 #define shmemx_pcntr_get_all pshmemx_pcntr_get_all
 
+#pragma weak shmemx_pcntr_get_wait = pshmemx_pcntr_get_wait
+#define shmemx_pcntr_get_wait pshmemx_pcntr_get_wait
+
+#pragma weak shmemx_pcntr_get_sync_wait = pshmemx_pcntr_get_sync_wait
+#define shmemx_pcntr_get_sync_wait pshmemx_pcntr_get_sync_wait
+
 #endif /* ENABLE_PROFILING */
 
 void SHMEM_FUNCTION_ATTRIBUTES 
@@ -87,3 +94,19 @@ shmemx_pcntr_get_all(shmem_ctx_t ctx, shmemx_pcntr_t *pcntr)
     return;
 }
 
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_get_wait(shmem_ctx_t ctx, shmemx_pcntr_wait_t *wait)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    shmem_transport_pcntr_get_wait((shmem_transport_ctx_t *) ctx, wait);
+    return;
+}
+
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_get_sync_wait(shmemx_pcntr_wait_t *wait)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    wait->spin_ns = wait->yield_ns = wait->block_ns = wait->count = 0;
+    shmem_internal_wait_state_get(&shmem_internal_sync_wait_state, wait);
+    return;
+}
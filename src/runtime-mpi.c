@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <mpi.h>
 
 #include "runtime.h"
@@ -38,6 +39,8 @@ static int kv_length = 0;
 static int initialized_mpi = 0;
 static int node_size;
 static int *node_ranks;
+/* MPI has no job identifier, the host name and PID of rank 0 are used */
+static char job_id[128];
 
 char* kv_store_me;
 char* kv_store_all;
@@ -97,6 +100,16 @@ shmem_runtime_init(int enable_node_ranks)
     MPI_Comm_rank(SHMEM_RUNTIME_WORLD, &rank);
     MPI_Comm_size(SHMEM_RUNTIME_WORLD, &size);
 
+    if (rank == 0) {
+        char host[64];
+
+        if (0 != gethostname(host, sizeof(host)))
+            strcpy(host, "localhost");
+        host[sizeof(host) - 1] = '\0';
+        snprintf(job_id, sizeof(job_id), "%s.%d", host, (int) getpid());
+    }
+    MPI_Bcast(job_id, sizeof(job_id), MPI_CHAR, 0, SHMEM_RUNTIME_WORLD);
+
     kv_store_me = (char*)malloc(MAX_KV_COUNT * sizeof(char)* MAX_KV_LENGTH);
     if (NULL == kv_store_me) return 8;
 
@@ -176,6 +189,12 @@ shmem_runtime_get_size(void)
     return size;
 }
 
+const char *
+shmem_runtime_get_job_id(void)
+{
+    return job_id;
+}
+
 int
 shmem_runtime_get_node_rank(int pe)
 {
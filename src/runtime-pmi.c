@@ -170,6 +170,13 @@ shmem_runtime_get_size(void)
 }
 
 
+const char *
+shmem_runtime_get_job_id(void)
+{
+    return kvs_name;
+}
+
+
 int
 shmem_runtime_get_node_rank(int pe)
 {
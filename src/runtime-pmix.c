@@ -129,6 +129,13 @@ shmem_runtime_get_size(void)
 }
 
 
+const char *
+shmem_runtime_get_job_id(void)
+{
+    return myproc.nspace;
+}
+
+
 int
 shmem_runtime_get_node_rank(int pe)
 {
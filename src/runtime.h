@@ -32,6 +32,10 @@ int shmem_runtime_get_size(void);
 int shmem_runtime_get_node_rank(int pe);
 int shmem_runtime_get_node_size(void);
 
+/* Identifier of the job, the same on all PEs.  NULL if the runtime does not
+ * provide one (e.g., singleton runs without a process manager). */
+const char *shmem_runtime_get_job_id(void);
+
 int shmem_runtime_exchange(void);
 int shmem_runtime_put(char *key, void *value, size_t valuelen);
 int shmem_runtime_get(int pe, char *key, void *value, size_t valuelen);
@@ -41,7 +41,7 @@ shmem_internal_put_nb(shmem_ctx_t ctx, void *target, const void *source, size_t
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put(ctx, target, source, len, pe);
     } else {
-        shmem_transport_put_nb((shmem_transport_ctx_t *)ctx, target, source, len, pe, completion);
+        shmem_transport_put_nb(SHMEM_TRANSPORT_CTX(ctx), target, source, len, pe, completion);
     }
 }
 
@@ -50,7 +50,7 @@ static inline
 void
 shmem_internal_put_wait(shmem_ctx_t ctx, long *completion)
 {
-    shmem_transport_put_wait((shmem_transport_ctx_t *)ctx, completion);
+    shmem_transport_put_wait(SHMEM_TRANSPORT_CTX(ctx), completion);
     /* on-node is always blocking, so this is a no-op for them */
 }
 
@@ -65,10 +65,10 @@ shmem_internal_put_scalar(shmem_ctx_t ctx, void *target, const void *source, siz
         shmem_shr_transport_put_scalar(ctx, target, source, len, pe);
     } else {
 #ifndef DISABLE_OFI_INJECT
-        shmem_transport_put_scalar((shmem_transport_ctx_t *)ctx, target, source, len, pe);
+        shmem_transport_put_scalar(SHMEM_TRANSPORT_CTX(ctx), target, source, len, pe);
 #else
         long completion = 0;
-        shmem_transport_put_nb((shmem_transport_ctx_t *)ctx, target, source, len, pe, &completion);
+        shmem_transport_put_nb(SHMEM_TRANSPORT_CTX(ctx), target, source, len, pe, &completion);
 	shmem_internal_put_wait(ctx, &completion);
 #endif
     }
@@ -81,10 +81,10 @@ shmem_internal_put_signal_nbi(shmem_ctx_t ctx, void *target, const void *source,
 {
     if (len == 0) {
         if (sig_op == SHMEM_SIGNAL_ADD)
-            shmem_transport_atomic((shmem_transport_ctx_t *) ctx, sig_addr, &signal, sizeof(uint64_t),
+            shmem_transport_atomic(SHMEM_TRANSPORT_CTX(ctx), sig_addr, &signal, sizeof(uint64_t),
                                    pe, SHM_INTERNAL_SUM, SHM_INTERNAL_UINT64);
         else
-            shmem_transport_atomic_set((shmem_transport_ctx_t *) ctx, sig_addr, &signal,
+            shmem_transport_atomic_set(SHMEM_TRANSPORT_CTX(ctx), sig_addr, &signal,
                                       sizeof(uint64_t), pe, SHM_INTERNAL_UINT64);
         return;
     }
@@ -92,7 +92,7 @@ shmem_internal_put_signal_nbi(shmem_ctx_t ctx, void *target, const void *source,
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put_signal(ctx, target, source, len, sig_addr, signal, sig_op, pe);
     } else {
-        shmem_transport_put_signal_nbi((shmem_transport_ctx_t *) ctx, target, source, len, sig_addr, signal, sig_op, pe);
+        shmem_transport_put_signal_nbi(SHMEM_TRANSPORT_CTX(ctx), target, source, len, sig_addr, signal, sig_op, pe);
     }
 }
 
@@ -105,11 +105,61 @@ shmem_internal_put_nbi(shmem_ctx_t ctx, void *target, const void *source, size_t
     if (shmem_shr_transport_use_write(ctx, target, source, len, pe)) {
         shmem_shr_transport_put(ctx, target, source, len, pe);
     } else {
-        shmem_transport_put_nbi((shmem_transport_ctx_t *)ctx, target, source, len, pe);
+        shmem_transport_put_nbi(SHMEM_TRANSPORT_CTX(ctx), target, source, len, pe);
     }
 }
 
 
+/* Strided puts; strides are in bytes.  On-node peers reachable through a
+ * vectored transport receive all blocks in as few operations as possible,
+ * otherwise each element (iput) or block (ibput) is put individually. */
+static inline
+void
+shmem_internal_iput(shmem_ctx_t ctx, void *target, const void *source,
+                    ptrdiff_t tst, ptrdiff_t sst, size_t elem_size,
+                    size_t nelems, int pe)
+{
+    if (nelems == 0) return;
+
+    if (shmem_shr_transport_use_writev(ctx, target, source, elem_size, pe)) {
+        shmem_shr_transport_iput(ctx, target, source, tst, sst, elem_size,
+                                 nelems, pe);
+        return;
+    }
+
+    for ( ; nelems > 0 ; --nelems) {
+        shmem_internal_put_scalar(ctx, target, source, elem_size, pe);
+        target = (uint8_t *) target + tst;
+        source = (uint8_t *) source + sst;
+    }
+}
+
+
+static inline
+void
+shmem_internal_ibput(shmem_ctx_t ctx, void *target, const void *source,
+                     ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                     size_t nblocks, int pe)
+{
+    long completion = 0;
+
+    if (nblocks == 0 || bsize == 0) return;
+
+    if (shmem_shr_transport_use_writev(ctx, target, source, bsize, pe)) {
+        shmem_shr_transport_iput(ctx, target, source, tst, sst, bsize,
+                                 nblocks, pe);
+        return;
+    }
+
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_internal_put_nb(ctx, target, source, bsize, pe, &completion);
+        target = (uint8_t *) target + tst;
+        source = (uint8_t *) source + sst;
+    }
+    shmem_internal_put_wait(ctx, &completion);
+}
+
+
 static inline
 void
 shmem_internal_put_ct_nb(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe,
@@ -130,7 +180,7 @@ shmem_internal_get(shmem_ctx_t ctx, void *target, const void *source, size_t len
     if (shmem_shr_transport_use_read(ctx, target, source, len, pe)) {
         shmem_shr_transport_get(ctx, target, source, len, pe);
     } else {
-        shmem_transport_get((shmem_transport_ctx_t *)ctx, target, source, len, pe);
+        shmem_transport_get(SHMEM_TRANSPORT_CTX(ctx), target, source, len, pe);
     }
 }
 
@@ -149,10 +199,34 @@ static inline
 void
 shmem_internal_get_wait(shmem_ctx_t ctx)
 {
-    shmem_transport_get_wait((shmem_transport_ctx_t *)ctx);
+    shmem_transport_get_wait(SHMEM_TRANSPORT_CTX(ctx));
     /* on-node is always blocking, so this is a no-op for them */
 }
 
+/* Strided get of nblocks blocks of bsize bytes; strides are in bytes.
+ * Returns once the data has arrived. */
+static inline
+void
+shmem_internal_iget(shmem_ctx_t ctx, void *target, const void *source,
+                    ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                    size_t nblocks, int pe)
+{
+    if (nblocks == 0 || bsize == 0) return;
+
+    if (shmem_shr_transport_use_readv(ctx, target, source, bsize, pe)) {
+        shmem_shr_transport_iget(ctx, target, source, tst, sst, bsize,
+                                 nblocks, pe);
+        return;
+    }
+
+    for ( ; nblocks > 0 ; --nblocks) {
+        shmem_internal_get(ctx, target, source, bsize, pe);
+        target = (uint8_t *) target + tst;
+        source = (uint8_t *) source + sst;
+    }
+    shmem_internal_get_wait(ctx);
+}
+
 static inline
 void
 shmem_internal_swap(shmem_ctx_t ctx, void *target, void *source, void *dest, size_t len,
@@ -163,7 +237,7 @@ shmem_internal_swap(shmem_ctx_t ctx, void *target, void *source, void *dest, siz
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_swap(ctx, target, source, dest, len, pe, datatype);
     } else {
-        shmem_transport_swap((shmem_transport_ctx_t *)ctx, target, source, dest, len, pe, datatype);
+        shmem_transport_swap(SHMEM_TRANSPORT_CTX(ctx), target, source, dest, len, pe, datatype);
     }
 }
 
@@ -179,7 +253,7 @@ shmem_internal_swap_nbi(shmem_ctx_t ctx, void *target, void *source,
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_swap(ctx, target, source, dest, len, pe, datatype);
     } else {
-        shmem_transport_swap_nbi((shmem_transport_ctx_t *)ctx, target, source,
+        shmem_transport_swap_nbi(SHMEM_TRANSPORT_CTX(ctx), target, source,
                                  dest, len, pe, datatype);
     }
 }
@@ -195,7 +269,7 @@ shmem_internal_cswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_cswap(ctx, target, source, dest, operand, len, pe, datatype);
     } else {
-        shmem_transport_cswap((shmem_transport_ctx_t *)ctx, target, source,
+        shmem_transport_cswap(SHMEM_TRANSPORT_CTX(ctx), target, source,
                               dest, operand, len, pe, datatype);
     }
 }
@@ -212,7 +286,7 @@ shmem_internal_cswap_nbi(shmem_ctx_t ctx, void *target, void *source,
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_cswap(ctx, target, source, dest, operand, len, pe, datatype);
     } else {
-        shmem_transport_cswap_nbi((shmem_transport_ctx_t *)ctx, target, source,
+        shmem_transport_cswap_nbi(SHMEM_TRANSPORT_CTX(ctx), target, source,
                                   dest, operand, len, pe, datatype);
     }
 }
@@ -228,7 +302,7 @@ shmem_internal_mswap(shmem_ctx_t ctx, void *target, void *source, void *dest, vo
     if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
         shmem_shr_transport_mswap(ctx, target, source, dest, mask, len, pe, datatype);
     } else {
-        shmem_transport_mswap((shmem_transport_ctx_t *)ctx, target, source,
+        shmem_transport_mswap(SHMEM_TRANSPORT_CTX(ctx), target, source,
                               dest, mask, len, pe, datatype);
     }
 }
@@ -248,11 +322,11 @@ shmem_internal_atomic(shmem_ctx_t ctx, void *target, const void *source, size_t
         /* FIXME: This is a temporary workaround to resolve a known issue with non-fetching AMOs when using
            the CXI provider */
         unsigned long long tmp_fetch = 0;
-        shmem_transport_fetch_atomic((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_fetch_atomic(SHMEM_TRANSPORT_CTX(ctx), target,
                                      source, &tmp_fetch, len, pe, op, datatype);
-        shmem_transport_get_wait((shmem_transport_ctx_t *)ctx);
+        shmem_transport_get_wait(SHMEM_TRANSPORT_CTX(ctx));
 #else
-        shmem_transport_atomic((shmem_transport_ctx_t *)ctx, target, source,
+        shmem_transport_atomic(SHMEM_TRANSPORT_CTX(ctx), target, source,
                                len, pe, op, datatype);
 #endif
     }
@@ -266,10 +340,10 @@ shmem_internal_atomic_fetch(shmem_ctx_t ctx, void *target, const void *source, s
 {
     shmem_internal_assert(len > 0);
 
-    if (shmem_shr_transport_use_atomic(ctx, target, len, pe, datatype)) {
+    if (shmem_shr_transport_use_atomic(ctx, (void *) source, len, pe, datatype)) {
         shmem_shr_transport_atomic_fetch(ctx, target, source, len, pe, datatype);
     } else {
-        shmem_transport_atomic_fetch((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_atomic_fetch(SHMEM_TRANSPORT_CTX(ctx), target,
                                      source, len, pe, datatype);
     }
 }
@@ -289,11 +363,11 @@ shmem_internal_atomic_set(shmem_ctx_t ctx, void *target, const void *source, siz
         /* FIXME: This is a temporary workaround to resolve a known issue with non-fetching AMOs when using
            the CXI provider */
         unsigned long long tmp_fetch = 0;
-        shmem_transport_fetch_atomic((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_fetch_atomic(SHMEM_TRANSPORT_CTX(ctx), target,
                                      source, &tmp_fetch, len, pe, FI_ATOMIC_WRITE, datatype);
-        shmem_transport_get_wait((shmem_transport_ctx_t *)ctx);
+        shmem_transport_get_wait(SHMEM_TRANSPORT_CTX(ctx));
 #else
-        shmem_transport_atomic_set((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_atomic_set(SHMEM_TRANSPORT_CTX(ctx), target,
                                    source, len, pe, datatype);
 #endif
     }
@@ -312,7 +386,7 @@ shmem_internal_fetch_atomic(shmem_ctx_t ctx, void *target, void *source, void *d
         shmem_shr_transport_fetch_atomic(ctx, target, source, dest, len, pe,
                                          op, datatype);
     } else {
-        shmem_transport_fetch_atomic((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_fetch_atomic(SHMEM_TRANSPORT_CTX(ctx), target,
                                      source, dest, len, pe, op, datatype);
     }
 }
@@ -335,7 +409,7 @@ shmem_internal_atomicv(shmem_ctx_t ctx, void *target, const void *source,
         shmem_internal_fetch_atomic(ctx, ((uint8_t *) target) + (i * type_size),
                                     ((uint8_t *) source) + (i * type_size), &tmp_fetch, type_size,
                                     pe, op, datatype);
-        shmem_transport_get_wait((shmem_transport_ctx_t *)ctx);
+        shmem_transport_get_wait(SHMEM_TRANSPORT_CTX(ctx));
     }
     *completion += 1;
 #else
@@ -346,7 +420,7 @@ shmem_internal_atomicv(shmem_ctx_t ctx, void *target, const void *source,
                                        pe, op, datatype);
         }
     } else {
-        shmem_transport_atomicv((shmem_transport_ctx_t *)ctx, target, source, count, type_size,
+        shmem_transport_atomicv(SHMEM_TRANSPORT_CTX(ctx), target, source, count, type_size,
                                 pe, op, datatype, completion);
     }
 #endif
@@ -365,7 +439,7 @@ shmem_internal_fetch_atomic_nbi(shmem_ctx_t ctx, void *target, void *source,
         shmem_shr_transport_fetch_atomic(ctx, target, source, dest, len, pe,
                                          op, datatype);
     } else {
-        shmem_transport_fetch_atomic_nbi((shmem_transport_ctx_t *)ctx, target,
+        shmem_transport_fetch_atomic_nbi(SHMEM_TRANSPORT_CTX(ctx), target,
                                          source, dest, len, pe, op, datatype);
     }
 }
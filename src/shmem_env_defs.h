@@ -44,10 +44,32 @@ SHMEM_INTERNAL_ENV_DEF(DISABLE_ASLR_CHECK, bool, false, SHMEM_INTERNAL_ENV_CAT_O
 
 SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_USE_MALLOC, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Allocate the symmetric heap using malloc")
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_RESERVE, size, 0, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Address space to reserve for a growable symmetric heap (0 for a fixed heap)")
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_SLAB_MAX, size, 1024, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Largest symmetric allocation served from size-class slabs (0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_NUMA_BIND, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Bind the symmetric heap to the NUMA node(s) local to the PE")
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_PREFAULT, long, 0, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Number of threads used to fault in the symmetric heap at startup (0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_STATS, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Print a summary of symmetric heap usage across PEs at finalize")
+#ifdef ENABLE_ERROR_CHECKING
+SHMEM_INTERNAL_ENV_DEF(SYMMETRIC_HEAP_CHECK, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Check that all PEs performed the same symmetric allocations")
+#endif
 SHMEM_INTERNAL_ENV_DEF(BOUNCE_SIZE, size, DEFAULT_BOUNCE_SIZE, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Maximum message size to bounce buffer")
 SHMEM_INTERNAL_ENV_DEF(MAX_BOUNCE_BUFFERS, long, 128, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Maximum number of bounce buffers per context")
+SHMEM_INTERNAL_ENV_DEF(WAIT_POLICY, string, "auto", SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Completion and synchronization wait policy.  Options are auto, spin, block, adaptive")
+SHMEM_INTERNAL_ENV_DEF(WAIT_SPIN_USEC, long, 20, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Maximum time in microseconds an adaptive wait spins before yielding")
+SHMEM_INTERNAL_ENV_DEF(WAIT_YIELD_USEC, long, 200, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Maximum time in microseconds an adaptive wait yields before blocking")
+SHMEM_INTERNAL_ENV_DEF(LOCK_PLACEMENT, string, "pe0", SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Home PE of each distributed lock.  Options are pe0, hash")
 SHMEM_INTERNAL_ENV_DEF(TRAP_ON_ABORT, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Generate trap if the program aborts or calls shmem_global_exit")
 
@@ -84,9 +106,37 @@ SHMEM_INTERNAL_ENV_DEF(CMA_GET_MAX, size, 16*1024, SHMEM_INTERNAL_ENV_CAT_INTRAN
                        "Size below which to use CMA for gets")
 #endif /* USE_CMA */
 
+#ifdef USE_ON_NODE_COMMS
+SHMEM_INTERNAL_ENV_DEF(CALIBRATE_ONNODE, bool, false, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Measure on-node vs. network put/get crossover sizes at startup")
+#endif
+
+#ifdef USE_XPMEM
+SHMEM_INTERNAL_ENV_DEF(XPMEM_MAX_ATTACHED, long, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Max. number of peers attached at once, idle peers are detached (0: no limit)")
+#endif
+
+#if defined(USE_XPMEM) || defined(USE_SHM)
+SHMEM_INTERNAL_ENV_DEF(MEMCPY_NT_THRESHOLD, size, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Copy size at or above which to use non-temporal stores (default: LLC size)")
+SHMEM_INTERNAL_ENV_DEF(MEMCPY_THREADS, long, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Number of helper threads used to split large copies")
+SHMEM_INTERNAL_ENV_DEF(MEMCPY_THREAD_THRESHOLD, size, 0, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Copy size at or above which to use helper threads (default: 4x LLC size)")
+#endif
+
+#ifdef USE_SHM
+SHMEM_INTERNAL_ENV_DEF(SHM_WAIT_FUTEX, bool, false, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Park polling waits in a futex that on-node updates wake")
+SHMEM_INTERNAL_ENV_DEF(SHM_WAIT_FUTEX_USEC, long, 1000, SHMEM_INTERNAL_ENV_CAT_INTRANODE,
+                       "Maximum time in microseconds a parked wait sleeps before polling again")
+#endif
+
 #ifdef USE_OFI
 SHMEM_INTERNAL_ENV_DEF(OFI_ATOMIC_CHECKS_WARN, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Display warnings about unsupported atomic operations")
+SHMEM_INTERNAL_ENV_DEF(OFI_ATOMIC_EMULATION, string, "auto", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Software emulation of atomic operations (off, auto, on)")
 SHMEM_INTERNAL_ENV_DEF(OFI_PROVIDER, string, "auto", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Provider that should be used by the OFI transport")
 SHMEM_INTERNAL_ENV_DEF(OFI_USE_PROVIDER, string, "auto", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
@@ -109,13 +159,34 @@ SHMEM_INTERNAL_ENV_DEF(OFI_STX_ALLOCATOR, string, "round-robin", SHMEM_INTERNAL_
                        "Algorithm for allocating STX resources to contexts")
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_DISABLE_PRIVATE, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Disallow private contexts from having exclusive STX access")
+SHMEM_INTERNAL_ENV_DEF(THREAD_DEFAULT_CTX, string, "shared", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Mapping of SHMEM_CTX_DEFAULT to transport contexts in SHMEM_THREAD_MULTIPLE (shared, per_thread)")
+SHMEM_INTERNAL_ENV_DEF(OFI_LAZY_MR_TABLES, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Resolve remote memory registration keys on first communication with each PE")
+SHMEM_INTERNAL_ENV_DEF(OFI_LAZY_AV, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Insert peer addresses into the address vector on first communication")
+SHMEM_INTERNAL_ENV_DEF(OFI_MR_CACHE, string, "off", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Registration cache for non-symmetric RMA buffers (off, hint)")
+SHMEM_INTERNAL_ENV_DEF(OFI_MR_CACHE_THRESHOLD, size, 64*1024, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Minimum size of RMA transfers that use the registration cache")
+SHMEM_INTERNAL_ENV_DEF(OFI_QUIET_SHARDS, long, 1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Number of endpoints per context over which destination PEs are spread for per-PE quiet")
 SHMEM_INTERNAL_ENV_DEF(OFI_DISABLE_MULTIRAIL, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Disable usage of multirail functionality")
+SHMEM_INTERNAL_ENV_DEF(OFI_STRIPE_RAILS, long, 1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Number of NICs over which large RMA transfers are striped (1 to disable)")
+SHMEM_INTERNAL_ENV_DEF(OFI_STRIPE_THRESHOLD, size, 256*1024, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Minimum size of RMA transfers that are striped across NICs")
 #endif
 
-#ifdef USE_UCX
+#if defined(USE_UCX)
 SHMEM_INTERNAL_ENV_DEF(PROGRESS_INTERVAL, long, 1000, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Polling interval for progress thread in microseconds (0 to disable)")
+#elif defined(USE_OFI)
+SHMEM_INTERNAL_ENV_DEF(PROGRESS_INTERVAL, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Polling interval for progress thread in microseconds (0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(PROGRESS_THREAD_CPU, long, -1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "CPU to which the progress thread is bound (-1 to leave unbound)")
 #endif
 
 #ifdef ENABLE_PMI_MPI
@@ -39,6 +39,7 @@ extern int shmem_internal_thread_level;
 
 extern void *shmem_internal_heap_base;
 extern long shmem_internal_heap_length;
+extern long shmem_internal_heap_reserve;
 extern void *shmem_internal_data_base;
 extern long shmem_internal_data_length;
 
@@ -51,6 +52,42 @@ extern int shmem_external_heap_device;
 
 extern unsigned int shmem_internal_rand_seed;
 
+/* Additional symmetric memory spaces, see symmetric_space.c */
+#define SHMEM_INTERNAL_MAX_SPACES 8
+
+struct shmem_internal_space_t {
+    void                       *base;       /* NULL if the slot is unused */
+    size_t                      length;
+    size_t                      page_size;
+    void                       *msp;        /* dlmalloc mspace */
+    void                       *mr;         /* Transport registration */
+    uint64_t                    key;        /* Local key and address */
+    uint8_t                    *addr;       /*  published to peers */
+    uint64_t                   *keys;       /* Remote keys and addresses, */
+    uint8_t                   **addrs;      /*  indexed by PE */
+};
+typedef struct shmem_internal_space_t shmem_internal_space_t;
+
+extern shmem_internal_space_t shmem_internal_spaces[SHMEM_INTERNAL_MAX_SPACES];
+extern int shmem_internal_nspaces;
+
+/* Index of the memory space containing addr, or -1 */
+static inline
+int
+shmem_internal_space_index(const void *addr)
+{
+    int i;
+
+    for (i = 0; i < shmem_internal_nspaces; i++) {
+        if ((uint8_t *) addr >= (uint8_t *) shmem_internal_spaces[i].base &&
+            (uint8_t *) addr < (uint8_t *) shmem_internal_spaces[i].base +
+                               shmem_internal_spaces[i].length)
+            return i;
+    }
+
+    return -1;
+}
+
 #ifdef USE_HWLOC
 #include <hwloc.h>
 extern hwloc_topology_t shmem_internal_topology;
@@ -272,6 +309,16 @@ extern hwloc_topology_t shmem_internal_topology;
                                 ptr_ext, shmem_internal_heap_base, heap_ext);                 \
             }                                                                                 \
         }                                                                                     \
+        else if (shmem_internal_space_index(ptr_base) >= 0) {                                 \
+            const shmem_internal_space_t *space =                                             \
+                &shmem_internal_spaces[shmem_internal_space_index(ptr_base)];                 \
+            const void *space_ext = (void*)((uint8_t *) space->base + space->length);         \
+            if (ptr_ext > space_ext) {                                                        \
+                RAISE_ERROR_MSG("Argument \"%s\" [%p..%p) exceeds "                           \
+                                "sym. space region [%p..%p)\n", #ptr_in, ptr_base,            \
+                                ptr_ext, space->base, space_ext);                             \
+            }                                                                                 \
+        }                                                                                     \
         else if (shmem_external_heap_base) {                                                  \
             const void *heap_ext_external = (void*)((uint8_t *) shmem_external_heap_base +    \
                                                    shmem_external_heap_length);               \
@@ -294,7 +341,8 @@ extern hwloc_topology_t shmem_internal_topology;
         const void *ptr_base      = (void*)(ptr_in);                                                           \
         const void *heap_ext = (void*)((uint8_t *) shmem_internal_heap_base +                                  \
                                                    shmem_internal_heap_length);                                \
-        if (! (ptr_base >= shmem_internal_heap_base && ptr_base < heap_ext)) {                                 \
+        if (! (ptr_base >= shmem_internal_heap_base && ptr_base < heap_ext) &&                                 \
+            shmem_internal_space_index(ptr_base) < 0) {                                                        \
             if (shmem_external_heap_base) {                                                                    \
                 const void *heap_ext_external = (void*)((uint8_t *) shmem_external_heap_base +                 \
                                                    shmem_external_heap_length);                                \
@@ -486,7 +534,9 @@ typedef shmem_spinlock_t shmem_internal_mutex_t;
 #   endif /* ENABLE_PTHREAD_MUTEX */
 
 extern shmem_internal_mutex_t shmem_internal_mutex_alloc;
-extern shmem_internal_mutex_t shmem_internal_mutex_rand_r;
+/* Serializes runtime KVS lookups made after startup (e.g., lazy peer
+ * resolution), since the runtime layers are not thread safe */
+extern shmem_internal_mutex_t shmem_internal_mutex_runtime;
 
 #else
 #   define SHMEM_MUTEX_INIT(_mutex)
@@ -503,26 +553,54 @@ void shmem_internal_finalize(void);
 void shmem_internal_global_exit(int status) SHMEM_ATTRIBUTE_NORETURN;
 
 int shmem_internal_symmetric_init(void);
+void shmem_internal_symmetric_place(void);
+int shmem_internal_heap_bind(void *base, size_t len);
+#ifdef __linux__
+int shmem_internal_find_hugepage_dir(size_t page_size, char **directory);
+#endif
 int shmem_internal_symmetric_fini(void);
+void shmem_internal_symmetric_drain(void);
+void shmem_internal_heap_report(void);
 int shmem_internal_collectives_init(void);
 
 /* internal allocation, without a barrier */
 void *shmem_internal_shmalloc(size_t size);
 void* shmem_internal_get_next(intptr_t incr);
 
+/* size-class allocator for small symmetric objects, see symmetric_slab.c */
+int shmem_internal_slab_init(void);
+void shmem_internal_slab_fini(void);
+void *shmem_internal_slab_alloc(size_t size);
+size_t shmem_internal_slab_size(const void *ptr);
+int shmem_internal_slab_free(void *ptr);
+void shmem_internal_slab_stats(size_t *nobjs, size_t *bytes);
+
 void dlfree(void*);
 
+/* memory spaces, see symmetric_space.c */
+int shmem_internal_space_free(void *ptr);
+void *shmem_internal_space_realloc(void *ptr, size_t size);
+void shmem_internal_space_fini(void);
+
 static inline void shmem_internal_free(void *ptr)
 {
     /* It's fine to call dlfree with NULL, but better to avoid unnecessarily
      * taking the mutex in the threaded case. */
     if (ptr != NULL) {
         SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
-        dlfree(ptr);
+        if (!shmem_internal_slab_free(ptr) && !shmem_internal_space_free(ptr))
+            dlfree(ptr);
         SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
     }
 }
 
+#ifdef USE_ON_NODE_COMMS
+/* Largest put/get sent over a load/store on-node transport, set by the
+ * on-node calibration (CMA uses SHMEM_CMA_PUT_MAX/GET_MAX instead) */
+extern size_t shmem_internal_shr_put_max;
+extern size_t shmem_internal_shr_get_max;
+#endif
+
 /* Query PEs reachable using shared memory */
 static inline int shmem_internal_get_shr_rank(int pe)
 {
@@ -25,7 +25,7 @@
  * Use basic MCS distributed lock algorithm for lock
  */
 struct lock_t {
-    int last; /* has meaning only on PE 0 */
+    int last; /* has meaning only on the lock's home PE */
     int data; /* has meaning on all PEs */
 };
 typedef struct lock_t lock_t;
@@ -35,20 +35,64 @@ typedef struct lock_t lock_t;
 #define NEXT(A)   (A & NEXT_MASK)
 #define SIGNAL(A) (A & SIGNAL_MASK)
 
+/* Choice of the PE that holds the tail of each lock's queue */
+enum shmem_internal_lock_placement_t {
+    SHMEM_INTERNAL_LOCK_PLACEMENT_PE0 = 0,
+    SHMEM_INTERNAL_LOCK_PLACEMENT_HASH
+};
+
+extern int shmem_internal_lock_placement;
+
+void shmem_internal_lock_init(void);
+
+
+/* Home PE of a lock.  With hashed placement, the home is derived from the
+ * lock's offset in its symmetric region, which is the same on all PEs, so
+ * that the queues of different locks are spread across the PEs. */
+static inline int
+shmem_internal_lock_home(long *lockp)
+{
+    uint64_t off;
+    int idx;
+
+    if (shmem_internal_lock_placement == SHMEM_INTERNAL_LOCK_PLACEMENT_PE0 ||
+        shmem_internal_num_pes == 1)
+        return 0;
+
+    idx = shmem_internal_space_index(lockp);
+    if (idx >= 0)
+        off = ((uint64_t) (idx + 2) << 56) |
+              (uint64_t) ((uint8_t *) lockp - (uint8_t *) shmem_internal_spaces[idx].base);
+    else if ((void *) lockp >= shmem_internal_heap_base &&
+             (uint8_t *) lockp < (uint8_t *) shmem_internal_heap_base + shmem_internal_heap_length)
+        off = ((uint64_t) 1 << 56) |
+              (uint64_t) ((uint8_t *) lockp - (uint8_t *) shmem_internal_heap_base);
+    else
+        off = (uint64_t) ((uint8_t *) lockp - (uint8_t *) shmem_internal_data_base);
+
+    /* Fibonacci hashing; locks are normally allocated next to each other */
+    off = (off / sizeof(long)) * UINT64_C(0x9E3779B97F4A7C15);
+
+    return (int) ((off >> 32) % (uint64_t) shmem_internal_num_pes);
+}
+
 
+/* The lock routines issue all of their operations on ctx.  Only the
+ * operations previously issued on ctx are completed by clear_lock. */
 static inline void
-shmem_internal_clear_lock(long *lockp)
+shmem_internal_clear_lock(shmem_ctx_t ctx, long *lockp)
 {
     lock_t *lock = (lock_t*) lockp;
     int curr, cond, zero = 0, sig = SIGNAL_MASK;
+    int home = shmem_internal_lock_home(lockp);
 
-    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+    shmem_internal_quiet(ctx);
 
     /* release the lock if I'm the last to try to obtain it */
     cond = shmem_internal_my_pe + 1;
-    shmem_internal_cswap(SHMEM_CTX_DEFAULT, &(lock->last), &zero, &curr, &cond,
-                         sizeof(int), 0, SHM_INTERNAL_INT);
-    shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+    shmem_internal_cswap(ctx, &(lock->last), &zero, &curr, &cond,
+                         sizeof(int), home, SHM_INTERNAL_INT);
+    shmem_internal_get_wait(ctx);
 
     /* if local PE was not the last to hold the lock, look for the next in line */
     if (curr != shmem_internal_my_pe + 1) {
@@ -56,10 +100,10 @@ shmem_internal_clear_lock(long *lockp)
 
         /* wait for next part of the data block to be non-zero */
         for (;;) {
-            shmem_internal_atomic_fetch(SHMEM_CTX_DEFAULT, &cur_data, &(lock->data),
+            shmem_internal_atomic_fetch(ctx, &cur_data, &(lock->data),
                                         sizeof(int), shmem_internal_my_pe,
                                         SHM_INTERNAL_INT);
-            shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+            shmem_internal_get_wait(ctx);
 
             if (NEXT(cur_data) != 0)
                 break;
@@ -68,44 +112,45 @@ shmem_internal_clear_lock(long *lockp)
         }
 
         /* set the signal bit on new lock holder */
-        shmem_internal_mswap(SHMEM_CTX_DEFAULT, &(lock->data), &sig, &curr,
+        shmem_internal_mswap(ctx, &(lock->data), &sig, &curr,
                              &sig, sizeof(int), NEXT(cur_data) - 1, SHM_INTERNAL_INT);
-        shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+        shmem_internal_get_wait(ctx);
     }
 }
 
 
 static inline void
-shmem_internal_set_lock(long *lockp)
+shmem_internal_set_lock(shmem_ctx_t ctx, long *lockp)
 {
     lock_t *lock = (lock_t*) lockp;
     int curr, zero = 0, me = shmem_internal_my_pe + 1;
+    int home = shmem_internal_lock_home(lockp);
 
     /* initialize my elements to zero */
-    shmem_internal_atomic_set(SHMEM_CTX_DEFAULT, &(lock->data), &zero,
+    shmem_internal_atomic_set(ctx, &(lock->data), &zero,
                               sizeof(zero), shmem_internal_my_pe, SHM_INTERNAL_INT);
-    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+    shmem_internal_quiet(ctx);
 
     /* update last with my value to add me to the queue */
-    shmem_internal_swap(SHMEM_CTX_DEFAULT, &(lock->last), &me, &curr,
-                        sizeof(int), 0, SHM_INTERNAL_INT);
-    shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+    shmem_internal_swap(ctx, &(lock->last), &me, &curr,
+                        sizeof(int), home, SHM_INTERNAL_INT);
+    shmem_internal_get_wait(ctx);
 
     /* If I wasn't the first, need to add myself to the previous last's next */
     if (0 != curr) {
         int next_mask = NEXT_MASK;
 
-        shmem_internal_mswap(SHMEM_CTX_DEFAULT, &(lock->data), &me, &curr,
+        shmem_internal_mswap(ctx, &(lock->data), &me, &curr,
                              &next_mask, sizeof(int), curr - 1, SHM_INTERNAL_INT);
-        shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+        shmem_internal_get_wait(ctx);
 
         /* now wait for the signal part of data to be non-zero */
         for (;;) {
             int cur_data;
 
-            shmem_internal_atomic_fetch(SHMEM_CTX_DEFAULT, &cur_data, &(lock->data),
+            shmem_internal_atomic_fetch(ctx, &cur_data, &(lock->data),
                                         sizeof(int), shmem_internal_my_pe, SHM_INTERNAL_INT);
-            shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+            shmem_internal_get_wait(ctx);
 
             if (SIGNAL(cur_data) != 0)
                 break;
@@ -122,20 +167,21 @@ shmem_internal_set_lock(long *lockp)
 
 
 static inline int
-shmem_internal_test_lock(long *lockp)
+shmem_internal_test_lock(shmem_ctx_t ctx, long *lockp)
 {
     lock_t *lock = (lock_t*) lockp;
     int curr, me = shmem_internal_my_pe + 1, zero = 0;
+    int home = shmem_internal_lock_home(lockp);
 
     /* initialize my elements to zero */
-    shmem_internal_atomic_set(SHMEM_CTX_DEFAULT, &(lock->data), &zero,
+    shmem_internal_atomic_set(ctx, &(lock->data), &zero,
                               sizeof(zero), shmem_internal_my_pe, SHM_INTERNAL_INT);
-    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+    shmem_internal_quiet(ctx);
 
     /* add self to last if and only if the lock is zero (ie, no one has the lock) */
-    shmem_internal_cswap(SHMEM_CTX_DEFAULT, &(lock->last), &me, &curr, &zero,
-                         sizeof(int), 0, SHM_INTERNAL_INT);
-    shmem_internal_get_wait(SHMEM_CTX_DEFAULT);
+    shmem_internal_cswap(ctx, &(lock->last), &me, &curr, &zero,
+                         sizeof(int), home, SHM_INTERNAL_INT);
+    shmem_internal_get_wait(ctx);
 
     if (0 == curr) {
         shmem_internal_membar_acquire();
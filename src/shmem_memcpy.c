@@ -0,0 +1,362 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_memcpy.h"
+
+/* Disabled until shmem_internal_memcpy_init() has run */
+size_t shmem_internal_memcpy_nt_threshold = SIZE_MAX;
+
+#if defined(USE_XPMEM) || defined(USE_SHM)
+
+#define SHMEM_MEMCPY_DEFAULT_LLC (8 * 1024 * 1024)
+
+/* Smallest piece of a copy handed to a helper thread */
+#define SHMEM_MEMCPY_MIN_PART (1024 * 1024)
+
+struct shmem_memcpy_part_t {
+    char *dst;
+    const char *src;
+    size_t len;
+    int nt;
+    uint64_t done;          /* Generation of the last completed part */
+    char pad[64];
+};
+typedef struct shmem_memcpy_part_t shmem_memcpy_part_t;
+
+static size_t memcpy_nt_min = SIZE_MAX;
+static size_t memcpy_thread_threshold = SIZE_MAX;
+static int memcpy_nthreads = 0;
+static pthread_t *memcpy_threads = NULL;
+static shmem_memcpy_part_t *memcpy_parts = NULL;
+
+/* Held by the PE thread that owns the pool for the duration of a copy */
+static pthread_mutex_t memcpy_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Protects memcpy_gen and memcpy_shutdown, helpers sleep on memcpy_cond */
+static pthread_mutex_t memcpy_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t memcpy_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t memcpy_gen = 0;
+static int memcpy_shutdown = 0;
+
+
+/* Size of the last level cache, from the C library if it knows, otherwise
+ * from sysfs */
+static size_t
+shmem_internal_memcpy_llc_size(void)
+{
+    long size = -1;
+    int i, level, max_level = 0;
+    char path[128], buf[32];
+    FILE *fp;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size > 0) return (size_t) size;
+
+    for (i = 0; ; i++) {
+        long cache_size;
+        char unit = '\0';
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+        fp = fopen(path, "r");
+        if (NULL == fp) break;
+        if (1 != fscanf(fp, "%d", &level)) level = 0;
+        fclose(fp);
+        if (level < max_level) continue;
+
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+        fp = fopen(path, "r");
+        if (NULL == fp) continue;
+        if (NULL == fgets(buf, sizeof(buf), fp) ||
+            sscanf(buf, "%ld%c", &cache_size, &unit) < 1) {
+            fclose(fp);
+            continue;
+        }
+        fclose(fp);
+
+        if (unit == 'K') cache_size *= 1024;
+        else if (unit == 'M') cache_size *= 1024 * 1024;
+
+        max_level = level;
+        size = cache_size;
+    }
+
+    return (size > 0) ? (size_t) size : SHMEM_MEMCPY_DEFAULT_LLC;
+}
+
+
+/* Copy using streaming stores that bypass the caches.  The destination is
+ * aligned with a regular copy of the head; the source may be unaligned. */
+static void
+shmem_internal_memcpy_nt(void *dst, const void *src, size_t len)
+{
+#if defined(__AVX__)
+    const size_t align = 32;
+#elif defined(__SSE2__)
+    const size_t align = 16;
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+    char *d = (char *) dst;
+    const char *s = (const char *) src;
+    size_t head = (align - ((uintptr_t) d & (align - 1))) & (align - 1);
+
+    if (len < head + 4 * align) {
+        memcpy(dst, src, len);
+        return;
+    }
+
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    len -= head;
+
+    for ( ; len >= 4 * align; len -= 4 * align, d += 4 * align, s += 4 * align) {
+#if defined(__AVX__)
+        __m256i v0 = _mm256_loadu_si256((const __m256i *) s);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *) (s + 32));
+        __m256i v2 = _mm256_loadu_si256((const __m256i *) (s + 64));
+        __m256i v3 = _mm256_loadu_si256((const __m256i *) (s + 96));
+        _mm256_stream_si256((__m256i *) d, v0);
+        _mm256_stream_si256((__m256i *) (d + 32), v1);
+        _mm256_stream_si256((__m256i *) (d + 64), v2);
+        _mm256_stream_si256((__m256i *) (d + 96), v3);
+#else
+        __m128i v0 = _mm_loadu_si128((const __m128i *) s);
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *) (s + 48));
+        _mm_stream_si128((__m128i *) d, v0);
+        _mm_stream_si128((__m128i *) (d + 16), v1);
+        _mm_stream_si128((__m128i *) (d + 32), v2);
+        _mm_stream_si128((__m128i *) (d + 48), v3);
+#endif
+    }
+
+    memcpy(d, s, len);
+
+    /* Streaming stores are weakly ordered; make them visible before any
+     * subsequent flag update */
+    _mm_sfence();
+#else
+    memcpy(dst, src, len);
+#endif
+}
+
+
+static inline void
+shmem_internal_memcpy_part(shmem_memcpy_part_t *part)
+{
+    if (part->nt)
+        shmem_internal_memcpy_nt(part->dst, part->src, part->len);
+    else
+        memcpy(part->dst, part->src, part->len);
+}
+
+
+static void *
+shmem_internal_memcpy_thread(void *arg)
+{
+    shmem_memcpy_part_t *part = (shmem_memcpy_part_t *) arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&memcpy_mutex);
+    while (1) {
+        while (memcpy_gen == seen && !memcpy_shutdown)
+            pthread_cond_wait(&memcpy_cond, &memcpy_mutex);
+        if (memcpy_shutdown) break;
+        seen = memcpy_gen;
+        pthread_mutex_unlock(&memcpy_mutex);
+
+        if (part->len > 0)
+            shmem_internal_memcpy_part(part);
+        __atomic_store_n(&part->done, seen, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&memcpy_mutex);
+    }
+    pthread_mutex_unlock(&memcpy_mutex);
+
+    return NULL;
+}
+
+
+void
+shmem_internal_memcpy_large(void *dst, const void *src, size_t len)
+{
+    shmem_memcpy_part_t self;
+    size_t part_len, off;
+    uint64_t gen;
+    int i, nparts, nt = len >= memcpy_nt_min;
+
+    if (len < memcpy_thread_threshold || 0 != pthread_mutex_trylock(&memcpy_pool_lock)) {
+        if (nt)
+            shmem_internal_memcpy_nt(dst, src, len);
+        else
+            memcpy(dst, src, len);
+        return;
+    }
+
+    /* Split into parts that are a multiple of the cache line size, the
+     * calling thread takes the last one */
+    nparts = memcpy_nthreads + 1;
+    if (len / nparts < SHMEM_MEMCPY_MIN_PART)
+        nparts = (int) (len / SHMEM_MEMCPY_MIN_PART);
+    if (nparts < 1) nparts = 1;
+    part_len = ((len / nparts) + 63) & ~((size_t) 63);
+
+    for (i = 0, off = 0; i < memcpy_nthreads; i++) {
+        size_t n = (i < nparts - 1) ? part_len : 0;
+
+        memcpy_parts[i].dst = (char *) dst + off;
+        memcpy_parts[i].src = (const char *) src + off;
+        memcpy_parts[i].len = n;
+        memcpy_parts[i].nt = nt;
+        off += n;
+    }
+
+    self.dst = (char *) dst + off;
+    self.src = (const char *) src + off;
+    self.len = len - off;
+    self.nt = nt;
+
+    pthread_mutex_lock(&memcpy_mutex);
+    gen = ++memcpy_gen;
+    pthread_cond_broadcast(&memcpy_cond);
+    pthread_mutex_unlock(&memcpy_mutex);
+
+    shmem_internal_memcpy_part(&self);
+
+    for (i = 0; i < memcpy_nthreads; i++) {
+        while (__atomic_load_n(&memcpy_parts[i].done, __ATOMIC_ACQUIRE) != gen)
+            sched_yield();
+    }
+
+    pthread_mutex_unlock(&memcpy_pool_lock);
+}
+
+
+int
+shmem_internal_memcpy_init(void)
+{
+    size_t llc = shmem_internal_memcpy_llc_size();
+    int i, ret;
+
+    memcpy_nt_min = shmem_internal_params.MEMCPY_NT_THRESHOLD_provided ?
+                    shmem_internal_params.MEMCPY_NT_THRESHOLD : llc;
+    shmem_internal_memcpy_nt_threshold = memcpy_nt_min;
+
+    DEBUG_MSG("LLC size %zu, NT threshold %zu, %ld helper threads\n",
+              llc, memcpy_nt_min, shmem_internal_params.MEMCPY_THREADS);
+
+    if (shmem_internal_params.MEMCPY_THREADS <= 0)
+        return 0;
+
+    memcpy_thread_threshold =
+        shmem_internal_params.MEMCPY_THREAD_THRESHOLD_provided ?
+        shmem_internal_params.MEMCPY_THREAD_THRESHOLD : 4 * llc;
+
+    /* The pool is only reached through the large copy path */
+    if (memcpy_thread_threshold < shmem_internal_memcpy_nt_threshold)
+        shmem_internal_memcpy_nt_threshold = memcpy_thread_threshold;
+
+    memcpy_parts = calloc(shmem_internal_params.MEMCPY_THREADS, sizeof(shmem_memcpy_part_t));
+    memcpy_threads = calloc(shmem_internal_params.MEMCPY_THREADS, sizeof(pthread_t));
+    if (NULL == memcpy_parts || NULL == memcpy_threads) {
+        RETURN_ERROR_STR("Out of memory allocating memcpy thread pool");
+        return 1;
+    }
+
+    for (i = 0; i < shmem_internal_params.MEMCPY_THREADS; i++) {
+        ret = pthread_create(&memcpy_threads[i], NULL, shmem_internal_memcpy_thread,
+                             &memcpy_parts[i]);
+        if (0 != ret) {
+            RAISE_WARN_MSG("Unable to create memcpy helper thread (%d), using %d\n",
+                           ret, i);
+            break;
+        }
+        memcpy_nthreads++;
+    }
+
+    return 0;
+}
+
+
+void
+shmem_internal_memcpy_fini(void)
+{
+    int i;
+
+    shmem_internal_memcpy_nt_threshold = SIZE_MAX;
+    memcpy_nt_min = SIZE_MAX;
+    memcpy_thread_threshold = SIZE_MAX;
+
+    if (0 == memcpy_nthreads) return;
+
+    pthread_mutex_lock(&memcpy_mutex);
+    memcpy_shutdown = 1;
+    pthread_cond_broadcast(&memcpy_cond);
+    pthread_mutex_unlock(&memcpy_mutex);
+
+    for (i = 0; i < memcpy_nthreads; i++)
+        pthread_join(memcpy_threads[i], NULL);
+
+    free(memcpy_threads);
+    free(memcpy_parts);
+    memcpy_threads = NULL;
+    memcpy_parts = NULL;
+    memcpy_nthreads = 0;
+    memcpy_shutdown = 0;
+}
+
+#else
+
+int
+shmem_internal_memcpy_init(void)
+{
+    return 0;
+}
+
+
+void
+shmem_internal_memcpy_fini(void)
+{
+}
+
+
+void
+shmem_internal_memcpy_large(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+#endif /* USE_XPMEM || USE_SHM */
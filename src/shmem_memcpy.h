@@ -0,0 +1,49 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_MEMCPY_H
+#define SHMEM_MEMCPY_H
+
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Size-tiered copy engine for the load/store on-node transports.  Copies
+ * smaller than the non-temporal threshold use memcpy.  Larger copies use
+ * streaming stores so they do not evict the working set from the caches,
+ * and copies above the thread threshold are also split across a pool of
+ * helper threads.
+ */
+
+extern size_t shmem_internal_memcpy_nt_threshold;
+
+int shmem_internal_memcpy_init(void);
+
+void shmem_internal_memcpy_fini(void);
+
+void shmem_internal_memcpy_large(void *dst, const void *src, size_t len);
+
+
+static inline
+void
+shmem_internal_shr_memcpy(void *dst, const void *src, size_t len)
+{
+    if (len < shmem_internal_memcpy_nt_threshold)
+        memcpy(dst, src, len);
+    else
+        shmem_internal_memcpy_large(dst, src, len);
+}
+
+#endif
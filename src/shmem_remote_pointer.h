@@ -30,10 +30,16 @@ shmem_internal_ptr(const void *target, int pe)
     if (pe == shmem_internal_my_pe)
         return (void *) target;
 
+    /* Memory spaces are not mapped by the on-node transports */
+    if (shmem_internal_space_index(target) >= 0)
+        return NULL;
+
     // Only if regular load/stores are used to implement put/get!
     if (-1 != (node_rank = shmem_internal_get_shr_rank(pe))) {
 #if USE_XPMEM
         return shmem_transport_xpmem_ptr(target, pe, node_rank);
+#elif USE_SHM
+        return shmem_transport_shm_ptr(target, pe, node_rank);
 #else
         return NULL;
 #endif
@@ -43,4 +49,31 @@ shmem_internal_ptr(const void *target, int pe)
 }
 
 
+/* Whether shmem_internal_ptr() would return a valid pointer, without
+ * mapping the peer's memory */
+static inline int
+shmem_internal_ptr_available(const void *target, int pe)
+{
+    int node_rank;
+
+    if (pe == shmem_internal_my_pe)
+        return 1;
+
+    if (shmem_internal_space_index(target) >= 0)
+        return 0;
+
+    if (-1 != (node_rank = shmem_internal_get_shr_rank(pe))) {
+#if USE_XPMEM
+        return 1;
+#elif USE_SHM
+        return NULL != shmem_transport_shm_ptr(target, pe, node_rank);
+#else
+        return 0;
+#endif
+    } else {
+        return 0;
+    }
+}
+
+
 #endif /* #ifndef SHMEM_REMOTE_POINTER_H */
@@ -0,0 +1,246 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Scanning of flag arrays for the wait_until_{all,any,some} and
+ * test_{all,any,some} routines.
+ *
+ * Elements are compared in fixed size blocks with the comparison hoisted out
+ * of the loop, so that the compiler turns each block into a few vector
+ * compares.  A block containing a match is then rescanned element by element
+ * with SYNC_LOAD, which provides the ordering required for the element that is
+ * reported.  Elements ignored through the status array are tracked in a
+ * bitmap built once per call, so fully active or fully ignored ranges cost
+ * neither a load of status nor a branch per element while polling.
+ */
+
+#ifndef SHMEM_SYNC_SCAN_H
+#define SHMEM_SYNC_SCAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "shmem_synchronization.h"
+
+#define SHMEM_SYNC_SCAN_BLOCK 16
+
+/* Status bitmaps of up to this many words live on the stack */
+#define SHMEM_SYNC_ACTIVE_STACK_WORDS 64
+
+struct shmem_internal_sync_active_t {
+    uint64_t *bits;         /* Bit set for elements not ignored, or NULL */
+    uint64_t stack[SHMEM_SYNC_ACTIVE_STACK_WORDS];
+};
+typedef struct shmem_internal_sync_active_t shmem_internal_sync_active_t;
+
+
+/* Build the bitmap of the elements not ignored through status and return
+ * their number.  Without a status array, no bitmap is needed. */
+static inline size_t
+shmem_internal_sync_active_init(shmem_internal_sync_active_t *active,
+                                const int *status, size_t nelems)
+{
+    size_t i, nwords = (nelems + 63) / 64, nactive = 0;
+
+    active->bits = NULL;
+    if (NULL == status) return nelems;
+
+    if (nwords <= SHMEM_SYNC_ACTIVE_STACK_WORDS) {
+        active->bits = active->stack;
+    } else {
+        active->bits = malloc(nwords * sizeof(uint64_t));
+        if (NULL == active->bits)
+            RAISE_ERROR_MSG("Out of memory allocating status bitmap (%zu elements)\n",
+                            nelems);
+    }
+
+    for (i = 0; i < nwords; i++)
+        active->bits[i] = 0;
+
+    for (i = 0; i < nelems; i++) {
+        if (!status[i]) {
+            active->bits[i / 64] |= UINT64_C(1) << (i % 64);
+            nactive++;
+        }
+    }
+
+    return nactive;
+}
+
+
+static inline void
+shmem_internal_sync_active_fini(shmem_internal_sync_active_t *active)
+{
+    if (NULL != active->bits && active->bits != active->stack)
+        free(active->bits);
+}
+
+
+/* Condition that holds exactly when cond does not */
+static inline int
+shmem_internal_sync_cmp_not(int cond)
+{
+    switch (cond) {
+    case SHMEM_CMP_EQ: return SHMEM_CMP_NE;
+    case SHMEM_CMP_NE: return SHMEM_CMP_EQ;
+    case SHMEM_CMP_GT: return SHMEM_CMP_LE;
+    case SHMEM_CMP_GE: return SHMEM_CMP_LT;
+    case SHMEM_CMP_LT: return SHMEM_CMP_GE;
+    case SHMEM_CMP_LE: return SHMEM_CMP_GT;
+    default:
+        RAISE_ERROR(-1);
+    }
+    return -1;
+}
+
+
+/* Random start index in [0, n) for the any-scans, so that waiting PEs and
+ * threads do not all favor the front of the array.  The generator state is
+ * per thread, so concurrent waiters do not serialize on a lock. */
+static inline size_t
+shmem_internal_sync_rand(size_t n)
+{
+    static __thread uint32_t state = 0;
+
+    if (0 == state)
+        state = ((uint32_t) shmem_internal_rand_seed * UINT32_C(2654435761)) ^
+                ((uint32_t) (uintptr_t) &state | 1);
+
+    /* xorshift32 */
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return (n <= UINT32_MAX) ? (size_t) (((uint64_t) state * n) >> 32) : state % n;
+}
+
+
+#define SHMEM_SYNC_SCAN_VALUE(k)  value
+#define SHMEM_SYNC_SCAN_VALUES(k) values[k]
+
+/* Advance i past the blocks of vars[i, end) in which no element satisfies
+ * "vars[k] OP RHS(k)".  Stops at the first block with a match, or when less
+ * than a block is left. */
+#define SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, OP, RHS)                   \
+    do {                                                                \
+        for (; i + SHMEM_SYNC_SCAN_BLOCK <= end;                        \
+             i += SHMEM_SYNC_SCAN_BLOCK) {                              \
+            int _hit = 0;                                               \
+            size_t _j;                                                  \
+            for (_j = 0; _j < SHMEM_SYNC_SCAN_BLOCK; _j++)              \
+                _hit |= (vars[i + _j] OP RHS(i + _j));                  \
+            if (_hit) break;                                            \
+        }                                                               \
+    } while (0)
+
+#define SHMEM_SYNC_SCAN_SWITCH(vars, i, end, cond, RHS)                 \
+    do {                                                                \
+        switch (cond) {                                                 \
+        case SHMEM_CMP_EQ:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, ==, RHS);              \
+            break;                                                      \
+        case SHMEM_CMP_NE:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, !=, RHS);              \
+            break;                                                      \
+        case SHMEM_CMP_GT:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, >, RHS);               \
+            break;                                                      \
+        case SHMEM_CMP_GE:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, >=, RHS);              \
+            break;                                                      \
+        case SHMEM_CMP_LT:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, <, RHS);               \
+            break;                                                      \
+        case SHMEM_CMP_LE:                                              \
+            SHMEM_SYNC_SCAN_BLOCKS(vars, i, end, <=, RHS);              \
+            break;                                                      \
+        default:                                                        \
+            RAISE_ERROR(-1);                                            \
+        }                                                               \
+    } while (0)
+
+/* Define shmem_internal_<STYPE>_sync_scan(vars, i, end, active, cond, value,
+ * values), which returns the index of the first element of vars[i, end) that
+ * is active and satisfies cond against value (or values[k] if values is not
+ * NULL), or end if there is none. */
+#define SHMEM_DEF_SYNC_SCAN(STYPE,TYPE)                                                 \
+    static inline size_t                                                                \
+    shmem_internal_##STYPE##_sync_scan_dense(const TYPE *vars, size_t i,                \
+                                             size_t end, int cond, TYPE value,          \
+                                             const TYPE *values)                        \
+    {                                                                                   \
+        while (i < end) {                                                               \
+            size_t stop;                                                                \
+                                                                                        \
+            if (NULL == values)                                                         \
+                SHMEM_SYNC_SCAN_SWITCH(vars, i, end, cond, SHMEM_SYNC_SCAN_VALUE);      \
+            else                                                                        \
+                SHMEM_SYNC_SCAN_SWITCH(vars, i, end, cond, SHMEM_SYNC_SCAN_VALUES);     \
+                                                                                        \
+            stop = (end - i < SHMEM_SYNC_SCAN_BLOCK) ? end : i + SHMEM_SYNC_SCAN_BLOCK; \
+            for (; i < stop; i++) {                                                     \
+                int cmpret;                                                             \
+                SHMEM_TEST(cond, &vars[i], ((NULL == values) ? value : values[i]),      \
+                           cmpret);                                                     \
+                if (cmpret) return i;                                                   \
+            }                                                                           \
+        }                                                                               \
+                                                                                        \
+        return end;                                                                     \
+    }                                                                                   \
+                                                                                        \
+    static inline size_t                                                                \
+    shmem_internal_##STYPE##_sync_scan(const TYPE *vars, size_t i, size_t end,          \
+                                       const shmem_internal_sync_active_t *active,      \
+                                       int cond, TYPE value, const TYPE *values)        \
+    {                                                                                   \
+        /* Reload the flags on every call */                                            \
+        COMPILER_FENCE();                                                               \
+                                                                                        \
+        if (NULL == active->bits)                                                       \
+            return shmem_internal_##STYPE##_sync_scan_dense(vars, i, end, cond,         \
+                                                            value, values);             \
+                                                                                        \
+        while (i < end) {                                                               \
+            size_t stop = (i / 64 + 1) * 64;                                            \
+            size_t len, r;                                                              \
+            uint64_t bits, mask;                                                        \
+                                                                                        \
+            if (stop > end) stop = end;                                                 \
+            len = stop - i;                                                             \
+            mask = (len == 64) ? ~UINT64_C(0) : (UINT64_C(1) << len) - 1;               \
+            bits = (active->bits[i / 64] >> (i % 64)) & mask;                           \
+                                                                                        \
+            if (bits == mask) {                                                         \
+                r = shmem_internal_##STYPE##_sync_scan_dense(vars, i, stop, cond,       \
+                                                             value, values);            \
+                if (r < stop) return r;                                                 \
+            } else {                                                                    \
+                while (bits) {                                                          \
+                    size_t k = i + __builtin_ctzll(bits);                               \
+                    int cmpret;                                                         \
+                    SHMEM_TEST(cond, &vars[k], ((NULL == values) ? value : values[k]),  \
+                               cmpret);                                                 \
+                    if (cmpret) return k;                                               \
+                    bits &= bits - 1;                                                   \
+                }                                                                       \
+            }                                                                           \
+            i = stop;                                                                   \
+        }                                                                               \
+                                                                                        \
+        return end;                                                                     \
+    }
+
+#endif
@@ -19,6 +19,7 @@
 #include "shmem_atomic.h"
 #include "shmem_comm.h"
 #include "transport.h"
+#include "shmem_wait.h"
 
 static inline void
 shmem_internal_quiet(shmem_ctx_t ctx)
@@ -58,6 +59,37 @@ shmem_internal_fence(shmem_ctx_t ctx)
      * transport level memory flush is not required here. */
 }
 
+/* Complete or order only the operations issued to pe, a world team PE */
+static inline void
+shmem_internal_quiet_pe(shmem_ctx_t ctx, int pe)
+{
+    int ret;
+
+    if (ctx == SHMEM_CTX_INVALID)
+        return;
+
+    ret = shmem_transport_quiet_pe((shmem_transport_ctx_t *)ctx, pe);
+    if (0 != ret) { RAISE_ERROR(ret); }
+
+    shmem_internal_membar();
+    shmem_transport_syncmem();
+}
+
+
+static inline void
+shmem_internal_fence_pe(shmem_ctx_t ctx, int pe)
+{
+    int ret;
+
+    if (ctx == SHMEM_CTX_INVALID)
+        return;
+
+    ret = shmem_transport_fence_pe((shmem_transport_ctx_t *)ctx, pe);
+    if (0 != ret) { RAISE_ERROR(ret); }
+
+    shmem_internal_membar_release();
+}
+
 #define COMP(type, a, b, ret)                            \
     do {                                                 \
         ret = 0;                                         \
@@ -174,23 +206,110 @@ shmem_internal_fence(shmem_ctx_t ctx)
         }                                                               \
     } while(0)
 
+/* Wait according to SHMEM_WAIT_POLICY.  CHECK must evaluate the wait
+ * condition into cmpret.  Blocking parks on the on-node wake word when
+ * can_block includes SHMEM_INTERNAL_WAIT_CAN_PARK, and otherwise uses the
+ * received counter, so it is only possible when can_block is set.  The
+ * condition is checked again after announcing the parked waiter, so that an
+ * update racing with the announcement is not missed. */
+#define SHMEM_WAIT_UNTIL_POLICY_LOOP(CHECK, can_block)                  \
+    do {                                                                \
+        int cmpret;                                                     \
+                                                                        \
+        CHECK;                                                          \
+        if (!cmpret) {                                                  \
+            shmem_internal_waiter_t waiter;                             \
+            uint64_t target_cntr;                                       \
+            uint32_t wake_seq;                                          \
+            int wait_flags = (can_block);                               \
+                                                                        \
+            shmem_internal_waiter_start(&waiter,                        \
+                                        &shmem_internal_sync_wait_state,\
+                                        wait_flags);                    \
+            while (!cmpret) {                                           \
+                switch (shmem_internal_waiter_next(&waiter)) {          \
+                case SHMEM_INTERNAL_WAIT_MODE_BLOCK:                    \
+                    if (wait_flags & SHMEM_INTERNAL_WAIT_CAN_PARK) {    \
+                        shmem_transport_probe();                        \
+                        wake_seq = shmem_shr_transport_park_begin();    \
+                        CHECK;                                          \
+                        if (!cmpret)                                    \
+                            shmem_shr_transport_park(wake_seq);         \
+                        shmem_shr_transport_park_end();                 \
+                        break;                                          \
+                    }                                                   \
+                    target_cntr = shmem_transport_received_cntr_get();  \
+                    COMPILER_FENCE();                                   \
+                    CHECK;                                              \
+                    if (cmpret) break;                                  \
+                    shmem_transport_received_cntr_wait(target_cntr + 1);\
+                    break;                                              \
+                case SHMEM_INTERNAL_WAIT_MODE_YIELD:                    \
+                    shmem_transport_probe();                            \
+                    sched_yield();                                      \
+                    break;                                              \
+                default:                                                \
+                    shmem_transport_probe();                            \
+                    SPINLOCK_BODY();                                    \
+                }                                                       \
+                CHECK;                                                  \
+            }                                                           \
+            shmem_internal_waiter_end(&waiter);                         \
+        }                                                               \
+    } while(0)
+
+#define SHMEM_WAIT_UNTIL_POLICY(var, cond, value, can_block)            \
+    SHMEM_WAIT_UNTIL_POLICY_LOOP(COMP(cond, SYNC_LOAD(var), value, cmpret), \
+                                 can_block)
+
+#define SHMEM_SIGNAL_WAIT_UNTIL_POLICY(var, cond, value, sat_value, can_block) \
+    SHMEM_WAIT_UNTIL_POLICY_LOOP(COMP_SIGNAL(cond, SYNC_LOAD(var), value, \
+                                             cmpret, sat_value), can_block)
+
+/* Waits that would otherwise poll can park when the on-node transport
+ * provides a wake word (SHMEM_SHM_WAIT_FUTEX) */
+#define SHMEM_WAIT_CAN_PARK()                                           \
+    (shmem_shr_transport_can_park() ? SHMEM_INTERNAL_WAIT_CAN_PARK : 0)
+
 /* Polling based wait is required for providers that need 
  * manual progress, i.e., cxi. This is enabled through 
  * ENABLE_FI_MANUAL_PROGRESS */
 #if defined(ENABLE_HARD_POLLING) || defined(ENABLE_FI_MANUAL_PROGRESS)
 #define SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value)                     \
-    SHMEM_WAIT_UNTIL_POLL(var, cond, value)
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO || \
+        shmem_shr_transport_can_park()) {                               \
+        SHMEM_WAIT_UNTIL_POLICY(var, cond, value, SHMEM_WAIT_CAN_PARK()); \
+    } else {                                                            \
+        SHMEM_WAIT_UNTIL_POLL(var, cond, value);                        \
+    }
 #define SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)   \
-    SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value)
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO || \
+        shmem_shr_transport_can_park()) {                               \
+        SHMEM_SIGNAL_WAIT_UNTIL_POLICY(var, cond, value, sat_value,     \
+                                       SHMEM_WAIT_CAN_PARK());          \
+    } else {                                                            \
+        SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value);      \
+    }
 #else
+/* Blocking on the received counter is only safe in single-threaded runs and
+ * when the transport does not rely on this PE polling for progress */
+#define SHMEM_WAIT_CAN_BLOCK()                                          \
+    (shmem_internal_thread_level == SHMEM_THREAD_SINGLE &&              \
+     shmem_transport_received_cntr_can_wait())
+
 #define SHMEM_INTERNAL_WAIT_UNTIL(var, cond, value)                     \
-    if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE) {           \
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO) { \
+        SHMEM_WAIT_UNTIL_POLICY(var, cond, value, SHMEM_WAIT_CAN_BLOCK()); \
+    } else if (SHMEM_WAIT_CAN_BLOCK()) {                                \
         SHMEM_WAIT_UNTIL_BLOCK(var, cond, value);                       \
     } else {                                                            \
         SHMEM_WAIT_UNTIL_POLL(var, cond, value);                        \
     }
 #define SHMEM_INTERNAL_SIGNAL_WAIT_UNTIL(var, cond, value, sat_value)   \
-    if (shmem_internal_thread_level == SHMEM_THREAD_SINGLE) {           \
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO) { \
+        SHMEM_SIGNAL_WAIT_UNTIL_POLICY(var, cond, value, sat_value,     \
+                                       SHMEM_WAIT_CAN_BLOCK());         \
+    } else if (SHMEM_WAIT_CAN_BLOCK()) {                                \
         SHMEM_SIGNAL_WAIT_UNTIL_BLOCK(var, cond, value, sat_value);     \
     } else {                                                            \
         SHMEM_SIGNAL_WAIT_UNTIL_POLL(var, cond, value, sat_value);      \
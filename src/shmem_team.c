@@ -115,8 +115,7 @@ int shmem_internal_team_init(void)
         int start = -1, stride = -1, size = 0;
 
         for (int pe = 0; pe < shmem_internal_num_pes; pe++) {
-            void *ret_ptr = shmem_internal_ptr(shmem_internal_heap_base, pe);
-            if (ret_ptr == NULL) continue;
+            if (!shmem_internal_ptr_available(shmem_internal_heap_base, pe)) continue;
 
             int ret = check_for_linear_stride(pe, &start, &stride, &size);
             if (ret < 0) {
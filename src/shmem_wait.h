@@ -0,0 +1,238 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef SHMEM_WAIT_H
+#define SHMEM_WAIT_H
+
+#include <sched.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "shmem_internal.h"
+#include "shmem_atomic.h"
+
+/*
+ * Wait policy engine shared by completion (quiet, fence, get_wait) and
+ * point-to-point synchronization waits.  Each waiter starts out spinning,
+ * then yields the CPU, then blocks in the transport.  In adaptive mode the
+ * spin budget is derived from a running estimate of how long previous
+ * waits on the same state took, so short waits never pay the wakeup cost
+ * and long waits stop burning a core.
+ */
+
+enum shmem_internal_wait_policy_t {
+    SHMEM_INTERNAL_WAIT_POLICY_AUTO = 0,
+    SHMEM_INTERNAL_WAIT_POLICY_SPIN,
+    SHMEM_INTERNAL_WAIT_POLICY_BLOCK,
+    SHMEM_INTERNAL_WAIT_POLICY_ADAPTIVE
+};
+
+enum shmem_internal_wait_mode_t {
+    SHMEM_INTERNAL_WAIT_MODE_SPIN = 0,
+    SHMEM_INTERNAL_WAIT_MODE_YIELD,
+    SHMEM_INTERNAL_WAIT_MODE_BLOCK,
+    SHMEM_INTERNAL_WAIT_MODE_COUNT
+};
+
+/* Ways in which a waiter can sleep once it stops spinning (see
+ * shmem_internal_waiter_start) */
+#define SHMEM_INTERNAL_WAIT_CAN_BLOCK 0x1   /* Transport received counter */
+#define SHMEM_INTERNAL_WAIT_CAN_PARK  0x2   /* On-node wake word */
+
+/* Check the clock once every this many spin iterations */
+#define SHMEM_INTERNAL_WAIT_CLOCK_INTERVAL 64
+
+struct shmem_internal_wait_state_t {
+    uint64_t est_ns;    /* Running average of observed wait durations */
+    uint64_t time_ns[SHMEM_INTERNAL_WAIT_MODE_COUNT];
+    uint64_t count;     /* Number of waits that did not complete immediately */
+};
+typedef struct shmem_internal_wait_state_t shmem_internal_wait_state_t;
+
+struct shmem_internal_waiter_t {
+    shmem_internal_wait_state_t *state;
+    uint64_t start_ns;
+    uint64_t mode_start_ns;
+    uint64_t spin_budget_ns;
+    uint64_t yield_budget_ns;
+    unsigned int iter;
+    int mode;
+    int can_block;
+};
+typedef struct shmem_internal_waiter_t shmem_internal_waiter_t;
+
+extern int shmem_internal_wait_policy;
+extern uint64_t shmem_internal_wait_spin_ns;
+extern uint64_t shmem_internal_wait_yield_ns;
+extern shmem_internal_wait_state_t shmem_internal_sync_wait_state;
+
+static inline uint64_t
+shmem_internal_wait_now_ns(void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec tv;
+    clock_gettime(CLOCK_MONOTONIC, &tv);
+    return (uint64_t) tv.tv_sec * 1000000000 + tv.tv_nsec;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t) tv.tv_sec * 1000000000 + tv.tv_usec * 1000;
+#endif
+}
+
+static inline void
+shmem_internal_wait_state_init(shmem_internal_wait_state_t *state)
+{
+    int i;
+
+    state->est_ns = shmem_internal_wait_spin_ns / 2;
+    for (i = 0; i < SHMEM_INTERNAL_WAIT_MODE_COUNT; i++)
+        state->time_ns[i] = 0;
+    state->count = 0;
+}
+
+/* Begin a wait that did not complete on the first check.  'can_block' is
+ * false when the caller has no way to sleep in the transport (e.g., the
+ * received counter is only usable in single-threaded runs); block mode then
+ * degrades to yielding.  Otherwise, it holds SHMEM_INTERNAL_WAIT_CAN_* flags
+ * naming how the caller sleeps.  A waiter that can park leaves the auto
+ * policy's endless spin after the spin budget. */
+static inline void
+shmem_internal_waiter_start(shmem_internal_waiter_t *w,
+                            shmem_internal_wait_state_t *state, int can_block)
+{
+    uint64_t est = __atomic_load_n(&state->est_ns, __ATOMIC_RELAXED);
+
+    w->state = state;
+    w->can_block = can_block;
+    w->iter = 0;
+    w->start_ns = w->mode_start_ns = shmem_internal_wait_now_ns();
+
+    switch (shmem_internal_wait_policy) {
+        case SHMEM_INTERNAL_WAIT_POLICY_BLOCK:
+            w->spin_budget_ns = 0;
+            w->yield_budget_ns = 0;
+            break;
+        case SHMEM_INTERNAL_WAIT_POLICY_ADAPTIVE:
+            if (est < shmem_internal_wait_spin_ns) {
+                /* Completions usually arrive while spinning; allow some
+                 * headroom over the average before giving up the core */
+                w->spin_budget_ns = 2 * est;
+                if (w->spin_budget_ns > shmem_internal_wait_spin_ns)
+                    w->spin_budget_ns = shmem_internal_wait_spin_ns;
+                w->yield_budget_ns = shmem_internal_wait_yield_ns;
+            } else if (est < shmem_internal_wait_spin_ns + shmem_internal_wait_yield_ns) {
+                w->spin_budget_ns = shmem_internal_wait_spin_ns / 4;
+                w->yield_budget_ns = shmem_internal_wait_yield_ns;
+            } else {
+                /* Long waits; sleep as soon as a short spin fails */
+                w->spin_budget_ns = shmem_internal_wait_spin_ns / 4;
+                w->yield_budget_ns = 0;
+            }
+            break;
+        case SHMEM_INTERNAL_WAIT_POLICY_AUTO:
+            w->spin_budget_ns = (can_block & SHMEM_INTERNAL_WAIT_CAN_PARK) ?
+                                shmem_internal_wait_spin_ns : UINT64_MAX;
+            w->yield_budget_ns = 0;
+            break;
+        default:
+            w->spin_budget_ns = UINT64_MAX;
+            w->yield_budget_ns = 0;
+            break;
+    }
+
+    if (w->spin_budget_ns > 0)
+        w->mode = SHMEM_INTERNAL_WAIT_MODE_SPIN;
+    else if (w->yield_budget_ns > 0 || !can_block)
+        w->mode = SHMEM_INTERNAL_WAIT_MODE_YIELD;
+    else
+        w->mode = SHMEM_INTERNAL_WAIT_MODE_BLOCK;
+}
+
+static inline void
+shmem_internal_waiter_switch(shmem_internal_waiter_t *w, int mode, uint64_t now)
+{
+    __atomic_fetch_add(&w->state->time_ns[w->mode], now - w->mode_start_ns,
+                       __ATOMIC_RELAXED);
+    w->mode = mode;
+    w->mode_start_ns = now;
+}
+
+/* Return the mode the caller should use for its next iteration */
+static inline int
+shmem_internal_waiter_next(shmem_internal_waiter_t *w)
+{
+    uint64_t now;
+
+    switch (w->mode) {
+        case SHMEM_INTERNAL_WAIT_MODE_SPIN:
+            if (w->spin_budget_ns == UINT64_MAX ||
+                ++w->iter % SHMEM_INTERNAL_WAIT_CLOCK_INTERVAL != 0)
+                break;
+
+            now = shmem_internal_wait_now_ns();
+            if (now - w->start_ns >= w->spin_budget_ns) {
+                if (w->yield_budget_ns > 0 || !w->can_block)
+                    shmem_internal_waiter_switch(w, SHMEM_INTERNAL_WAIT_MODE_YIELD, now);
+                else
+                    shmem_internal_waiter_switch(w, SHMEM_INTERNAL_WAIT_MODE_BLOCK, now);
+            }
+            break;
+
+        case SHMEM_INTERNAL_WAIT_MODE_YIELD:
+            if (!w->can_block)
+                break;
+
+            now = shmem_internal_wait_now_ns();
+            if (now - w->mode_start_ns >= w->yield_budget_ns)
+                shmem_internal_waiter_switch(w, SHMEM_INTERNAL_WAIT_MODE_BLOCK, now);
+            break;
+
+        default:
+            break;
+    }
+
+    return w->mode;
+}
+
+/* Complete a wait, charging the elapsed time to the current mode and
+ * folding the total into the running estimate (EWMA, alpha = 1/8) */
+static inline void
+shmem_internal_waiter_end(shmem_internal_waiter_t *w)
+{
+    uint64_t now = shmem_internal_wait_now_ns();
+    uint64_t elapsed = now - w->start_ns;
+    uint64_t est = __atomic_load_n(&w->state->est_ns, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&w->state->time_ns[w->mode], now - w->mode_start_ns,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&w->state->count, 1, __ATOMIC_RELAXED);
+
+    if (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_ADAPTIVE)
+        __atomic_store_n(&w->state->est_ns, est - est / 8 + elapsed / 8,
+                         __ATOMIC_RELAXED);
+}
+
+static inline void
+shmem_internal_wait_state_get(shmem_internal_wait_state_t *state,
+                              shmemx_pcntr_wait_t *wait)
+{
+    wait->spin_ns  += __atomic_load_n(&state->time_ns[SHMEM_INTERNAL_WAIT_MODE_SPIN], __ATOMIC_RELAXED);
+    wait->yield_ns += __atomic_load_n(&state->time_ns[SHMEM_INTERNAL_WAIT_MODE_YIELD], __ATOMIC_RELAXED);
+    wait->block_ns += __atomic_load_n(&state->time_ns[SHMEM_INTERNAL_WAIT_MODE_BLOCK], __ATOMIC_RELAXED);
+    wait->count    += __atomic_load_n(&state->count, __ATOMIC_RELAXED);
+}
+
+#endif /* SHMEM_WAIT_H */
@@ -26,6 +26,10 @@
 #ifdef __linux__
 #include <mntent.h>
 #include <sys/vfs.h>
+#include <sys/syscall.h>
+#endif
+#ifdef ENABLE_THREADS
+#include <pthread.h>
 #endif
 
 #define SHMEM_INTERNAL_INCLUDE
@@ -33,6 +37,7 @@
 #include "shmem_internal.h"
 #include "shmem_comm.h"
 #include "shmem_collectives.h"
+#include "shmem_team.h"
 #include "shmemx.h"
 
 #ifdef ENABLE_PROFILING
@@ -71,15 +76,182 @@
 #pragma weak shmemx_heap_create = pshmemx_heap_create
 #define shmemx_heap_create pshmemx_heap_create
 
+#pragma weak shmemx_register_buffer = pshmemx_register_buffer
+#define shmemx_register_buffer pshmemx_register_buffer
+
+#pragma weak shmemx_unregister_buffer = pshmemx_unregister_buffer
+#define shmemx_unregister_buffer pshmemx_unregister_buffer
+
+#pragma weak shmemx_malloc_n = pshmemx_malloc_n
+#define shmemx_malloc_n pshmemx_malloc_n
+
+#pragma weak shmemx_free_deferred = pshmemx_free_deferred
+#define shmemx_free_deferred pshmemx_free_deferred
+
+#pragma weak shmemx_heap_stats = pshmemx_heap_stats
+#define shmemx_heap_stats pshmemx_heap_stats
+
 #endif /* ENABLE_PROFILING */
 
 static char *shmem_internal_heap_curr = NULL;
+static size_t shmem_internal_heap_page_size = 0;
 
 void* dlmalloc(size_t);
 void* dlcalloc(size_t, size_t);
 void  dlfree(void*);
 void* dlrealloc(void*, size_t);
 void* dlmemalign(size_t, size_t);
+void  dlmalloc_inspect_all(void(*)(void*, void*, size_t, void*), void*);
+size_t dlmalloc_footprint(void);
+size_t dlmalloc_max_footprint(void);
+void  mspace_inspect_all(void*, void(*)(void*, void*, size_t, void*), void*);
+size_t mspace_footprint(void*);
+size_t mspace_max_footprint(void*);
+
+
+/* Allocate from the size-class slabs when possible, otherwise from the
+ * general heap.  Must be called with shmem_internal_mutex_alloc held. */
+static inline void *
+symmetric_malloc(size_t size)
+{
+    void *ret = shmem_internal_slab_alloc(size);
+
+    return (NULL != ret) ? ret : dlmalloc(size);
+}
+
+
+/* Objects released with shmemx_free_deferred, returned to the heap at the
+ * next synchronizing allocation routine.  Protected by
+ * shmem_internal_mutex_alloc. */
+static void **symmetric_deferred = NULL;
+static size_t symmetric_deferred_count = 0;
+static size_t symmetric_deferred_max = 0;
+
+
+#ifdef ENABLE_ERROR_CHECKING
+/* Running hash of the allocation sequence (operation, size and offset of the
+ * result), compared across PEs at synchronizing allocation routines when
+ * SHMEM_SYMMETRIC_HEAP_CHECK is set.  Protected by
+ * shmem_internal_mutex_alloc. */
+#define SYMMETRIC_HASH_INIT  14695981039346656037ULL
+#define SYMMETRIC_HASH_PRIME 1099511628211ULL
+
+enum symmetric_op_t {
+    SYMMETRIC_OP_MALLOC = 1,
+    SYMMETRIC_OP_CALLOC,
+    SYMMETRIC_OP_ALIGN,
+    SYMMETRIC_OP_REALLOC,
+    SYMMETRIC_OP_FREE,
+    SYMMETRIC_OP_FREE_DEFERRED
+};
+
+static uint64_t symmetric_seq_hash = SYMMETRIC_HASH_INIT;
+static uint64_t symmetric_seq_count = 0;
+static uint64_t *symmetric_seq_root = NULL;   /* bcast target, on the heap */
+
+/* Offset of ptr within its symmetric region, which is the same on all PEs
+ * even if the regions are mapped at different addresses */
+static inline uint64_t
+symmetric_offset(const void *ptr)
+{
+    int idx;
+
+    if (NULL == ptr) return UINT64_MAX;
+
+    idx = shmem_internal_space_index(ptr);
+    if (idx >= 0)
+        return ((uint64_t) (idx + 1) << 56) |
+               (uint64_t) ((uint8_t *) ptr - (uint8_t *) shmem_internal_spaces[idx].base);
+
+    return (uint64_t) ((uint8_t *) ptr - (uint8_t *) shmem_internal_heap_base);
+}
+
+static inline void
+symmetric_record(int op, size_t size, const void *ptr)
+{
+    uint64_t v[3] = { (uint64_t) op, (uint64_t) size, symmetric_offset(ptr) };
+    int i;
+
+    for (i = 0; i < 3; i++)
+        symmetric_seq_hash = (symmetric_seq_hash ^ v[i]) * SYMMETRIC_HASH_PRIME;
+    symmetric_seq_count++;
+}
+
+/* Compare the allocation sequence of this PE against PE 0 */
+static void
+symmetric_check(void)
+{
+    uint64_t local[2];
+    long *psync;
+    int first = 0;
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    /* Allocated on first use, at the same point on all PEs */
+    if (NULL == symmetric_seq_root) {
+        symmetric_seq_root = dlmalloc(sizeof(local));
+        if (NULL == symmetric_seq_root)
+            RAISE_ERROR_STR("Out of symmetric memory for the allocation check");
+        first = 1;
+    }
+    local[0] = symmetric_seq_hash;
+    local[1] = symmetric_seq_count;
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    /* The target must be allocated on all PEs before PE 0 writes to it */
+    if (first)
+        shmem_internal_barrier_all();
+
+    psync = shmem_internal_team_choose_psync(&shmem_internal_team_world, BCAST);
+    shmem_internal_bcast(symmetric_seq_root, local, sizeof(local), 0, 0, 1,
+                         shmem_internal_num_pes, psync, 1);
+    shmem_internal_team_release_psyncs(&shmem_internal_team_world, BCAST);
+
+    if (shmem_internal_my_pe != 0 &&
+        (symmetric_seq_root[0] != local[0] || symmetric_seq_root[1] != local[1])) {
+        RAISE_ERROR_MSG("Symmetric allocation sequence differs from PE 0 "
+                        "(%"PRIu64" vs. %"PRIu64" operations, hash %#"PRIx64" vs. %#"PRIx64")\n",
+                        local[1], symmetric_seq_root[1], local[0], symmetric_seq_root[0]);
+    }
+}
+
+#define SYMMETRIC_RECORD(op, size, ptr) symmetric_record(op, size, ptr)
+#else
+#define SYMMETRIC_RECORD(op, size, ptr)
+#endif /* ENABLE_ERROR_CHECKING */
+
+
+/* Release the objects passed to shmemx_free_deferred.  Must be called by all
+ * PEs after a barrier, so that no PE can be accessing the objects any longer
+ * and every PE releases them at the same point of the allocation sequence. */
+void
+shmem_internal_symmetric_drain(void)
+{
+    size_t i;
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    for (i = 0; i < symmetric_deferred_count; i++) {
+        if (!shmem_internal_slab_free(symmetric_deferred[i]) &&
+            !shmem_internal_space_free(symmetric_deferred[i]))
+            dlfree(symmetric_deferred[i]);
+    }
+    symmetric_deferred_count = 0;
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+}
+
+
+/* Synchronization point of the collective allocation routines */
+static void
+symmetric_sync(void)
+{
+#ifdef ENABLE_ERROR_CHECKING
+    if (shmem_internal_params.SYMMETRIC_HEAP_CHECK)
+        symmetric_check();
+#endif
+
+    shmem_internal_barrier_all();
+
+    shmem_internal_symmetric_drain();
+}
 
 
 /*
@@ -90,7 +262,7 @@ void* dlmemalign(size_t, size_t);
  */
 
 #ifdef __linux__
-static int find_hugepage_dir(size_t page_size, char **directory)
+int shmem_internal_find_hugepage_dir(size_t page_size, char **directory)
 {
     int ret = -1;
     struct statfs pg_size;
@@ -128,6 +300,45 @@ static int find_hugepage_dir(size_t page_size, char **directory)
 }
 #endif /* __linux__ */
 
+#ifndef FLOOR
+#define FLOOR(a,b)      ((uint64_t)(a) - ( ((uint64_t)(a)) % (uint64_t)(b)))
+#endif
+#ifndef CEILING
+#define CEILING(a,b)    ((uint64_t)(a) <= 0LL ? 0 : (FLOOR((a)-1,b) + (b)))
+#endif
+
+
+/* Commit more of the address space reserved for the heap, so that it spans
+ * at least len bytes.  dlmalloc only extends the heap from within the
+ * symmetric allocation routines, which all PEs call in the same order, so
+ * every PE grows its heap at the same point and to the same size. */
+static int
+shmem_internal_heap_grow(size_t len)
+{
+    size_t old_len = shmem_internal_heap_length;
+    size_t new_len;
+    char errmsg[256];
+
+    if (len > (size_t) shmem_internal_heap_reserve) return 1;
+
+    /* Grow geometrically to keep the number of commits small */
+    new_len = CEILING(MAX(len, 2 * old_len), shmem_internal_heap_page_size);
+    new_len = MIN(new_len, (size_t) shmem_internal_heap_reserve);
+
+    if (0 != mprotect((char*) shmem_internal_heap_base + old_len,
+                      new_len - old_len, PROT_READ | PROT_WRITE)) {
+        RAISE_WARN_MSG("Unable to grow sym. heap to %zuB: %s\n", new_len,
+                       shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+
+    DEBUG_MSG("Symmetric heap grown from %zuB to %zuB\n", old_len, new_len);
+    shmem_internal_heap_length = new_len;
+
+    return 0;
+}
+
+
 /* shmalloc and friends are defined to not be thread safe, so this is
    fine.  If they change that definition, this is no longer fine and
    needs to be made thread safe. */
@@ -141,9 +352,12 @@ shmem_internal_get_next(intptr_t incr)
         RAISE_WARN_STR("symmetric heap pointer pushed below start");
         shmem_internal_heap_curr = (char*) shmem_internal_heap_base;
     } else if (shmem_internal_heap_curr - (char*) shmem_internal_heap_base >
-               shmem_internal_heap_length) {
+               shmem_internal_heap_length &&
+               0 != shmem_internal_heap_grow(shmem_internal_heap_curr -
+                                             (char*) shmem_internal_heap_base)) {
         RAISE_WARN_MSG("Out of symmetric memory, heap size %ld, overrun %"PRIdPTR"\n"
-                       RAISE_PE_PREFIX "Try increasing SHMEM_SYMMETRIC_SIZE\n",
+                       RAISE_PE_PREFIX "Try increasing SHMEM_SYMMETRIC_SIZE or "
+                       "SHMEM_SYMMETRIC_HEAP_RESERVE\n",
                        shmem_internal_heap_length, incr, shmem_internal_my_pe);
         shmem_internal_heap_curr = orig;
         orig = (void*) -1;
@@ -152,17 +366,10 @@ shmem_internal_get_next(intptr_t incr)
     return orig;
 }
 
-#ifndef FLOOR
-#define FLOOR(a,b)      ((uint64_t)(a) - ( ((uint64_t)(a)) % (uint64_t)(b)))
-#endif
-#ifndef CEILING
-#define CEILING(a,b)    ((uint64_t)(a) <= 0LL ? 0 : (FLOOR((a)-1,b) + (b)))
-#endif
-
 
 /* alloc VM space starting @ '_end' + 1GB */
 #define ONEGIG (1024UL*1024UL*1024UL)
-static void *mmap_alloc(size_t bytes)
+static void *mmap_alloc(size_t bytes, int noreserve)
 {
     char *file_name = NULL;
     int fd = 0;
@@ -171,6 +378,8 @@ static void *mmap_alloc(size_t bytes)
         (void*) (((unsigned long) shmem_internal_data_base +
                   shmem_internal_data_length + 2 * ONEGIG) & ~(ONEGIG - 1));
     void *ret;
+    int flags = MAP_ANON | MAP_PRIVATE;
+    int hugetlbfs = 0;
 
 #ifdef __linux__
     /* huge page support only on Linux for now, default is to use 2MB large pages */
@@ -178,8 +387,8 @@ static void *mmap_alloc(size_t bytes)
         const char basename[] = "hugepagefile.SOS";
 
         /* check what /proc/mounts has for explicit huge page support */
-        if (find_hugepage_dir(shmem_internal_params.SYMMETRIC_HEAP_PAGE_SIZE,
-                             &directory) == 0)
+        if (shmem_internal_find_hugepage_dir(shmem_internal_params.SYMMETRIC_HEAP_PAGE_SIZE,
+                                             &directory) == 0)
         {
             int size = snprintf(NULL, 0, "%s/%s.%d", directory, basename, getpid());
 
@@ -196,6 +405,7 @@ static void *mmap_alloc(size_t bytes)
                     } else {
                         /* have to round up by the pagesize being used */
                         bytes = CEILING(bytes, shmem_internal_params.SYMMETRIC_HEAP_PAGE_SIZE);
+                        hugetlbfs = 1;
                     }
                 }
             }
@@ -203,22 +413,55 @@ static void *mmap_alloc(size_t bytes)
     }
 #endif /* __linux__ */
 
-    ret = mmap(requested_base,
-               bytes,
-               PROT_READ | PROT_WRITE,
-               MAP_ANON | MAP_PRIVATE,
-               fd,
-               0);
+#ifdef USE_SHM
+    /* On-node peers map the heap, so it must be backed by a named object.
+     * The SHM transport removes the name once all peers are attached. */
+    if (fd && 0 != shmem_transport_shm_heap_register(file_name, bytes)) {
+        unlink(file_name);
+        close(fd);
+        fd = 0;
+        hugetlbfs = 0;
+    }
+    if (0 == fd)
+        fd = shmem_transport_shm_heap_create(bytes);
+    flags = MAP_SHARED;
+#endif
+
+    /* A growable heap only reserves address space up front */
+    if (noreserve)
+        flags |= MAP_NORESERVE;
+
+    ret = (fd < 0) ? MAP_FAILED : mmap(requested_base,
+                                       bytes,
+                                       PROT_READ | PROT_WRITE,
+                                       flags,
+                                       fd,
+                                       0);
     if (ret == MAP_FAILED) {
         RAISE_WARN_MSG("Unable to allocate sym. heap, size %zuB: %s\n"
                        RAISE_PE_PREFIX
                        "Try reducing SHMEM_SYMMETRIC_SIZE or number of PEs per node\n",
                        bytes, strerror(errno), shmem_internal_my_pe);
         ret = NULL;
+#ifdef USE_SHM
+        shmem_transport_shm_fini();
+#endif
+    }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    /* Without a hugetlbfs mount, ask for transparent huge pages instead */
+    else if (shmem_internal_params.SYMMETRIC_HEAP_USE_HUGE_PAGES && !hugetlbfs) {
+        if (0 != madvise(ret, bytes, MADV_HUGEPAGE))
+            DEBUG_MSG("madvise(MADV_HUGEPAGE) on sym. heap failed: %s\n",
+                      strerror(errno));
+        else
+            DEBUG_STR("No hugetlbfs mount found, using transparent huge pages");
     }
-    if (fd) {
+#endif
+    if (fd > 0) {
+#ifndef USE_SHM
         if (file_name)
             unlink(file_name);
+#endif
         close(fd);
     }
     if (directory) {
@@ -234,34 +477,251 @@ static void *mmap_alloc(size_t bytes)
 int
 shmem_internal_symmetric_init(void)
 {
+    size_t reserve = shmem_internal_params.SYMMETRIC_HEAP_RESERVE;
+
     /* add library overhead such that the max can be shmalloc()'ed */
     shmem_internal_heap_length = shmem_internal_params.SYMMETRIC_SIZE +
                                  SHMEM_INTERNAL_HEAP_OVERHEAD;
 
-    if (!shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC) {
+#ifdef __linux__
+    if (shmem_internal_params.SYMMETRIC_HEAP_USE_HUGE_PAGES)
+        shmem_internal_heap_page_size = shmem_internal_params.SYMMETRIC_HEAP_PAGE_SIZE;
+    else
+#endif
+        shmem_internal_heap_page_size = sysconf(_SC_PAGESIZE);
+
+    if (reserve > 0) {
+        if (shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC) {
+            RAISE_WARN_STR("SHMEM_SYMMETRIC_HEAP_RESERVE is not supported with "
+                           "SHMEM_SYMMETRIC_HEAP_USE_MALLOC, heap will not grow");
+            reserve = 0;
+        } else if (!SHMEM_TRANSPORT_HEAP_GROWABLE) {
+            RAISE_WARN_STR("SHMEM_SYMMETRIC_HEAP_RESERVE is not supported by the "
+                           "transport, heap will not grow");
+            reserve = 0;
+        } else if (reserve <= (size_t) shmem_internal_heap_length) {
+            RAISE_WARN_MSG("Ignoring SHMEM_SYMMETRIC_HEAP_RESERVE, smaller than "
+                           "the initial heap (%ldB)\n", shmem_internal_heap_length);
+            reserve = 0;
+        }
+    }
+
+    if (reserve > 0) {
+        /* Reserve the whole range, then make everything past the initial
+         * heap inaccessible until the heap grows into it */
+        shmem_internal_heap_length = CEILING(shmem_internal_heap_length,
+                                             shmem_internal_heap_page_size);
+        reserve = CEILING(reserve, shmem_internal_heap_page_size);
+
+        shmem_internal_heap_base =
+            shmem_internal_heap_curr =
+            mmap_alloc(reserve, 1);
+
+        if (NULL != shmem_internal_heap_base &&
+            0 != mprotect((char*) shmem_internal_heap_base + shmem_internal_heap_length,
+                          reserve - shmem_internal_heap_length, PROT_NONE)) {
+            RAISE_WARN_MSG("Unable to reserve sym. heap address space: %s\n",
+                           strerror(errno));
+            munmap(shmem_internal_heap_base, reserve);
+            shmem_internal_heap_base = shmem_internal_heap_curr = NULL;
+        }
+        shmem_internal_heap_reserve = reserve;
+    } else if (!shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC) {
         shmem_internal_heap_base =
             shmem_internal_heap_curr =
-            mmap_alloc(shmem_internal_heap_length);
+            mmap_alloc(shmem_internal_heap_length, 0);
+        shmem_internal_heap_reserve = shmem_internal_heap_length;
     } else {
         shmem_internal_heap_base =
             shmem_internal_heap_curr =
             malloc(shmem_internal_heap_length);
+        shmem_internal_heap_reserve = shmem_internal_heap_length;
+    }
+
+    if (NULL == shmem_internal_heap_base) return -1;
+
+    return shmem_internal_slab_init();
+}
+
+
+/* Bind [base, base + len) to the memory local to the PE */
+int
+shmem_internal_heap_bind(void *base, size_t len)
+{
+    char errmsg[256];
+
+#if defined(USE_HWLOC) && defined(HAVE_SCHED_GETAFFINITY)
+    /* hwloc maps the PE's CPU binding to the NUMA node(s) near it */
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    int ret;
+
+    if (NULL == cpuset) return 1;
+
+    ret = hwloc_get_proc_cpubind(shmem_internal_topology, getpid(), cpuset,
+                                 HWLOC_CPUBIND_PROCESS);
+    if (0 == ret)
+        ret = hwloc_set_area_membind(shmem_internal_topology, base, len, cpuset,
+                                     HWLOC_MEMBIND_BIND, 0);
+    if (0 != ret)
+        RAISE_WARN_MSG("Unable to bind sym. heap to local memory: %s\n",
+                       shmem_util_strerror(errno, errmsg, 256));
+    else
+        DEBUG_STR("Symmetric heap bound to local memory");
+
+    hwloc_bitmap_free(cpuset);
+    return ret;
+#elif defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    /* Bind to the node of the CPU the PE is running on */
+    const int mpol_bind = 2;
+    unsigned int cpu, node;
+    unsigned long mask;
+
+    if (0 != syscall(SYS_getcpu, &cpu, &node, NULL)) {
+        RAISE_WARN_MSG("Unable to query NUMA node: %s\n",
+                       shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+    if (node >= sizeof(mask) * 8) {
+        RAISE_WARN_MSG("NUMA node %u out of range, sym. heap not bound\n", node);
+        return 1;
+    }
+
+    mask = 1UL << node;
+    if (0 != syscall(SYS_mbind, base, len, mpol_bind, &mask, sizeof(mask) * 8 + 1, 0)) {
+        RAISE_WARN_MSG("Unable to bind sym. heap to NUMA node %u: %s\n", node,
+                       shmem_util_strerror(errno, errmsg, 256));
+        return 1;
+    }
+
+    DEBUG_MSG("Symmetric heap bound to NUMA node %u\n", node);
+    return 0;
+#else
+    RAISE_WARN_STR("SHMEM_SYMMETRIC_HEAP_NUMA_BIND is not supported on this platform");
+    return 1;
+#endif
+}
+
+
+struct symmetric_prefault_t {
+    char *start;
+    char *end;
+};
+
+static void *
+symmetric_heap_prefault(void *arg)
+{
+    struct symmetric_prefault_t *range = (struct symmetric_prefault_t *) arg;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    volatile char *p;
+
+    /* The heap is fresh, so writing zeros does not change its contents */
+    for (p = range->start; p < range->end; p += page_size)
+        *p = 0;
+
+    return NULL;
+}
+
+
+/* Bind the symmetric heap to the memory local to the PE and fault it in.
+ * Called once the PE's CPU affinity is settled, so that both the binding
+ * and first-touch placement by the prefault threads (which inherit the
+ * affinity) land on the PE's node. */
+void
+shmem_internal_symmetric_place(void)
+{
+    long nthreads = shmem_internal_params.SYMMETRIC_HEAP_PREFAULT;
+    struct symmetric_prefault_t *ranges;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t npages, chunk;
+    long i;
+
+    if (NULL == shmem_internal_heap_base) return;
+
+    if (shmem_internal_params.SYMMETRIC_HEAP_NUMA_BIND) {
+        if (shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC)
+            RAISE_WARN_STR("SHMEM_SYMMETRIC_HEAP_NUMA_BIND is not supported with "
+                           "SHMEM_SYMMETRIC_HEAP_USE_MALLOC");
+        else
+            /* Cover the whole reservation so that growth inherits the policy */
+            shmem_internal_heap_bind(shmem_internal_heap_base,
+                                     (size_t) shmem_internal_heap_reserve);
+    }
+
+    if (nthreads <= 0) return;
+
+    npages = ((size_t) shmem_internal_heap_length + page_size - 1) / page_size;
+    if ((size_t) nthreads > npages) nthreads = npages;
+
+    ranges = malloc(nthreads * sizeof(struct symmetric_prefault_t));
+    if (NULL == ranges) {
+        RAISE_WARN_STR("Out of memory, sym. heap not prefaulted");
+        return;
+    }
+
+    chunk = (npages + nthreads - 1) / nthreads * page_size;
+    for (i = 0; i < nthreads; i++) {
+        ranges[i].start = (char*) shmem_internal_heap_base + i * chunk;
+        ranges[i].end   = MIN(ranges[i].start + chunk,
+                              (char*) shmem_internal_heap_base + shmem_internal_heap_length);
+    }
+
+#ifdef ENABLE_THREADS
+    {
+        pthread_t *threads = malloc(nthreads * sizeof(pthread_t));
+        long nstarted = 0;
+
+        /* The calling thread takes the first range */
+        for (i = 1; NULL != threads && i < nthreads; i++) {
+            int ret = pthread_create(&threads[i], NULL, symmetric_heap_prefault,
+                                     &ranges[i]);
+            if (0 != ret) {
+                RAISE_WARN_MSG("Unable to create prefault thread (%d), using %ld\n",
+                               ret, i);
+                break;
+            }
+            nstarted = i;
+        }
+
+        symmetric_heap_prefault(&ranges[0]);
+        for (i = nstarted + 1; i < nthreads; i++)
+            symmetric_heap_prefault(&ranges[i]);
+        for (i = 1; i <= nstarted; i++)
+            pthread_join(threads[i], NULL);
+
+        free(threads);
     }
+#else
+    for (i = 0; i < nthreads; i++)
+        symmetric_heap_prefault(&ranges[i]);
+#endif
 
-    return (NULL == shmem_internal_heap_base) ? -1 : 0;
+    DEBUG_MSG("Symmetric heap prefaulted (%ldB, %ld threads)\n",
+              shmem_internal_heap_length, nthreads);
+
+    free(ranges);
 }
 
 
 int
 shmem_internal_symmetric_fini(void)
 {
+    shmem_internal_slab_fini();
+
+    free(symmetric_deferred);
+    symmetric_deferred = NULL;
+    symmetric_deferred_count = symmetric_deferred_max = 0;
+#ifdef ENABLE_ERROR_CHECKING
+    symmetric_seq_root = NULL;
+#endif
+
     if (NULL != shmem_internal_heap_base) {
         if (!shmem_internal_params.SYMMETRIC_HEAP_USE_MALLOC) {
-            munmap( (void*)shmem_internal_heap_base, (size_t)shmem_internal_heap_length );
+            munmap( (void*)shmem_internal_heap_base, (size_t)shmem_internal_heap_reserve );
         } else {
             free(shmem_internal_heap_base);
         }
         shmem_internal_heap_length = 0;
+        shmem_internal_heap_reserve = 0;
         shmem_internal_heap_base = shmem_internal_heap_curr = NULL;
     }
 
@@ -292,10 +752,11 @@ shmem_malloc(size_t size)
     if (size == 0) return ret;
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
-    ret = dlmalloc(size);
+    ret = symmetric_malloc(size);
+    SYMMETRIC_RECORD(SYMMETRIC_OP_MALLOC, size, ret);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
 
-    shmem_internal_barrier_all();
+    symmetric_sync();
 
     return ret;
 }
@@ -310,10 +771,16 @@ shmem_calloc(size_t count, size_t size)
     if (size == 0 || count == 0) return ret;
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
-    ret = dlcalloc(count, size);
+    if (count <= SIZE_MAX / size &&
+        NULL != (ret = shmem_internal_slab_alloc(count * size))) {
+        memset(ret, 0, count * size);
+    } else {
+        ret = dlcalloc(count, size);
+    }
+    SYMMETRIC_RECORD(SYMMETRIC_OP_CALLOC, count * size, ret);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
 
-    shmem_internal_barrier_all();
+    symmetric_sync();
 
     return ret;
 }
@@ -326,16 +793,54 @@ shmem_free(void *ptr)
       SHMEM_ERR_CHECK_SYMMETRIC_HEAP(ptr);
     }
 
-    shmem_internal_barrier_all();
+#ifdef ENABLE_ERROR_CHECKING
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    SYMMETRIC_RECORD(SYMMETRIC_OP_FREE, 0, ptr);
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+#endif
+
+    symmetric_sync();
 
     shmem_internal_free(ptr);
 }
 
 
+/* Release ptr without synchronizing.  The object is returned to the heap
+ * after the barrier of the next synchronizing allocation routine, so other
+ * PEs may keep accessing it until then.  As with shmem_free, all PEs must
+ * release the same objects in the same order. */
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_free_deferred(void *ptr)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    if (ptr == NULL) return;
+
+    SHMEM_ERR_CHECK_SYMMETRIC_HEAP(ptr);
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    if (symmetric_deferred_count == symmetric_deferred_max) {
+        size_t max = (symmetric_deferred_max == 0) ? 64 : 2 * symmetric_deferred_max;
+        void **deferred = realloc(symmetric_deferred, max * sizeof(void *));
+
+        if (NULL == deferred) {
+            RAISE_ERROR_MSG("Out of memory deferring symmetric free (%zu objects)\n",
+                            symmetric_deferred_count);
+        }
+        symmetric_deferred = deferred;
+        symmetric_deferred_max = max;
+    }
+    symmetric_deferred[symmetric_deferred_count++] = ptr;
+    SYMMETRIC_RECORD(SYMMETRIC_OP_FREE_DEFERRED, 0, ptr);
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+}
+
+
 void SHMEM_FUNCTION_ATTRIBUTES *
 shmem_realloc(void *ptr, size_t size)
 {
     void *ret;
+    size_t old_size;
 
     SHMEM_ERR_CHECK_INITIALIZED();
 
@@ -344,15 +849,33 @@ shmem_realloc(void *ptr, size_t size)
       SHMEM_ERR_CHECK_SYMMETRIC_HEAP(ptr);
     }
 
-    shmem_internal_barrier_all();
+    symmetric_sync();
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
     if (size == 0 && ptr != NULL) {
-        dlfree(ptr);
+        if (!shmem_internal_slab_free(ptr) && !shmem_internal_space_free(ptr))
+            dlfree(ptr);
         ret = NULL;
+    } else if (ptr != NULL && shmem_internal_space_index(ptr) >= 0) {
+        ret = shmem_internal_space_realloc(ptr, size);
+    } else if (ptr != NULL && 0 != (old_size = shmem_internal_slab_size(ptr))) {
+        /* Slab slots cannot grow in place; stay put if the slot is still
+         * large enough, otherwise move the object */
+        if (size <= old_size) {
+            ret = ptr;
+        } else {
+            ret = symmetric_malloc(size);
+            if (NULL != ret) {
+                memcpy(ret, ptr, old_size);
+                shmem_internal_slab_free(ptr);
+            }
+        }
+    } else if (ptr == NULL) {
+        ret = symmetric_malloc(size);
     } else {
         ret = dlrealloc(ptr, size);
     }
+    SYMMETRIC_RECORD(SYMMETRIC_OP_REALLOC, size, ret);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
 
     shmem_internal_barrier_all();
@@ -374,9 +897,10 @@ shmem_align(size_t alignment, size_t size)
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
     ret = dlmemalign(alignment, size);
+    SYMMETRIC_RECORD(SYMMETRIC_OP_ALIGN, size, ret);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
 
-    shmem_internal_barrier_all();
+    symmetric_sync();
 
     return ret;
 }
@@ -427,15 +951,201 @@ shmem_malloc_with_hints(size_t size, long hints)
     }
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
-    ret = dlmalloc(size);
+    ret = symmetric_malloc(size);
+    SYMMETRIC_RECORD(SYMMETRIC_OP_MALLOC, size, ret);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
 
+    /* Without the barrier, symmetry relies on all PEs performing the same
+     * sequence of allocations.  Deferred frees are only released at
+     * synchronizing calls. */
     if (!(hints & SHMEMX_MALLOC_NO_BARRIER))
-        shmem_internal_barrier_all();
+        symmetric_sync();
 
     return ret;
 }
 
+/* Allocate count symmetric objects with a single barrier.  On failure, none
+ * of the objects are allocated and all entries of ptrs are set to NULL. */
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_malloc_n(void **ptrs, const size_t *sizes, size_t count)
+{
+    size_t i, j;
+    int ret = 0;
+
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_NULL(ptrs, count);
+    SHMEM_ERR_CHECK_NULL(sizes, count);
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    for (i = 0; i < count; i++) {
+        if (sizes[i] == 0) {
+            ptrs[i] = NULL;
+            continue;
+        }
+
+        ptrs[i] = symmetric_malloc(sizes[i]);
+        if (NULL == ptrs[i]) {
+            /* Allocation is deterministic, so every PE fails here */
+            for (j = 0; j < i; j++) {
+                if (NULL != ptrs[j] && !shmem_internal_slab_free(ptrs[j]))
+                    dlfree(ptrs[j]);
+            }
+            for (j = 0; j < count; j++)
+                ptrs[j] = NULL;
+            ret = -1;
+            break;
+        }
+        SYMMETRIC_RECORD(SYMMETRIC_OP_MALLOC, sizes[i], ptrs[i]);
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    symmetric_sync();
+
+    return ret;
+}
+
+/* State of a walk over the heap chunks, see heap_stats */
+struct heap_walk_t {
+    shmemx_heap_stats_t *stats;
+    size_t nslabs;
+    size_t slab_bytes;
+    size_t last_free;       /* Size of the last chunk visited, if it is free */
+};
+
+static void
+heap_walk_chunk(void *start, void *end, size_t used, void *arg)
+{
+    struct heap_walk_t *walk = (struct heap_walk_t *) arg;
+    size_t len = (uint8_t *) end - (uint8_t *) start;
+
+    if (used == 0) {
+        walk->stats->free_bytes += len;
+        walk->stats->largest_free = MAX(walk->stats->largest_free, len);
+        walk->last_free = len;
+        return;
+    }
+
+    walk->last_free = 0;
+    /* Chunk header, the memory starts two words into the chunk */
+    walk->stats->overhead += len + 2 * sizeof(size_t) - used;
+
+    /* Slabs are accounted for by their slots */
+    if (0 != shmem_internal_slab_size(start)) {
+        walk->nslabs++;
+        walk->slab_bytes += used;
+    } else {
+        walk->stats->in_use += used;
+        walk->stats->num_allocs++;
+    }
+}
+
+/* Walks every chunk of the heap and of the memory spaces, so this is not
+ * meant for fast paths.  Must be called with shmem_internal_mutex_alloc
+ * held. */
+static void
+heap_stats(shmemx_heap_stats_t *stats)
+{
+    struct heap_walk_t walk = { stats, 0, 0, 0 };
+    size_t slab_objs, slab_used, room;
+    int i;
+
+    memset(stats, 0, sizeof(shmemx_heap_stats_t));
+
+    dlmalloc_inspect_all(heap_walk_chunk, &walk);
+
+    shmem_internal_slab_stats(&slab_objs, &slab_used);
+    stats->in_use += slab_used;
+    stats->num_allocs += slab_objs;
+    stats->overhead += walk.slab_bytes - MIN(slab_used, walk.slab_bytes);
+
+    stats->heap_size = shmem_internal_heap_reserve;
+    stats->footprint = dlmalloc_footprint();
+    stats->high_water = dlmalloc_max_footprint();
+
+    /* The top chunk can be extended by the rest of the reservation */
+    room = stats->heap_size - MIN(stats->footprint, stats->heap_size);
+    stats->largest_free = MAX(stats->largest_free, walk.last_free + room);
+
+    /* Memory spaces are fixed size and hold no slabs */
+    for (i = 0; i < SHMEM_INTERNAL_MAX_SPACES; i++) {
+        shmem_internal_space_t *space = &shmem_internal_spaces[i];
+
+        if (NULL == space->base) continue;
+
+        mspace_inspect_all(space->msp, heap_walk_chunk, &walk);
+        stats->heap_size += space->length;
+        stats->footprint += mspace_footprint(space->msp);
+        stats->high_water += mspace_max_footprint(space->msp);
+    }
+}
+
+
+/* Print the minimum and maximum of each heap statistic across all PEs.  Must
+ * be called by all PEs. */
+void
+shmem_internal_heap_report(void)
+{
+    static const char *names[] = { "Heap size", "Footprint", "High water mark",
+                                   "In use", "Free", "Largest free block",
+                                   "Overhead", "Live objects" };
+    const size_t n = sizeof(shmemx_heap_stats_t) / sizeof(size_t);
+    shmemx_heap_stats_t stats;
+    size_t *buf, i;
+    long *psync;
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    heap_stats(&stats);
+    buf = dlmalloc(3 * sizeof(shmemx_heap_stats_t));
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    /* Allocation is deterministic, so all PEs skip the report together */
+    if (NULL == buf) {
+        RAISE_WARN_STR("Out of symmetric memory for the heap usage report");
+        return;
+    }
+
+    memcpy(buf, &stats, sizeof(shmemx_heap_stats_t));
+    shmem_internal_barrier_all();
+
+    psync = shmem_internal_team_choose_psync(&shmem_internal_team_world, REDUCE);
+    shmem_internal_op_to_all(buf + n, buf, n, sizeof(size_t), 0, 1,
+                             shmem_internal_num_pes, NULL, psync,
+                             SHM_INTERNAL_MIN, SHM_INTERNAL_SIZE_T);
+    shmem_internal_team_release_psyncs(&shmem_internal_team_world, REDUCE);
+
+    psync = shmem_internal_team_choose_psync(&shmem_internal_team_world, REDUCE);
+    shmem_internal_op_to_all(buf + 2 * n, buf, n, sizeof(size_t), 0, 1,
+                             shmem_internal_num_pes, NULL, psync,
+                             SHM_INTERNAL_MAX, SHM_INTERNAL_SIZE_T);
+    shmem_internal_team_release_psyncs(&shmem_internal_team_world, REDUCE);
+
+    if (0 == shmem_internal_my_pe) {
+        printf("Symmetric heap usage (min / max over %d PEs):\n",
+               shmem_internal_num_pes);
+        for (i = 0; i < n; i++)
+            printf("  %-21s %zu / %zu\n", names[i], buf[n + i], buf[2 * n + i]);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    shmem_internal_barrier_all();
+    shmem_internal_free(buf);
+}
+
+
+/* Usage of the local symmetric heap and memory spaces.  Not collective. */
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_heap_stats(shmemx_heap_stats_t *stats)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_NULL(stats, 1);
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    heap_stats(stats);
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+}
+
+
 void SHMEM_FUNCTION_ATTRIBUTES
 shmemx_heap_create(void *base, size_t size, int device_type, int device_index) {
 
@@ -462,3 +1172,19 @@ shmemx_heap_create(void *base, size_t size, int device_type, int device_index) {
 
     shmem_external_heap_pre_initialized = 1;
 }
+
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_register_buffer(const void *addr, size_t len)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    return shmem_transport_register_buffer(addr, len);
+}
+
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_unregister_buffer(const void *addr, size_t len)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    return shmem_transport_unregister_buffer(addr, len);
+}
@@ -78,7 +78,8 @@ FC_SHPDEALLOC(void **addr, fortran_integer_t *errcode, fortran_integer_t *want_a
     shmem_internal_barrier_all();
 
     SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
-    dlfree(*addr);
+    if (!shmem_internal_slab_free(*addr))
+        dlfree(*addr);
     SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
     *errcode = 0;
 }
@@ -0,0 +1,259 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Segregated size-class allocator for small symmetric objects.
+ *
+ * Small allocations are served from slabs of SLAB_SIZE bytes carved from the
+ * symmetric heap with dlmemalign().  Each slab holds slots of a single
+ * power-of-two size class, so slots are naturally aligned: slots of 64 bytes
+ * and up start on a cache line and smaller slots never straddle one.  The
+ * bookkeeping lives in private memory, so slots carry no headers.
+ *
+ * Slabs are created, filled lowest-slot-first, and released in a fixed order
+ * that depends only on the sequence of calls.  Since symmetric allocations
+ * are collective, every PE makes the same calls and gets the same addresses.
+ *
+ * All functions must be called with shmem_internal_mutex_alloc held.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "uthash.h"
+
+#define SLAB_SIZE       (64 * 1024)
+#define SLAB_MIN_SLOT   8
+#define SLAB_MAX_SLOT   4096
+#define SLAB_NUM_CLASSES 10         /* 8 B ... 4 KiB */
+
+void* dlmemalign(size_t, size_t);
+
+struct shmem_internal_slab_t {
+    char *base;                             /* hash key */
+    size_t slot_size;
+    size_t nslots;
+    size_t nfree;
+    struct shmem_internal_slab_t *next;     /* slabs of the same class */
+    UT_hash_handle hh;
+    uint64_t in_use[];                      /* one bit per slot */
+};
+typedef struct shmem_internal_slab_t shmem_internal_slab_t;
+
+static shmem_internal_slab_t *slab_classes[SLAB_NUM_CLASSES];
+static shmem_internal_slab_t *slab_table = NULL;
+static size_t slab_max = 0;
+
+
+static inline int
+slab_class(size_t size)
+{
+    int cls = 0;
+
+    while (((size_t) SLAB_MIN_SLOT << cls) < size)
+        cls++;
+
+    return cls;
+}
+
+
+static shmem_internal_slab_t *
+slab_create(int cls)
+{
+    shmem_internal_slab_t *slab;
+    size_t slot_size = (size_t) SLAB_MIN_SLOT << cls;
+    size_t nslots = SLAB_SIZE / slot_size;
+    size_t nwords = (nslots + 63) / 64;
+    char *base;
+
+    base = dlmemalign(SLAB_SIZE, SLAB_SIZE);
+    if (NULL == base) return NULL;
+
+    slab = calloc(1, sizeof(shmem_internal_slab_t) + nwords * sizeof(uint64_t));
+    if (NULL == slab) {
+        dlfree(base);
+        return NULL;
+    }
+
+    slab->base = base;
+    slab->slot_size = slot_size;
+    slab->nslots = nslots;
+    slab->nfree = nslots;
+
+    slab->next = slab_classes[cls];
+    slab_classes[cls] = slab;
+    HASH_ADD_PTR(slab_table, base, slab);
+
+    return slab;
+}
+
+
+static void
+slab_destroy(shmem_internal_slab_t *slab, int cls)
+{
+    shmem_internal_slab_t **prev = &slab_classes[cls];
+
+    while (*prev != slab)
+        prev = &(*prev)->next;
+    *prev = slab->next;
+
+    HASH_DEL(slab_table, slab);
+    dlfree(slab->base);
+    free(slab);
+}
+
+
+static inline shmem_internal_slab_t *
+slab_lookup(const void *ptr)
+{
+    shmem_internal_slab_t *slab;
+    char *base = (char *) ((uintptr_t) ptr & ~((uintptr_t) SLAB_SIZE - 1));
+
+    if (NULL == slab_table) return NULL;
+
+    HASH_FIND_PTR(slab_table, &base, slab);
+    return slab;
+}
+
+
+int
+shmem_internal_slab_init(void)
+{
+    size_t max = shmem_internal_params.SYMMETRIC_SLAB_MAX;
+
+    if (max > SLAB_MAX_SLOT) {
+        RAISE_WARN_MSG("Ignoring SHMEM_SYMMETRIC_SLAB_MAX above %d\n", SLAB_MAX_SLOT);
+        max = SLAB_MAX_SLOT;
+    }
+
+    /* Round up to a size class */
+    slab_max = (max == 0) ? 0 : (size_t) SLAB_MIN_SLOT << slab_class(max);
+
+    return 0;
+}
+
+
+void
+shmem_internal_slab_fini(void)
+{
+    shmem_internal_slab_t *slab, *tmp;
+
+    /* Slab memory goes away with the symmetric heap */
+    HASH_ITER(hh, slab_table, slab, tmp) {
+        HASH_DEL(slab_table, slab);
+        free(slab);
+    }
+
+    memset(slab_classes, 0, sizeof(slab_classes));
+    slab_max = 0;
+}
+
+
+/* Returns a slot of at least size bytes, or NULL if size is not served by
+ * the slab layer or no slab could be created.  The caller falls back to
+ * dlmalloc() in that case. */
+void *
+shmem_internal_slab_alloc(size_t size)
+{
+    shmem_internal_slab_t *slab;
+    size_t i, word;
+    int cls, bit;
+
+    if (size == 0 || size > slab_max) return NULL;
+
+    cls = slab_class(size);
+
+    for (slab = slab_classes[cls]; NULL != slab; slab = slab->next)
+        if (slab->nfree > 0) break;
+
+    if (NULL == slab) {
+        slab = slab_create(cls);
+        if (NULL == slab) return NULL;
+    }
+
+    for (word = 0; ~slab->in_use[word] == 0; word++)
+        ;
+
+    bit = __builtin_ctzll(~slab->in_use[word]);
+    i = word * 64 + bit;
+    shmem_internal_assert(i < slab->nslots);
+
+    slab->in_use[word] |= (UINT64_C(1) << bit);
+    slab->nfree--;
+
+    return slab->base + i * slab->slot_size;
+}
+
+
+/* Size of the slot holding ptr, or 0 if ptr was not allocated from a slab */
+size_t
+shmem_internal_slab_size(const void *ptr)
+{
+    shmem_internal_slab_t *slab = slab_lookup(ptr);
+
+    return (NULL == slab) ? 0 : slab->slot_size;
+}
+
+
+/* Returns 1 if ptr was a slab slot and has been released, 0 otherwise */
+int
+shmem_internal_slab_free(void *ptr)
+{
+    shmem_internal_slab_t *slab = slab_lookup(ptr);
+    size_t offset, i;
+
+    if (NULL == slab) return 0;
+
+    offset = (char *) ptr - slab->base;
+    i = offset / slab->slot_size;
+
+    if (offset % slab->slot_size != 0 ||
+        !(slab->in_use[i / 64] & (UINT64_C(1) << (i % 64)))) {
+        RAISE_ERROR_MSG("Invalid free of symmetric object %p\n", ptr);
+    }
+
+    slab->in_use[i / 64] &= ~(UINT64_C(1) << (i % 64));
+    slab->nfree++;
+
+    /* Release empty slabs back to the heap, keeping the last one of each
+     * class to avoid thrashing on alloc/free pairs */
+    if (slab->nfree == slab->nslots &&
+        !(slab_classes[slab_class(slab->slot_size)] == slab && NULL == slab->next)) {
+        slab_destroy(slab, slab_class(slab->slot_size));
+    }
+
+    return 1;
+}
+
+
+/* Number of slots in use and their total size, across all slabs */
+void
+shmem_internal_slab_stats(size_t *nobjs, size_t *bytes)
+{
+    shmem_internal_slab_t *slab, *tmp;
+
+    *nobjs = *bytes = 0;
+
+    HASH_ITER(hh, slab_table, slab, tmp) {
+        *nobjs += slab->nslots - slab->nfree;
+        *bytes += (slab->nslots - slab->nfree) * slab->slot_size;
+    }
+}
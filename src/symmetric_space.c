@@ -0,0 +1,389 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Symmetric memory spaces.
+ *
+ * A space is a symmetric region separate from the default heap, with its own
+ * page size and NUMA policy.  It is managed by its own dlmalloc mspace and
+ * registered with the transport as a separate memory region, whose keys and
+ * base addresses are exchanged when the space is created.  Creation,
+ * allocation and destruction are collective, so every PE makes the same
+ * sequence of mspace calls and objects have the same offset within the space
+ * on every PE.
+ *
+ * Spaces are only reachable through the network transport; the on-node
+ * transports map just the data segment and the default heap.
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_comm.h"
+#include "shmem_collectives.h"
+#include "shmem_team.h"
+#include "shmemx.h"
+
+#ifdef ENABLE_PROFILING
+#include "pshmem.h"
+
+#pragma weak shmemx_space_create = pshmemx_space_create
+#define shmemx_space_create pshmemx_space_create
+
+#pragma weak shmemx_space_destroy = pshmemx_space_destroy
+#define shmemx_space_destroy pshmemx_space_destroy
+
+#pragma weak shmemx_space_malloc = pshmemx_space_malloc
+#define shmemx_space_malloc pshmemx_space_malloc
+
+#endif /* ENABLE_PROFILING */
+
+/* Room for the mspace header and chunk overhead on top of the requested size */
+#define SPACE_OVERHEAD  (64 * 1024)
+#define ONEGIG          (1024UL*1024UL*1024UL)
+
+#ifndef CEILING
+#define CEILING(a,b)    ((((a) + (b) - 1) / (b)) * (b))
+#endif
+
+typedef void* mspace;
+mspace create_mspace_with_base(void*, size_t, int);
+size_t mspace_set_footprint_limit(mspace, size_t);
+void* mspace_malloc(mspace, size_t);
+void  mspace_free(mspace, void*);
+void* mspace_realloc(mspace, void*, size_t);
+
+shmem_internal_space_t shmem_internal_spaces[SHMEM_INTERNAL_MAX_SPACES];
+int shmem_internal_nspaces = 0;
+
+/* Where the next space is requested, so that spaces land at the same address
+ * on every PE when the address space layout allows it */
+static char *space_next_hint = NULL;
+
+/* Exchanged between all PEs when a space is created */
+struct space_info_t {
+    uint64_t    key;
+    uint8_t    *addr;
+    void       *base;
+    int32_t     err;
+    int32_t     pad;
+};
+
+
+static void *
+space_map(int id, size_t *len, size_t page_size)
+{
+    void *ret;
+    int flags = MAP_ANON | MAP_PRIVATE;
+    int fd = -1;
+
+    if (NULL == space_next_hint)
+        space_next_hint = (char*) (((uintptr_t) shmem_internal_heap_base +
+                                    shmem_internal_heap_reserve + 2 * ONEGIG) & ~(ONEGIG - 1));
+
+    *len = CEILING(*len, page_size);
+
+#ifdef __linux__
+    if (page_size > (size_t) sysconf(_SC_PAGESIZE)) {
+        char *directory = NULL;
+
+        if (0 == shmem_internal_find_hugepage_dir(page_size, &directory)) {
+            char file_name[PATH_MAX];
+
+            snprintf(file_name, sizeof(file_name), "%s/spacefile.SOS.%d.%d",
+                     directory, getpid(), id);
+            fd = open(file_name, O_CREAT | O_RDWR, 0755);
+            if (fd < 0) {
+                RAISE_WARN_MSG("Unable to open hugetlbfs file, space %d will not "
+                               "use huge pages: %s\n", id, strerror(errno));
+            } else {
+                unlink(file_name);
+                flags = MAP_SHARED;
+            }
+            free(directory);
+        }
+    }
+#endif
+
+    ret = mmap(space_next_hint, *len, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (fd >= 0) close(fd);
+
+    if (MAP_FAILED == ret) {
+        RAISE_WARN_MSG("Unable to map sym. space %d, size %zuB: %s\n", id, *len,
+                       strerror(errno));
+        return NULL;
+    }
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    /* Without a hugetlbfs mount, ask for transparent huge pages instead */
+    if (fd < 0 && page_size > (size_t) sysconf(_SC_PAGESIZE) &&
+        0 != madvise(ret, *len, MADV_HUGEPAGE)) {
+        DEBUG_MSG("madvise(MADV_HUGEPAGE) on sym. space %d failed: %s\n", id,
+                  strerror(errno));
+    }
+#endif
+
+    space_next_hint = (char*) ret + CEILING(*len, ONEGIG) + ONEGIG;
+
+    return ret;
+}
+
+
+static void
+space_release(int id)
+{
+    shmem_internal_space_t *space = &shmem_internal_spaces[id];
+
+    if (NULL != space->mr)
+        shmem_transport_space_unregister(space, id);
+
+    munmap(space->base, space->length);
+    free(space->keys);
+    free(space->addrs);
+    memset(space, 0, sizeof(shmem_internal_space_t));
+
+    while (shmem_internal_nspaces > 0 &&
+           NULL == shmem_internal_spaces[shmem_internal_nspaces-1].base)
+        shmem_internal_nspaces--;
+}
+
+
+/* Map, register and set up the allocator of space id.  Returns nonzero on
+ * error, with nothing left to undo. */
+static int
+space_setup(int id, const shmemx_space_config_t *config)
+{
+    shmem_internal_space_t *space = &shmem_internal_spaces[id];
+    size_t page_size = config->page_size;
+    size_t len = config->sheap_size + SPACE_OVERHEAD;
+
+    if (page_size < (size_t) sysconf(_SC_PAGESIZE))
+        page_size = sysconf(_SC_PAGESIZE);
+
+    space->base = space_map(id, &len, page_size);
+    if (NULL == space->base) return 1;
+
+    space->length = len;
+    space->page_size = page_size;
+    if (id >= shmem_internal_nspaces)
+        shmem_internal_nspaces = id + 1;
+
+    if (config->numa_bind)
+        shmem_internal_heap_bind(space->base, len);
+
+    space->keys  = malloc(shmem_internal_num_pes * sizeof(uint64_t));
+    space->addrs = malloc(shmem_internal_num_pes * sizeof(uint8_t*));
+    space->msp   = create_mspace_with_base(space->base, len, 0);
+
+    if (NULL == space->keys || NULL == space->addrs || NULL == space->msp) {
+        RAISE_WARN_MSG("Unable to set up sym. space %d\n", id);
+        space_release(id);
+        return 1;
+    }
+
+    /* The mspace must not fall back to MORECORE, which would take memory
+     * from the default heap, so cap it at its initial footprint */
+    mspace_set_footprint_limit(space->msp, len);
+
+    if (0 != shmem_transport_space_register(space, id)) {
+        space->mr = NULL;
+        space_release(id);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int SHMEM_FUNCTION_ATTRIBUTES
+shmemx_space_create(const shmemx_space_config_t *config, shmemx_space_t *space_out)
+{
+    struct space_info_t *info, *all;
+    shmem_internal_space_t *space;
+    long *psync;
+    int id, i, err = 0;
+
+    SHMEM_ERR_CHECK_INITIALIZED();
+    SHMEM_ERR_CHECK_NULL(config, 1);
+    SHMEM_ERR_CHECK_NULL(space_out, 1);
+
+    *space_out = SHMEMX_SPACE_INVALID;
+
+    /* Slots are assigned in the same order on every PE */
+    for (id = 0; id < SHMEM_INTERNAL_MAX_SPACES; id++)
+        if (NULL == shmem_internal_spaces[id].base) break;
+
+    if (id == SHMEM_INTERNAL_MAX_SPACES) {
+        RAISE_WARN_MSG("Out of memory spaces (max %d)\n", SHMEM_INTERNAL_MAX_SPACES);
+        return 1;
+    }
+
+    info = shmem_internal_shmalloc(sizeof(struct space_info_t));
+    all  = shmem_internal_shmalloc(shmem_internal_num_pes * sizeof(struct space_info_t));
+    if (NULL == info || NULL == all) {
+        RAISE_ERROR_STR("Out of symmetric memory for space creation");
+    }
+
+    space = &shmem_internal_spaces[id];
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    memset(info, 0, sizeof(struct space_info_t));
+    info->err = space_setup(id, config);
+    if (0 == info->err) {
+        info->key  = space->key;
+        info->addr = space->addr;
+        info->base = space->base;
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    psync = shmem_internal_team_choose_psync(&shmem_internal_team_world, COLLECT);
+    shmem_internal_fcollect(all, info, sizeof(struct space_info_t), 0, 1,
+                            shmem_internal_num_pes, psync);
+    shmem_internal_team_release_psyncs(&shmem_internal_team_world, COLLECT);
+
+    /* Every PE sees the same table, so all make the same decision */
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (all[i].err ||
+            (SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA && all[i].base != all[0].base)) {
+            err = 1;
+            break;
+        }
+    }
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    if (err) {
+        if (i < shmem_internal_num_pes && !all[i].err)
+            RAISE_WARN_STR("Memory space is not at the same address on all PEs");
+        if (0 == info->err)
+            space_release(id);
+    } else {
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            space->keys[i]  = all[i].key;
+            space->addrs[i] = all[i].addr;
+        }
+        *space_out = id;
+
+        DEBUG_MSG("Created sym. space %d at %p, size %zuB, page size %zuB\n",
+                  id, space->base, space->length, space->page_size);
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    shmem_internal_barrier_all();
+
+    shmem_internal_free(all);
+    shmem_internal_free(info);
+
+    return err;
+}
+
+
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_space_destroy(shmemx_space_t space)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    if (space < 0 || space >= shmem_internal_nspaces ||
+        NULL == shmem_internal_spaces[space].base) {
+        RAISE_ERROR_MSG("Invalid memory space (%d)\n", space);
+    }
+
+    shmem_internal_barrier_all();
+
+    /* Deferred frees may refer to the space */
+    shmem_internal_symmetric_drain();
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    space_release(space);
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+}
+
+
+void SHMEM_FUNCTION_ATTRIBUTES *
+shmemx_space_malloc(shmemx_space_t space, size_t size)
+{
+    void *ret = NULL;
+
+    SHMEM_ERR_CHECK_INITIALIZED();
+
+    if (space < 0 || space >= shmem_internal_nspaces ||
+        NULL == shmem_internal_spaces[space].base) {
+        RAISE_ERROR_MSG("Invalid memory space (%d)\n", space);
+    }
+
+    if (size == 0) return ret;
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_alloc);
+    ret = mspace_malloc(shmem_internal_spaces[space].msp, size);
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_alloc);
+
+    shmem_internal_barrier_all();
+
+    return ret;
+}
+
+
+/* Returns 1 if ptr belongs to a memory space and has been released, 0
+ * otherwise.  Must be called with shmem_internal_mutex_alloc held. */
+int
+shmem_internal_space_free(void *ptr)
+{
+    int id;
+
+    if (0 == shmem_internal_nspaces) return 0;
+
+    id = shmem_internal_space_index(ptr);
+    if (id < 0) return 0;
+
+    mspace_free(shmem_internal_spaces[id].msp, ptr);
+    return 1;
+}
+
+
+/* Resize an object within the memory space holding it.  Must be called with
+ * shmem_internal_mutex_alloc held. */
+void *
+shmem_internal_space_realloc(void *ptr, size_t size)
+{
+    int id = shmem_internal_space_index(ptr);
+
+    shmem_internal_assert(id >= 0);
+
+    return mspace_realloc(shmem_internal_spaces[id].msp, ptr, size);
+}
+
+
+/* Release the spaces that were not destroyed by the application.  Called at
+ * shutdown, after the final barrier and before the transport is finalized. */
+void
+shmem_internal_space_fini(void)
+{
+    int id;
+
+    for (id = shmem_internal_nspaces - 1; id >= 0; id--)
+        if (NULL != shmem_internal_spaces[id].base)
+            space_release(id);
+
+    space_next_hint = NULL;
+}
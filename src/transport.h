@@ -64,4 +64,10 @@ typedef enum shm_internal_datatype_t shm_internal_datatype_t;
 
 #endif /* Transport selection */
 
+/* Transport context that carries operations issued on a user context.
+ * Transports may override this to redirect SHMEM_CTX_DEFAULT. */
+#ifndef SHMEM_TRANSPORT_CTX
+#define SHMEM_TRANSPORT_CTX(ctx) ((shmem_transport_ctx_t *)(ctx))
+#endif
+
 #endif /* TRANSPORT_H */
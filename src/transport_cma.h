@@ -26,6 +26,7 @@
 #endif
 
 #include <unistd.h>
+#include <limits.h>
 #include <sys/types.h>
 #include <string.h>
 #include <errno.h>
@@ -47,19 +48,31 @@ int shmem_transport_cma_fini(void);
 #ifdef ENABLE_ERROR_CHECKING
 #define CHK_ACCESS(target,name)                                         \
     do {                                                                \
-        if (((void*) target > shmem_internal_data_base) &&              \
-            ((char*) target < (char*) shmem_internal_data_base + shmem_internal_data_length)) { \
-        } else if (((void*) target > shmem_internal_heap_base) &&       \
-                   ((char*) target < (char*) shmem_internal_heap_base + shmem_internal_heap_length)) { \
+        if (((void*) (target) > shmem_internal_data_base) &&            \
+            ((char*) (target) < (char*) shmem_internal_data_base + shmem_internal_data_length)) { \
+        } else if (((void*) (target) > shmem_internal_heap_base) &&     \
+                   ((char*) (target) < (char*) shmem_internal_heap_base + shmem_internal_heap_length)) { \
         } else {                                                        \
             RAISE_ERROR_MSG("%s (0x%"PRIXPTR") outside of symmetric areas\n", \
-                            name, (uintptr_t) target);                  \
+                            name, (uintptr_t) (target));                \
         }                                                               \
     } while (0)
 #else   // ! ENABLE_ERROR_CHECKING
 #define CHK_ACCESS(target,id)
 #endif
 
+/* Maximum number of segments handed to a single process_vm_writev/readv
+ * call.  The kernel rejects larger vectors (UIO_MAXIOV). */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+#define SHMEM_TRANSPORT_CMA_IOV_MAX IOV_MAX
+#else
+#define SHMEM_TRANSPORT_CMA_IOV_MAX 1024
+#endif
+
+/* Number of blocks gathered per system call by the strided routines.  The
+ * vectors live on the stack, so this is kept well below the IOV_MAX limit. */
+#define SHMEM_TRANSPORT_CMA_STRIDED_CHUNK 64
+
 #ifndef HAVE_LIBC_CMA
 
 static inline
@@ -144,4 +157,130 @@ shmem_transport_cma_get(void *target, const void *source, size_t len, int pe,
         }
 }
 
+/* Vectored transfers.  The local and remote vectors must have the same
+ * number of entries, and corresponding entries must have the same length.
+ * Vectors longer than SHMEM_TRANSPORT_CMA_IOV_MAX are split into several
+ * system calls. */
+static inline void
+shmem_transport_cma_putv(const struct iovec *remote, const struct iovec *local,
+                         size_t count, int pe, int noderank)
+{
+        ssize_t bytes;
+        size_t i, n, len;
+        pid_t target_pid = shmem_transport_cma_peers[noderank];
+
+        if ( target_pid == shmem_transport_cma_my_pid ) {
+            for (i = 0; i < count; i++)
+                memcpy(remote[i].iov_base, local[i].iov_base, local[i].iov_len);
+            return;
+        }
+
+        for ( ; count > 0; count -= n, remote += n, local += n) {
+            n = count < SHMEM_TRANSPORT_CMA_IOV_MAX ? count : SHMEM_TRANSPORT_CMA_IOV_MAX;
+
+            for (i = 0, len = 0; i < n; i++)
+                len += local[i].iov_len;
+
+            bytes = process_vm_writev(target_pid, local, n, remote, n, 0);
+
+            if ( bytes < 0 || (size_t) bytes != len) {
+                char errmsg[256];
+                RAISE_ERROR_MSG("process_vm_writev() failed (%s)\n",
+                                shmem_util_strerror(errno, errmsg, 256));
+            }
+        }
+}
+
+
+static inline void
+shmem_transport_cma_getv(const struct iovec *local, const struct iovec *remote,
+                         size_t count, int pe, int noderank)
+{
+        ssize_t bytes;
+        size_t i, n, len;
+        pid_t target_pid = shmem_transport_cma_peers[noderank];
+
+        if ( target_pid == shmem_transport_cma_my_pid ) {
+            for (i = 0; i < count; i++)
+                memcpy(local[i].iov_base, remote[i].iov_base, remote[i].iov_len);
+            return;
+        }
+
+        for ( ; count > 0; count -= n, remote += n, local += n) {
+            n = count < SHMEM_TRANSPORT_CMA_IOV_MAX ? count : SHMEM_TRANSPORT_CMA_IOV_MAX;
+
+            for (i = 0, len = 0; i < n; i++)
+                len += local[i].iov_len;
+
+            bytes = process_vm_readv(target_pid, local, n, remote, n, 0);
+
+            if ( bytes < 0 || (size_t) bytes != len) {
+                char errmsg[256];
+                RAISE_ERROR_MSG("process_vm_readv() failed (%s)\n",
+                                shmem_util_strerror(errno, errmsg, 256));
+            }
+        }
+}
+
+
+/* Strided transfers of nblocks blocks of bsize bytes; strides are in bytes.
+ * Blocks are gathered into vectors of up to SHMEM_TRANSPORT_CMA_STRIDED_CHUNK
+ * segments, so that each system call moves many blocks. */
+static inline void
+shmem_transport_cma_iput(void *target, const void *source, ptrdiff_t tst,
+                         ptrdiff_t sst, size_t bsize, size_t nblocks, int pe,
+                         int noderank)
+{
+        struct iovec tgt[SHMEM_TRANSPORT_CMA_STRIDED_CHUNK];
+        struct iovec src[SHMEM_TRANSPORT_CMA_STRIDED_CHUNK];
+        size_t i, n;
+
+        CHK_ACCESS(target,"cma_iput target");
+        CHK_ACCESS((char *) target + (nblocks - 1) * tst,"cma_iput target");
+
+        for ( ; nblocks > 0; nblocks -= n) {
+            n = nblocks < SHMEM_TRANSPORT_CMA_STRIDED_CHUNK ? nblocks :
+                SHMEM_TRANSPORT_CMA_STRIDED_CHUNK;
+
+            for (i = 0; i < n; i++) {
+                tgt[i].iov_base = target;
+                src[i].iov_base = (void *) source;
+                tgt[i].iov_len = src[i].iov_len = bsize;
+                target = (char *) target + tst;
+                source = (const char *) source + sst;
+            }
+
+            shmem_transport_cma_putv(tgt, src, n, pe, noderank);
+        }
+}
+
+
+static inline void
+shmem_transport_cma_iget(void *target, const void *source, ptrdiff_t tst,
+                         ptrdiff_t sst, size_t bsize, size_t nblocks, int pe,
+                         int noderank)
+{
+        struct iovec tgt[SHMEM_TRANSPORT_CMA_STRIDED_CHUNK];
+        struct iovec src[SHMEM_TRANSPORT_CMA_STRIDED_CHUNK];
+        size_t i, n;
+
+        CHK_ACCESS(source,"cma_iget source");
+        CHK_ACCESS((const char *) source + (nblocks - 1) * sst,"cma_iget source");
+
+        for ( ; nblocks > 0; nblocks -= n) {
+            n = nblocks < SHMEM_TRANSPORT_CMA_STRIDED_CHUNK ? nblocks :
+                SHMEM_TRANSPORT_CMA_STRIDED_CHUNK;
+
+            for (i = 0; i < n; i++) {
+                tgt[i].iov_base = target;
+                src[i].iov_base = (void *) source;
+                tgt[i].iov_len = src[i].iov_len = bsize;
+                target = (char *) target + tst;
+                source = (const char *) source + sst;
+            }
+
+            shmem_transport_cma_getv(tgt, src, n, pe, noderank);
+        }
+}
+
 #endif /* SHMEM_TRANSPORT_CMA_H */
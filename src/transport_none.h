@@ -41,6 +41,12 @@ struct shmem_transport_ctx_t {
 };
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 
+/* Nothing is registered, so the symmetric heap can grow in place */
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 1
+
+/* Memory spaces are not supported by this transport */
+#define SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA 0
+
 int shmem_transport_init(void);
 
 static inline
@@ -306,6 +312,15 @@ void shmem_transport_get_ct(shmem_transport_ct_t *ct, void
     RAISE_ERROR_STR("No path to peer");
 }
 
+/**
+ * Whether a waiting PE may block in shmem_transport_received_cntr_wait.
+ */
+static inline
+int shmem_transport_received_cntr_can_wait(void)
+{
+    return 0;
+}
+
 /**
  * Query the value of the transport's received messages counter.
  */
@@ -370,4 +385,65 @@ void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *p
     return;
 }
 
+static inline
+void shmem_transport_pcntr_get_wait(shmem_transport_ctx_t *ctx, shmemx_pcntr_wait_t *wait)
+{
+    wait->spin_ns = wait->yield_ns = wait->block_ns = wait->count = 0;
+    return;
+}
+
+static inline
+int shmem_transport_register_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_unregister_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_space_register(shmem_internal_space_t *space, int id)
+{
+    RAISE_WARN_STR("Memory spaces are not supported by the none transport");
+    return 1;
+}
+
+static inline
+void shmem_transport_space_unregister(shmem_internal_space_t *space, int id)
+{
+    return;
+}
+
+static inline
+int shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_quiet(ctx);
+}
+
+static inline
+int shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_fence(ctx);
+}
+
+static inline
+void shmem_transport_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                  const void *source, size_t count, size_t len,
+                                  int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
+static inline
+void shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                        const void *source, void *dest, size_t count,
+                                        size_t len, int pe, shm_internal_op_t op,
+                                        shm_internal_datatype_t datatype)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
 #endif /* TRANSPORT_NONE_H */
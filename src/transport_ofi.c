@@ -52,9 +52,13 @@
 #include "runtime.h"
 #include "uthash.h"
 
+#define SHMEM_TRANSPORT_OFI_RAIL_FABRIC_LEN 64
+
 struct fabric_info {
     struct fi_info *fabrics;
     struct fi_info *p_info;
+    struct fi_info *rail_info[SHMEM_TRANSPORT_OFI_MAX_RAILS];
+    int nrails;
     char *prov_name;
     char *fabric_name;
     char *domain_name;
@@ -87,6 +91,11 @@ int                             shmem_transport_ofi_use_absolute_address;
 uint8_t**                       shmem_transport_ofi_target_heap_addrs;
 uint8_t**                       shmem_transport_ofi_target_data_addrs;
 #endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+shmem_transport_ofi_mr_entry_t**shmem_transport_ofi_mr_pages = NULL;
+static size_t                   shmem_transport_ofi_mr_npages;
+#ifdef ENABLE_THREADS
+static shmem_internal_mutex_t   shmem_transport_ofi_mr_lock;
+#endif
 #endif /* ENABLE_MR_SCALABLE */
 
 #ifdef USE_FI_HMEM
@@ -96,7 +105,8 @@ uint8_t**                       shmem_transport_ofi_external_heap_addrs;
 #endif
 
 /* List of MR descriptors: current support is for heap, data, and one external heap */
-struct fid_mr*                  shmem_transport_ofi_mrfd_list[3];
+struct fid_mr*                  shmem_transport_ofi_mrfd_list[SHMEM_TRANSPORT_OFI_SPACE_MR_BASE +
+                                                              SHMEM_INTERNAL_MAX_SPACES];
 uint64_t                        shmem_transport_ofi_max_poll;
 long                            shmem_transport_ofi_put_poll_limit;
 long                            shmem_transport_ofi_get_poll_limit;
@@ -105,15 +115,86 @@ size_t                          shmem_transport_ofi_max_msg_size;
 size_t                          shmem_transport_ofi_bounce_buffer_size;
 long                            shmem_transport_ofi_max_bounce_buffers;
 size_t                          shmem_transport_ofi_addrlen;
+struct shmem_transport_ofi_rail_t *shmem_transport_ofi_rails;
+int                             shmem_transport_ofi_num_rails;
+int                             shmem_transport_ofi_num_shards = 1;
+size_t                          shmem_transport_ofi_stripe_threshold;
 #ifdef ENABLE_MR_RMA_EVENT
 int                             shmem_transport_ofi_mr_rma_event;
 #endif
 fi_addr_t                       *addr_table;
+fi_addr_t                       **shmem_transport_ofi_av_pages = NULL;
+struct shmem_transport_ofi_rail_peer_t **shmem_transport_ofi_rail_peer_pages = NULL;
+static size_t                   shmem_transport_ofi_av_npages;
+static int                      shmem_transport_ofi_lazy_av = 0;
+#ifdef ENABLE_THREADS
+static shmem_internal_mutex_t   shmem_transport_ofi_av_lock;
+#endif
+int                             shmem_transport_ofi_mr_cache_mode = SHMEM_TRANSPORT_OFI_MR_CACHE_OFF;
+size_t                          shmem_transport_ofi_mr_cache_threshold;
+/* Cached registrations, sorted by start address.  max_end[i] is the largest
+ * end address among entries 0..i, which bounds the search for a covering
+ * entry. */
+static shmem_transport_ofi_mr_cache_entry_t **shmem_transport_ofi_mr_cache;
+static uint8_t                  **shmem_transport_ofi_mr_cache_max_end;
+static size_t                   shmem_transport_ofi_mr_cache_cnt;
+static size_t                   shmem_transport_ofi_mr_cache_len;
+static uint64_t                 shmem_transport_ofi_mr_cache_key;
+#ifdef ENABLE_THREADS
+static shmem_internal_mutex_t   shmem_transport_ofi_mr_cache_lock;
+#endif
 #ifdef ENABLE_THREADS
 shmem_internal_mutex_t          shmem_transport_ofi_lock;
 pthread_mutex_t                 shmem_transport_ofi_progress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t                shmem_transport_ofi_progress_thread;
+static int                      shmem_transport_ofi_progress_thread_enabled = 0;
 #endif /* ENABLE_THREADS */
 
+/* Software atomics engine.  Each PE owns one request slot per source PE and
+ * one reply slot per target PE in the symmetric heap.  A source posts a
+ * request by writing the slot body, completing it, and then writing a new
+ * sequence number; the target applies the operation when it observes the
+ * new sequence number and returns the prior value the same way.  A source
+ * has at most one request outstanding to each target, so a slot is never
+ * rewritten while it is in use.  All engine traffic is issued on a dedicated
+ * context under shmem_transport_ofi_amo_lock. */
+enum shmem_transport_ofi_amo_emulation_t {
+    SHMEM_TRANSPORT_OFI_AMO_EMULATION_OFF = 0,
+    SHMEM_TRANSPORT_OFI_AMO_EMULATION_AUTO,   /* Only if the provider lacks AMOs */
+    SHMEM_TRANSPORT_OFI_AMO_EMULATION_ON
+};
+
+struct shmem_transport_ofi_amo_req_t {
+    uint64_t    offset;         /* Offset of the target in its segment */
+    uint8_t     operand[8];
+    uint8_t     compare[8];     /* Comparand (FI_CSWAP) or mask (FI_MSWAP) */
+    int32_t     seg;            /* 0: data segment, 1: symmetric heap, 2+: space */
+    int32_t     op;
+    int32_t     datatype;       /* libfabric datatype */
+    int32_t     pad;
+    uint64_t    seq;            /* Written last; zero until first use */
+};
+typedef struct shmem_transport_ofi_amo_req_t shmem_transport_ofi_amo_req_t;
+
+struct shmem_transport_ofi_amo_rep_t {
+    uint8_t     result[8];
+    uint64_t    seq;
+};
+typedef struct shmem_transport_ofi_amo_rep_t shmem_transport_ofi_amo_rep_t;
+
+int                             shmem_transport_ofi_amo_emulated = 0;
+static int                      shmem_transport_ofi_amo_mode = SHMEM_TRANSPORT_OFI_AMO_EMULATION_AUTO;
+static uint64_t                 shmem_transport_ofi_atomic_caps = FI_ATOMIC;
+static shmem_transport_ctx_t    *shmem_transport_ofi_amo_ctx = NULL;
+static shmem_transport_ofi_amo_req_t *shmem_transport_ofi_amo_req;
+static shmem_transport_ofi_amo_rep_t *shmem_transport_ofi_amo_rep;
+static uint64_t                 *shmem_transport_ofi_amo_seq;   /* Last request posted to each PE */
+static uint64_t                 *shmem_transport_ofi_amo_done;  /* Last request applied for each PE */
+#if ENABLE_TARGET_CNTR
+static uint64_t                 shmem_transport_ofi_amo_target_cnt = 0;
+#endif
+static pthread_mutex_t          shmem_transport_ofi_amo_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /* Temporarily redefine SHM_INTERNAL integer types to their FI counterparts to
  * translate the DTYPE_* types (defined by autoconf according to system ABI)
  * into FI types in the table below */
@@ -213,6 +294,20 @@ static size_t shmem_transport_ofi_grow_size = 128;
 shmem_transport_ctx_t shmem_transport_ctx_default;
 shmem_ctx_t SHMEM_CTX_DEFAULT = (shmem_ctx_t) &shmem_transport_ctx_default;
 
+#define SHMEM_TRANSPORT_CTX_THREAD_ID -2
+#define SHMEM_TRANSPORT_CTX_AMO_ID -3
+#ifdef ENABLE_THREADS
+/* Contexts backing SHMEM_CTX_DEFAULT on threads other than the one that
+ * initialized the library, protected by shmem_transport_ofi_lock */
+int                              shmem_transport_ofi_thread_default_ctx = 0;
+__thread shmem_transport_ctx_t  *shmem_transport_ofi_thread_ctx = NULL;
+static shmem_transport_ctx_t   **shmem_transport_ofi_thread_ctxs = NULL;
+static size_t                    shmem_transport_ofi_thread_ctxs_len = 0;
+static pthread_key_t             shmem_transport_ofi_thread_ctx_key;
+
+static void shmem_transport_ofi_thread_ctx_release(void *arg);
+#endif
+
 size_t SHMEM_Dtsize[FI_DATATYPE_LAST];
 
 static char * SHMEM_DtName[FI_DATATYPE_LAST];
@@ -372,18 +467,27 @@ uint64_t shmem_transport_ofi_max_poll = (1ULL<<30);
 
 enum stx_allocator_t {
     ROUNDROBIN = 0,
-    RANDOM
+    RANDOM,
+    NUMA
 };
 typedef enum stx_allocator_t stx_allocator_t;
 static stx_allocator_t shmem_transport_ofi_stx_allocator;
 
 static long shmem_transport_ofi_stx_max;
 static long shmem_transport_ofi_stx_threshold;
+/* Number of NUMA groups the STX pool is partitioned into by the NUMA allocator */
+static int  shmem_transport_ofi_stx_ngroups = 1;
 
 struct shmem_transport_ofi_stx_t {
     struct fid_stx*   stx;
     long              ref_cnt;
     int               is_private;
+    int               group;
+    /* Utilization, reported by shmem_transport_ofi_dump_stx */
+    uint64_t          ctx_cnt;  /* Contexts assigned over the STX lifetime */
+    uint64_t          put_cnt;  /* Put/AMO operations issued by destroyed contexts */
+    uint64_t          get_cnt;  /* Get/fetching operations issued by destroyed contexts */
+    shmem_transport_ctx_t *ctxs; /* Live contexts, whose operations are added on report */
 };
 typedef struct shmem_transport_ofi_stx_t shmem_transport_ofi_stx_t;
 static shmem_transport_ofi_stx_t* shmem_transport_ofi_stx_pool = NULL;
@@ -411,6 +515,27 @@ void shmem_transport_ofi_dump_stx(void) {
                            shmem_transport_ofi_stx_pool[i].is_private ? "P" : "S");
 
     DEBUG_MSG("STX[%ld] = [ %s ]\n", shmem_transport_ofi_stx_max, stx_str);
+
+    if (shmem_internal_params.DEBUG) {
+        for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+            shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+            uint64_t put_cnt = stx->put_cnt, get_cnt = stx->get_cnt;
+
+            /* Counts of contexts in use may be read while they issue
+             * operations, so the totals are approximate */
+            for (shmem_transport_ctx_t *ctx = stx->ctxs; ctx != NULL; ctx = ctx->stx_next) {
+                put_cnt += SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+                           shmem_transport_ofi_shards_cnt(ctx, 1, 0);
+                get_cnt += SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr) +
+                           shmem_transport_ofi_shards_cnt(ctx, 0, 0);
+            }
+
+            DEBUG_MSG("STX %d: group = %d, %s, ref_cnt = %ld, ctx_cnt = %"PRIu64
+                      ", put_cnt = %"PRIu64", get_cnt = %"PRIu64"\n",
+                      i, stx->group, stx->is_private ? "private" : "shared",
+                      stx->ref_cnt, stx->ctx_cnt, put_cnt, get_cnt);
+        }
+    }
 }
 
 static inline
@@ -431,16 +556,78 @@ void shmem_transport_ofi_stx_rand_init(void) {
     return;
 }
 
+/* Return the STX group that is local to the calling thread, based on the
+ * NUMA node of the CPU it last ran on */
+static inline
+int shmem_transport_ofi_stx_local_group(void)
+{
+    int group = 0;
+
+#ifdef USE_HWLOC
+    if (shmem_transport_ofi_stx_ngroups > 1) {
+        hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+
+        if (0 == hwloc_get_last_cpu_location(shmem_internal_topology, cpuset,
+                                             HWLOC_CPUBIND_THREAD)) {
+            hwloc_obj_t numa = hwloc_get_next_obj_covering_cpuset_by_type(shmem_internal_topology,
+                                                                          cpuset, HWLOC_OBJ_NUMANODE,
+                                                                          NULL);
+            if (numa)
+                group = numa->logical_index % shmem_transport_ofi_stx_ngroups;
+        }
+
+        hwloc_bitmap_free(cpuset);
+    }
+#endif
+
+    return group;
+}
+
+/* Partition the STX pool into contiguous per-NUMA-node groups */
+static inline
+void shmem_transport_ofi_stx_group_init(void)
+{
+    int i;
+
+    shmem_transport_ofi_stx_ngroups = 1;
+
+#ifdef USE_HWLOC
+    if (shmem_transport_ofi_stx_allocator == NUMA) {
+        int nnuma = hwloc_get_nbobjs_by_type(shmem_internal_topology, HWLOC_OBJ_NUMANODE);
+
+        if (nnuma > 1)
+            shmem_transport_ofi_stx_ngroups = nnuma;
+        if (shmem_transport_ofi_stx_ngroups > shmem_transport_ofi_stx_max)
+            shmem_transport_ofi_stx_ngroups = shmem_transport_ofi_stx_max;
+    }
+#endif
+
+    for (i = 0; i < shmem_transport_ofi_stx_max; i++)
+        shmem_transport_ofi_stx_pool[i].group =
+            (int) ((long) i * shmem_transport_ofi_stx_ngroups / shmem_transport_ofi_stx_max);
+
+    DEBUG_MSG("STX pool partitioned into %d group(s)\n", shmem_transport_ofi_stx_ngroups);
+}
+
 static inline
 int shmem_transport_ofi_stx_search_unused(void)
 {
     int stx_idx = -1, i;
+    int group = -1;
+
+    /* Prefer an unused STX in the local group */
+    if (shmem_transport_ofi_stx_allocator == NUMA)
+        group = shmem_transport_ofi_stx_local_group();
 
     for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
         if (shmem_transport_ofi_stx_pool[i].ref_cnt == 0) {
             shmem_internal_assert(!shmem_transport_ofi_stx_pool[i].is_private);
-            stx_idx = i;
-            break;
+            if (stx_idx < 0)
+                stx_idx = i;
+            if (group < 0 || shmem_transport_ofi_stx_pool[i].group == group) {
+                stx_idx = i;
+                break;
+            }
         }
     }
 
@@ -495,6 +682,36 @@ int shmem_transport_ofi_stx_search_shared(long threshold)
             }
 
             break;
+
+        case NUMA:
+            {
+                /* Select the least loaded STX in the local group.  When no
+                 * threshold is given (last resort), fall back to the least
+                 * loaded STX in any group. */
+                int group = shmem_transport_ofi_stx_local_group();
+                int any_idx = -1;
+
+                for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+                    shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+
+                    if (!(stx->ref_cnt > 0 && (stx->ref_cnt <= threshold || threshold == -1) &&
+                          !stx->is_private))
+                        continue;
+
+                    if (stx->group == group &&
+                        (stx_idx < 0 || stx->ref_cnt < shmem_transport_ofi_stx_pool[stx_idx].ref_cnt))
+                        stx_idx = i;
+
+                    if (any_idx < 0 || stx->ref_cnt < shmem_transport_ofi_stx_pool[any_idx].ref_cnt)
+                        any_idx = i;
+                }
+
+                if (stx_idx < 0 && threshold == -1)
+                    stx_idx = any_idx;
+            }
+
+            break;
+
         default:
             RAISE_ERROR_MSG("Invalid STX allocator (%d)\n",
                             shmem_transport_ofi_stx_allocator);
@@ -574,6 +791,17 @@ void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
         shmem_transport_ofi_stx_pool[ctx->stx_idx].ref_cnt++;
     }
 
+    if (ctx->stx_idx >= 0) {
+        shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[ctx->stx_idx];
+
+        stx->ctx_cnt++;
+        ctx->stx_prev = NULL;
+        ctx->stx_next = stx->ctxs;
+        if (stx->ctxs)
+            stx->ctxs->stx_prev = ctx;
+        stx->ctxs = ctx;
+    }
+
     shmem_transport_ofi_dump_stx();
 
     return;
@@ -635,6 +863,154 @@ int bind_enable_ep_resources(shmem_transport_ctx_t *ctx)
     return ret;
 }
 
+/* Open an endpoint on each secondary rail for striped transfers.  These
+ * endpoints do not use STXs or bounce buffers. */
+static inline
+int ctx_rails_init(shmem_transport_ctx_t *ctx)
+{
+    int i, ret = 0;
+    struct fi_cntr_attr cntr_attr = {0};
+    struct fi_cq_attr cq_attr = {0};
+
+    ctx->rails = NULL;
+
+    if (shmem_transport_ofi_num_rails == 0)
+        return 0;
+
+    /* Rail counters are waited on by the wait policy engine, which only
+     * sleeps in the provider when the policy allows blocking */
+    cntr_attr.events = FI_CNTR_EVENTS_COMP;
+    if (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_BLOCK ||
+        shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_ADAPTIVE)
+        cntr_attr.wait_obj = FI_WAIT_UNSPEC;
+    else
+        cntr_attr.wait_obj = FI_WAIT_NONE;
+
+    cq_attr.format = FI_CQ_FORMAT_CONTEXT;
+
+    ctx->rails = calloc(shmem_transport_ofi_num_rails,
+                        sizeof(struct shmem_transport_ofi_ctx_rail_t));
+    if (ctx->rails == NULL) {
+        RAISE_WARN_STR("Out of memory allocating context rails");
+        return 1;
+    }
+
+    for (i = 0; i < shmem_transport_ofi_num_rails; i++) {
+        struct shmem_transport_ofi_ctx_rail_t *rail = &ctx->rails[i];
+        struct fi_info *info = shmem_transport_ofi_rails[i].info;
+        struct fid_domain *domain = shmem_transport_ofi_rails[i].domain;
+
+#ifndef USE_CTX_LOCK
+        shmem_internal_cntr_write(&rail->pending_put_cntr, 0);
+        shmem_internal_cntr_write(&rail->pending_get_cntr, 0);
+        shmem_internal_cntr_write(&rail->completed_put_cntr, 0);
+        shmem_internal_cntr_write(&rail->completed_get_cntr, 0);
+#endif
+
+        info->ep_attr->tx_ctx_cnt = 0;
+        info->caps = FI_RMA | FI_WRITE | FI_READ | shmem_transport_ofi_atomic_caps | FI_RECV;
+        info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
+        info->mode = 0;
+        info->tx_attr->mode = 0;
+        info->rx_attr->mode = 0;
+        info->tx_attr->caps = info->caps;
+        info->rx_attr->caps = FI_RECV; /* to drive progress on the CQ */
+
+        ret = fi_cntr_open(domain, &cntr_attr, &rail->put_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail put_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_cntr_open(domain, &cntr_attr, &rail->get_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail get_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_cq_open(domain, &cq_attr, &rail->cq, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail cq_open failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_endpoint(domain, info, &rail->ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail ep creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_ep_bind(rail->ep, &rail->put_cntr->fid, FI_WRITE);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind put CNTR to rail endpoint failed");
+
+        ret = fi_ep_bind(rail->ep, &rail->get_cntr->fid, FI_READ);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind get CNTR to rail endpoint failed");
+
+        ret = fi_ep_bind(rail->ep, &rail->cq->fid,
+                         FI_SELECTIVE_COMPLETION | FI_TRANSMIT | FI_RECV);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to rail endpoint failed");
+
+        ret = fi_ep_bind(rail->ep, &shmem_transport_ofi_rails[i].av->fid, 0);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to rail endpoint failed");
+
+        ret = fi_enable(rail->ep);
+        OFI_CHECK_RETURN_STR(ret, "fi_enable on rail endpoint failed");
+    }
+
+    return ret;
+}
+
+/* Open the endpoints for destination shards 1..n-1.  They share the
+ * context's STX and CQ, but have their own completion counters. */
+static inline
+int ctx_shards_init(shmem_transport_ctx_t *ctx, struct fi_cntr_attr *cntr_put_attr,
+                    struct fi_cntr_attr *cntr_get_attr)
+{
+    int i, ret = 0;
+    struct fabric_info *info = &shmem_transport_ofi_info;
+
+    ctx->shards = NULL;
+
+    if (shmem_transport_ofi_num_shards <= 1)
+        return 0;
+
+    ctx->shards = calloc(shmem_transport_ofi_num_shards - 1,
+                         sizeof(struct shmem_transport_ofi_ctx_shard_t));
+    if (ctx->shards == NULL) {
+        RAISE_WARN_STR("Out of memory allocating context shards");
+        return 1;
+    }
+
+    for (i = 0; i < shmem_transport_ofi_num_shards - 1; i++) {
+        struct shmem_transport_ofi_ctx_shard_t *shard = &ctx->shards[i];
+
+#ifndef USE_CTX_LOCK
+        shmem_internal_cntr_write(&shard->pending_put_cntr, 0);
+        shmem_internal_cntr_write(&shard->pending_get_cntr, 0);
+#endif
+
+        ret = fi_cntr_open(shmem_transport_ofi_domainfd, cntr_put_attr, &shard->put_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "shard put_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_cntr_open(shmem_transport_ofi_domainfd, cntr_get_attr, &shard->get_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "shard get_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_endpoint(shmem_transport_ofi_domainfd, info->p_info, &shard->ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "shard ep creation failed (%s)\n", fi_strerror(errno));
+
+        if (ctx->stx_idx >= 0) {
+            ret = fi_ep_bind(shard->ep, &shmem_transport_ofi_stx_pool[ctx->stx_idx].stx->fid, 0);
+            OFI_CHECK_RETURN_STR(ret, "fi_ep_bind STX to shard endpoint failed");
+        }
+
+        ret = fi_ep_bind(shard->ep, &shard->put_cntr->fid, FI_WRITE);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind put CNTR to shard endpoint failed");
+
+        ret = fi_ep_bind(shard->ep, &shard->get_cntr->fid, FI_READ);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind get CNTR to shard endpoint failed");
+
+        ret = fi_ep_bind(shard->ep, &ctx->cq->fid,
+                         FI_SELECTIVE_COMPLETION | FI_TRANSMIT | FI_RECV);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to shard endpoint failed");
+
+        ret = fi_ep_bind(shard->ep, &shmem_transport_ofi_avfd->fid, 0);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to shard endpoint failed");
+
+        ret = fi_enable(shard->ep);
+        OFI_CHECK_RETURN_STR(ret, "fi_enable on shard endpoint failed");
+    }
+
+    return ret;
+}
+
 #ifdef USE_FI_HMEM
 static inline
 int ofi_mr_reg_external_heap(void)
@@ -990,11 +1366,73 @@ int populate_external_mr_tables(void)
 }
 #endif
 
+#ifndef ENABLE_MR_SCALABLE
+/* Resolve the MR keys and addresses of the given PE from the runtime KVS.
+ * Entries are never evicted; they are written once under the MR lock and
+ * published to lock-free readers through the valid flag. */
+shmem_transport_ofi_mr_entry_t *shmem_transport_ofi_mr_fetch(int pe)
+{
+    shmem_transport_ofi_mr_entry_t *page, *e;
+    size_t page_idx = pe >> SHMEM_TRANSPORT_OFI_MR_PAGE_SHIFT;
+    int err;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_mr_lock);
+
+    page = shmem_transport_ofi_mr_pages[page_idx];
+    if (page == NULL) {
+        page = calloc(SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE, sizeof(shmem_transport_ofi_mr_entry_t));
+        if (page == NULL) {
+            RAISE_ERROR_STR("Out of memory allocating MR table page");
+        }
+        __atomic_store_n(&shmem_transport_ofi_mr_pages[page_idx], page, __ATOMIC_RELEASE);
+    }
+
+    e = &page[pe & (SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE - 1)];
+    if (!e->valid) {
+        SHMEM_MUTEX_LOCK(shmem_internal_mutex_runtime);
+        err = shmem_runtime_get(pe, "fi_heap_key", &e->heap_key, sizeof(uint64_t));
+        if (err) {
+            RAISE_ERROR_MSG("Get of heap key for PE %d from runtime KVS failed\n", pe);
+        }
+        err = shmem_runtime_get(pe, "fi_data_key", &e->data_key, sizeof(uint64_t));
+        if (err) {
+            RAISE_ERROR_MSG("Get of data segment key for PE %d from runtime KVS failed\n", pe);
+        }
+#ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+        err = shmem_runtime_get(pe, "fi_heap_addr", &e->heap_addr, sizeof(uint8_t*));
+        if (err) {
+            RAISE_ERROR_MSG("Get of heap address for PE %d from runtime KVS failed\n", pe);
+        }
+        err = shmem_runtime_get(pe, "fi_data_addr", &e->data_addr, sizeof(uint8_t*));
+        if (err) {
+            RAISE_ERROR_MSG("Get of data segment address for PE %d from runtime KVS failed\n", pe);
+        }
+#endif
+        SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_runtime);
+        __atomic_store_n(&e->valid, 1, __ATOMIC_RELEASE);
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_mr_lock);
+
+    return e;
+}
+#endif /* !ENABLE_MR_SCALABLE */
+
 static
 int populate_mr_tables(void)
 {
 #ifndef ENABLE_MR_SCALABLE
-    {
+    if (shmem_internal_params.OFI_LAZY_MR_TABLES) {
+        shmem_transport_ofi_mr_npages = (shmem_internal_num_pes + SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE - 1) /
+                                        SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE;
+        shmem_transport_ofi_mr_pages = calloc(shmem_transport_ofi_mr_npages,
+                                              sizeof(shmem_transport_ofi_mr_entry_t*));
+        if (NULL == shmem_transport_ofi_mr_pages) {
+            RAISE_WARN_STR("Out of memory allocating MR page table");
+            return 1;
+        }
+        SHMEM_MUTEX_INIT(shmem_transport_ofi_mr_lock);
+    } else {
         int i, err;
 
         shmem_transport_ofi_target_heap_keys = malloc(sizeof(uint64_t) * shmem_internal_num_pes);
@@ -1029,7 +1467,7 @@ int populate_mr_tables(void)
     }
 
 #ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-    {
+    if (shmem_transport_ofi_mr_pages == NULL) {
         int i, err;
 
         shmem_transport_ofi_target_heap_addrs = malloc(sizeof(uint8_t*) * shmem_internal_num_pes);
@@ -1260,12 +1698,67 @@ int publish_av_info(struct fabric_info *info)
     return ret;
 }
 
+/* Insert the given PE into the AV on first use, fetching its endpoint name
+ * from the runtime KVS */
+fi_addr_t shmem_transport_ofi_av_insert_pe(int pe)
+{
+    fi_addr_t *page, addr;
+    size_t page_idx = pe >> SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT;
+    size_t page_off = pe & (SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE - 1);
+    int ret;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_av_lock);
+
+    page = shmem_transport_ofi_av_pages[page_idx];
+    if (page == NULL) {
+        page = calloc(SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE, sizeof(fi_addr_t));
+        if (page == NULL) {
+            RAISE_ERROR_STR("Out of memory allocating AV page");
+        }
+        __atomic_store_n(&shmem_transport_ofi_av_pages[page_idx], page, __ATOMIC_RELEASE);
+    }
+
+    if (page[page_off] == 0) {
+        char epname[shmem_transport_ofi_addrlen];
+
+        SHMEM_MUTEX_LOCK(shmem_internal_mutex_runtime);
+        ret = shmem_runtime_get(pe, "fi_epname", epname, shmem_transport_ofi_addrlen);
+        SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_runtime);
+        if (ret != 0) {
+            RAISE_ERROR_MSG("Runtime get of 'fi_epname' for PE %d failed\n", pe);
+        }
+
+        ret = fi_av_insert(shmem_transport_ofi_avfd, epname, 1, &addr, 0, NULL);
+        if (ret != 1) {
+            RAISE_ERROR_MSG("AV insert of PE %d failed (%d)\n", pe, ret);
+        }
+
+        __atomic_store_n(&page[page_off], addr + 1, __ATOMIC_RELEASE);
+    }
+
+    addr = page[page_off] - 1;
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_av_lock);
+
+    return addr;
+}
+
 static inline
 int populate_av(void)
 {
     int    i, ret, err = 0;
     char   *alladdrs = NULL;
 
+    if (shmem_transport_ofi_lazy_av) {
+        shmem_transport_ofi_av_pages = calloc(shmem_transport_ofi_av_npages, sizeof(fi_addr_t*));
+        if (shmem_transport_ofi_av_pages == NULL) {
+            RAISE_WARN_STR("Out of memory allocating AV page table");
+            return 1;
+        }
+        SHMEM_MUTEX_INIT(shmem_transport_ofi_av_lock);
+        return 0;
+    }
+
     alladdrs = malloc(shmem_internal_num_pes * shmem_transport_ofi_addrlen);
     if (alladdrs == NULL) {
         RAISE_WARN_STR("Out of memory allocating 'alladdrs'");
@@ -1329,9 +1822,24 @@ int allocate_fabric_resources(struct fabric_info *info)
 
     /* AV table set-up for PE mapping */
 
+    /* Peers are inserted while other threads may be transferring data over
+     * the same AV, which only FI_THREAD_SAFE domains allow */
+    shmem_transport_ofi_lazy_av = shmem_internal_params.OFI_LAZY_AV;
+    if (shmem_transport_ofi_lazy_av &&
+        shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE &&
+        info->p_info->domain_attr->threading != FI_THREAD_SAFE) {
+        RAISE_WARN_STR("SHMEM_OFI_LAZY_AV with SHMEM_THREAD_MULTIPLE requires an "
+                       "FI_THREAD_SAFE domain, inserting all PEs at startup");
+        shmem_transport_ofi_lazy_av = 0;
+    }
+    shmem_transport_ofi_av_npages = (info->npes + SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE - 1) /
+                                    SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE;
+
 #ifdef USE_AV_MAP
     av_attr.type = FI_AV_MAP;
-    addr_table   = (fi_addr_t*) malloc(info->npes * sizeof(fi_addr_t));
+    /* Lazy AV insertion caches addresses in shmem_transport_ofi_av_pages */
+    addr_table   = shmem_transport_ofi_lazy_av ? NULL :
+                   (fi_addr_t*) malloc(info->npes * sizeof(fi_addr_t));
 #else
     /* open Address Vector and bind the AV to the domain */
     av_attr.type = FI_AV_TABLE;
@@ -1446,6 +1954,51 @@ bool nic_already_used(struct fid_nic *nic, struct fi_info *fabrics, int num_nics
     return false;
 }
 
+/* Choose up to SHMEM_OFI_STRIPE_RAILS - 1 NICs, other than the one assigned to
+ * this PE, that are served by the same provider.  Candidates are taken in
+ * order after the primary NIC so that PEs sharing a node spread their stripes
+ * over all of the NICs. */
+static inline
+void select_stripe_rails(struct fabric_info *info, struct fi_info **provs, int num_nics)
+{
+    long want = shmem_internal_params.OFI_STRIPE_RAILS - 1;
+    int i, first = 0;
+
+    info->nrails = 0;
+
+    if (want <= 0) return;
+
+#ifdef USE_FI_HMEM
+    RAISE_WARN_STR("Striping is not supported with FI_HMEM, ignoring SHMEM_OFI_STRIPE_RAILS");
+    return;
+#endif
+
+    if (want > SHMEM_TRANSPORT_OFI_MAX_RAILS) {
+        RAISE_WARN_MSG("Limiting SHMEM_OFI_STRIPE_RAILS to %d\n", SHMEM_TRANSPORT_OFI_MAX_RAILS + 1);
+        want = SHMEM_TRANSPORT_OFI_MAX_RAILS;
+    }
+
+    for (i = 0; i < num_nics; i++) {
+        if (nic_already_used(provs[i]->nic, info->p_info, 1)) {
+            first = i;
+            break;
+        }
+    }
+
+    for (i = 1; i < num_nics && info->nrails < want; i++) {
+        struct fi_info *cur_fabric = provs[(first + i) % num_nics];
+
+        if (nic_already_used(cur_fabric->nic, info->p_info, 1) ||
+            strcmp(cur_fabric->fabric_attr->prov_name, info->p_info->fabric_attr->prov_name) != 0)
+            continue;
+
+        info->rail_info[info->nrails++] = cur_fabric;
+    }
+
+    if (info->nrails < want)
+        DEBUG_MSG("Found %d of %ld requested stripe rails\n", info->nrails + 1, want + 1);
+}
+
 static inline
 int query_for_fabric(struct fabric_info *info)
 {
@@ -1462,7 +2015,8 @@ int query_for_fabric(struct fabric_info *info)
 
     hints.caps   = FI_RMA |     /* request rma capability
                                    implies FI_READ/WRITE FI_REMOTE_READ/WRITE */
-                   FI_ATOMIC;  /* request atomics capability */
+                   shmem_transport_ofi_atomic_caps;  /* request atomics capability,
+                                                        unless emulated */
 #if ENABLE_TARGET_CNTR
     hints.caps |= FI_RMA_EVENT; /* want to use remote counters */
 #endif /* ENABLE_TARGET_CNTR */
@@ -1513,6 +2067,10 @@ int query_for_fabric(struct fabric_info *info)
 #else
     domain_attr.threading     = FI_THREAD_DOMAIN;
 #endif
+    /* The progress thread reads completion objects that are concurrently
+     * used by the application's threads */
+    if (shmem_internal_params.PROGRESS_INTERVAL > 0)
+        domain_attr.threading = FI_THREAD_SAFE;
 
     hints.domain_attr         = &domain_attr;
     ep_attr.type              = FI_EP_RDM; /* reliable connectionless */
@@ -1566,6 +2124,8 @@ int query_for_fabric(struct fabric_info *info)
 
     if (shmem_internal_params.OFI_DISABLE_MULTIRAIL) {
         info->p_info = fabrics_list_head;
+        if (shmem_internal_params.OFI_STRIPE_RAILS > 1)
+            RAISE_WARN_STR("Multirail disabled, ignoring SHMEM_OFI_STRIPE_RAILS");
     }
     else {
         /* Generate a linked list of all fabrics with a non-null nic value */
@@ -1600,6 +2160,7 @@ int query_for_fabric(struct fabric_info *info)
              * assign_nic_with_hwloc function. */
             info->p_info = prov_list[shmem_internal_my_pe % num_nics];
 #endif
+            select_stripe_rails(info, prov_list, num_nics);
             free(prov_list);
         }
     }
@@ -1635,6 +2196,9 @@ int query_for_fabric(struct fabric_info *info)
         info->p_info->domain_attr->mr_key_size = 0;
 #endif
 
+    for (int i = 0; i < info->nrails; i++)
+        info->rail_info[i]->domain_attr->mr_key_size = info->p_info->domain_attr->mr_key_size;
+
 #ifndef DISABLE_OFI_INJECT
     shmem_internal_assertp(info->p_info->tx_attr->inject_size >= shmem_transport_ofi_max_buffered_send);
     shmem_transport_ofi_max_buffered_send = info->p_info->tx_attr->inject_size;
@@ -1667,7 +2231,7 @@ static int shmem_transport_ofi_target_ep_init(void)
 
     struct fabric_info* info = &shmem_transport_ofi_info;
     info->p_info->ep_attr->tx_ctx_cnt = 0;
-    info->p_info->caps = FI_RMA | FI_ATOMIC | FI_REMOTE_READ | FI_REMOTE_WRITE;
+    info->p_info->caps = FI_RMA | shmem_transport_ofi_atomic_caps | FI_REMOTE_READ | FI_REMOTE_WRITE;
 #if ENABLE_TARGET_CNTR
     info->p_info->caps |= FI_RMA_EVENT;
 #endif
@@ -1675,7 +2239,7 @@ static int shmem_transport_ofi_target_ep_init(void)
     info->p_info->mode = 0;
     info->p_info->tx_attr->mode = 0;
     info->p_info->rx_attr->mode = 0;
-    info->p_info->tx_attr->caps = FI_RMA | FI_ATOMIC;
+    info->p_info->tx_attr->caps = FI_RMA | shmem_transport_ofi_atomic_caps;
     info->p_info->rx_attr->caps = info->p_info->caps;
 
     ret = fi_endpoint(shmem_transport_ofi_domainfd,
@@ -1705,66 +2269,615 @@ static int shmem_transport_ofi_target_ep_init(void)
     return 0;
 }
 
-static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
+/* Bind a rail's symmetric segment MR to the rail's target counter and, when
+ * required, to its target endpoint */
+static int shmem_transport_ofi_rail_mr_bind(struct shmem_transport_ofi_rail_t *rail,
+                                            struct fid_mr *mr)
 {
     int ret = 0;
+    int enable = 0;
 
-    struct fi_cntr_attr cntr_put_attr = {0};
-    struct fi_cntr_attr cntr_get_attr = {0};
-    cntr_put_attr.events   = FI_CNTR_EVENTS_COMP;
-    cntr_get_attr.events   = FI_CNTR_EVENTS_COMP;
+#if ENABLE_TARGET_CNTR
+    ret = fi_mr_bind(mr, &rail->target_cntr->fid, FI_REMOTE_WRITE);
+    OFI_CHECK_RETURN_STR(ret, "rail target CNTR binding to MR failed");
 
-    /* Set FI_WAIT based on the put and get polling limits defined above */
-    if (shmem_transport_ofi_put_poll_limit < 0) {
-        cntr_put_attr.wait_obj = FI_WAIT_NONE;
-    } else {
-        cntr_put_attr.wait_obj = FI_WAIT_UNSPEC;
-    }
-    if (shmem_transport_ofi_get_poll_limit < 0) {
-        cntr_get_attr.wait_obj = FI_WAIT_NONE;
-    } else {
-        cntr_get_attr.wait_obj = FI_WAIT_UNSPEC;
+#ifdef ENABLE_MR_RMA_EVENT
+    if (shmem_transport_ofi_mr_rma_event)
+        enable = 1;
+#endif
+#endif
+
+#ifdef ENABLE_MR_ENDPOINT
+    if (rail->info->domain_attr->mr_mode & FI_MR_ENDPOINT) {
+        ret = fi_mr_bind(mr, &rail->target_ep->fid, FI_REMOTE_WRITE);
+        OFI_CHECK_RETURN_STR(ret, "rail target EP binding to MR failed");
+        enable = 1;
     }
+#endif
 
-    /* Allow provider to choose CQ size, since we are using FI_RM_ENABLED.
-     * Context format is used to return bounce buffer pointers in the event
-     * so that they can be inserted back into to the free list. */
-    struct fi_cq_attr cq_attr = {0};
-    cq_attr.format = FI_CQ_FORMAT_CONTEXT;
+    if (enable) {
+        ret = fi_mr_enable(mr);
+        OFI_CHECK_RETURN_STR(ret, "rail MR enable failed");
+    }
 
-    struct fabric_info* info = &shmem_transport_ofi_info;
+    return ret;
+}
 
-    info->p_info->ep_attr->tx_ctx_cnt = shmem_transport_ofi_stx_max > 0 ? FI_SHARED_CONTEXT : 0;
-    info->p_info->caps = FI_RMA | FI_WRITE | FI_READ | FI_ATOMIC | FI_RECV;
-    info->p_info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
-    info->p_info->mode = 0;
-    info->p_info->tx_attr->mode = 0;
-    info->p_info->rx_attr->mode = 0;
-    info->p_info->tx_attr->caps = info->p_info->caps;
-    info->p_info->rx_attr->caps = FI_RECV; /* to drive progress on the CQ */;
+/* Open a target endpoint and register the symmetric segments on each secondary
+ * rail.  Registration mirrors the primary NIC, so that segment offsets and
+ * requested keys are the same on every rail.  Incoming writes are counted by a
+ * per-rail target counter, since counters cannot be shared across domains. */
+static int shmem_transport_ofi_rails_init(void)
+{
+    int i, ret = 0;
+    uint64_t mr_flags = 0;
+    struct fabric_info *info = &shmem_transport_ofi_info;
 
-    ctx->id = id;
-#ifdef USE_CTX_LOCK
-    SHMEM_MUTEX_INIT(ctx->lock);
+#if ENABLE_TARGET_CNTR && defined(ENABLE_MR_RMA_EVENT)
+    if (shmem_transport_ofi_mr_rma_event)
+        mr_flags |= FI_RMA_EVENT;
 #endif
 
-    ret = fi_cntr_open(shmem_transport_ofi_domainfd, &cntr_put_attr,
-                       &ctx->put_cntr, NULL);
-    OFI_CHECK_RETURN_MSG(ret, "put_cntr creation failed (%s)\n", fi_strerror(errno));
+    shmem_transport_ofi_stripe_threshold = shmem_internal_params.OFI_STRIPE_THRESHOLD;
 
-    ret = fi_cntr_open(shmem_transport_ofi_domainfd, &cntr_get_attr,
-                       &ctx->get_cntr, NULL);
-    OFI_CHECK_RETURN_MSG(ret, "get_cntr creation failed (%s)\n", fi_strerror(errno));
+    if (info->nrails == 0)
+        return 0;
 
-    ret = fi_cq_open(shmem_transport_ofi_domainfd, &cq_attr, &ctx->cq, NULL);
-    if (ret && errno == FI_EMFILE) {
-        DEBUG_STR("Context creation failed because of open files limit, consider increasing with 'ulimit' command");
+    shmem_transport_ofi_rails = calloc(info->nrails, sizeof(struct shmem_transport_ofi_rail_t));
+    if (shmem_transport_ofi_rails == NULL) {
+        RAISE_WARN_STR("Out of memory allocating stripe rails");
+        return 1;
     }
-    OFI_CHECK_RETURN_MSG(ret, "cq_open failed (%s)\n", fi_strerror(errno));
 
-    ret = fi_endpoint(shmem_transport_ofi_domainfd,
-                      info->p_info, &ctx->ep, NULL);
-    OFI_CHECK_RETURN_MSG(ret, "ep creation failed (%s)\n", fi_strerror(errno));
+    for (i = 0; i < info->nrails; i++) {
+        struct shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[i];
+        struct fi_info *rail_info = info->rail_info[i];
+        struct fi_av_attr av_attr = {0};
+        struct fi_cq_attr cq_attr = {0};
+
+        rail->info = rail_info;
+
+        ret = fi_fabric(rail_info->fabric_attr, &rail->fabric, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail fabric initialization failed");
+
+        ret = fi_domain(rail->fabric, rail_info, &rail->domain, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail domain initialization failed");
+
+#ifdef USE_AV_MAP
+        av_attr.type = FI_AV_MAP;
+        /* Lazy AV insertion keeps rail addresses in the rail peer pages */
+        if (shmem_transport_ofi_lazy_av) {
+            rail->addr_table = NULL;
+        } else {
+            rail->addr_table = (fi_addr_t*) malloc(info->npes * sizeof(fi_addr_t));
+            if (rail->addr_table == NULL) {
+                RAISE_WARN_STR("Out of memory allocating rail address table");
+                return 1;
+            }
+        }
+#else
+        av_attr.type = FI_AV_TABLE;
+        rail->addr_table = NULL;
+#endif
+
+        ret = fi_av_open(rail->domain, &av_attr, &rail->av, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail AV creation failed");
+
+        rail_info->ep_attr->tx_ctx_cnt = 0;
+        rail_info->caps = FI_RMA | shmem_transport_ofi_atomic_caps | FI_REMOTE_READ | FI_REMOTE_WRITE;
+#if ENABLE_TARGET_CNTR
+        rail_info->caps |= FI_RMA_EVENT;
+#endif
+        rail_info->tx_attr->op_flags = 0;
+        rail_info->mode = 0;
+        rail_info->tx_attr->mode = 0;
+        rail_info->rx_attr->mode = 0;
+        rail_info->tx_attr->caps = FI_RMA | shmem_transport_ofi_atomic_caps;
+        rail_info->rx_attr->caps = rail_info->caps;
+
+        ret = fi_endpoint(rail->domain, rail_info, &rail->target_ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail target endpoint creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_ep_bind(rail->target_ep, &rail->av->fid, 0);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to rail target endpoint failed");
+
+        ret = fi_cq_open(rail->domain, &cq_attr, &rail->target_cq, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail cq_open failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_ep_bind(rail->target_ep, &rail->target_cq->fid, FI_TRANSMIT | FI_RECV);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to rail target endpoint failed");
+
+#if ENABLE_TARGET_CNTR
+        {
+            struct fi_cntr_attr cntr_attr = {0};
+
+            cntr_attr.events   = FI_CNTR_EVENTS_COMP;
+            cntr_attr.wait_obj = FI_WAIT_UNSPEC;
+
+            ret = fi_cntr_open(rail->domain, &cntr_attr, &rail->target_cntr, NULL);
+            OFI_CHECK_RETURN_STR(ret, "rail target CNTR open failed");
+        }
+
+#ifdef ENABLE_MR_ENDPOINT
+        if (rail_info->domain_attr->mr_mode & FI_MR_ENDPOINT) {
+            ret = fi_ep_bind(rail->target_ep, &rail->target_cntr->fid, FI_REMOTE_WRITE);
+            OFI_CHECK_RETURN_STR(ret, "rail target CNTR binding to target EP failed");
+        }
+#endif
+#endif
+
+        ret = fi_enable(rail->target_ep);
+        OFI_CHECK_RETURN_STR(ret, "fi_enable on rail target endpoint failed");
+
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+        /* Local access lets the rail use these registrations for the source
+         * or destination buffer of a stripe */
+        ret = fi_mr_reg(rail->domain, 0, UINT64_MAX,
+                        FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 0ULL, mr_flags,
+                        &rail->mr, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail memory (all) registration failed");
+
+        ret = shmem_transport_ofi_rail_mr_bind(rail, rail->mr);
+        if (ret) return ret;
+#else
+        /* Local access lets the rail use these registrations for the source
+         * or destination buffer of a stripe */
+        ret = fi_mr_reg(rail->domain, shmem_internal_heap_base,
+                        shmem_internal_heap_length,
+                        FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 1, mr_flags,
+                        &rail->heap_mr, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail memory (heap) registration failed");
+
+        ret = fi_mr_reg(rail->domain, shmem_internal_data_base,
+                        shmem_internal_data_length,
+                        FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 0, mr_flags,
+                        &rail->data_mr, NULL);
+        OFI_CHECK_RETURN_STR(ret, "rail memory (data) registration failed");
+
+        ret = shmem_transport_ofi_rail_mr_bind(rail, rail->heap_mr);
+        if (ret) return ret;
+
+        ret = shmem_transport_ofi_rail_mr_bind(rail, rail->data_mr);
+        if (ret) return ret;
+#endif
+    }
+
+    return 0;
+}
+
+static
+int publish_rail_info(void)
+{
+    int i, ret = 0;
+    char key[32];
+    struct fabric_info *info = &shmem_transport_ofi_info;
+
+    ret = shmem_runtime_put("fi_nrails", &info->nrails, sizeof(int));
+    OFI_CHECK_RETURN_STR(ret, "shmem_runtime_put fi_nrails failed");
+
+    for (i = 0; i < info->nrails; i++) {
+        struct shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[i];
+        char epname[128];
+        size_t epnamelen = sizeof(epname);
+
+        ret = fi_getname((fid_t)rail->target_ep, epname, &epnamelen);
+        if (ret != 0 || (epnamelen > sizeof(epname))) {
+            RAISE_WARN_STR("fi_getname failed on rail");
+            return 1;
+        }
+        rail->addrlen = epnamelen;
+
+        snprintf(key, sizeof(key), "fi_epname_r%d", i);
+        ret = shmem_runtime_put(key, epname, epnamelen);
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", key);
+
+        /* Rails are enumerated locally, so peers pair them by fabric */
+        char fabric[SHMEM_TRANSPORT_OFI_RAIL_FABRIC_LEN] = {0};
+        if (rail->info->fabric_attr->name)
+            strncpy(fabric, rail->info->fabric_attr->name, sizeof(fabric) - 1);
+
+        snprintf(key, sizeof(key), "fi_fabric_r%d", i);
+        ret = shmem_runtime_put(key, fabric, sizeof(fabric));
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", key);
+
+#ifndef ENABLE_MR_SCALABLE
+        uint64_t heap_key, data_key;
+
+        if (rail->info->domain_attr->mr_mode & FI_MR_PROV_KEY) {
+            heap_key = fi_mr_key(rail->heap_mr);
+            data_key = fi_mr_key(rail->data_mr);
+        } else {
+            heap_key = 1;
+            data_key = 0;
+        }
+
+        snprintf(key, sizeof(key), "fi_heap_key_r%d", i);
+        ret = shmem_runtime_put(key, &heap_key, sizeof(uint64_t));
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", key);
+
+        snprintf(key, sizeof(key), "fi_data_key_r%d", i);
+        ret = shmem_runtime_put(key, &data_key, sizeof(uint64_t));
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", key);
+#endif
+    }
+
+    return 0;
+}
+
+/* Pair each local rail with a rail of the same fabric on every PE.  A peer's
+ * rail with the same index is preferred, and each remote rail is paired at
+ * most once.  Returns the remote rail index, or -1 if there is none. */
+static
+int pair_rail(int pe, int rail, int remote_nrails, int *used)
+{
+    char key[32];
+    char fabric[SHMEM_TRANSPORT_OFI_RAIL_FABRIC_LEN];
+    const char *name = shmem_transport_ofi_rails[rail].info->fabric_attr->name;
+    int k, match = -1;
+
+    for (k = 0; k < remote_nrails; k++) {
+        if (used[k])
+            continue;
+
+        snprintf(key, sizeof(key), "fi_fabric_r%d", k);
+        if (shmem_runtime_get(pe, key, fabric, sizeof(fabric))) {
+            RAISE_ERROR_MSG("Runtime get of '%s' failed\n", key);
+        }
+
+        if (strncmp(fabric, name ? name : "", sizeof(fabric) - 1) == 0) {
+            match = k;
+            if (k == rail) break;
+        }
+    }
+
+    if (match >= 0)
+        used[match] = 1;
+
+    return match;
+}
+
+/* Pair the stripe rails with the given PE and insert its rail addresses into
+ * the rail AVs on the first striped transfer to it.  Rails after the first
+ * one that cannot be paired are not used for this PE. */
+struct shmem_transport_ofi_rail_peer_t *shmem_transport_ofi_rail_peer_insert(int pe)
+{
+    struct shmem_transport_ofi_rail_peer_t *page, *peer;
+    size_t page_idx = pe >> SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT;
+    size_t page_off = pe & (SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE - 1);
+    int used[SHMEM_TRANSPORT_OFI_MAX_RAILS] = {0};
+    int j, k, ret, remote_nrails;
+    char key[32];
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_av_lock);
+
+    page = shmem_transport_ofi_rail_peer_pages[page_idx];
+    if (page == NULL) {
+        page = calloc(SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE, sizeof(struct shmem_transport_ofi_rail_peer_t));
+        if (page == NULL) {
+            RAISE_ERROR_STR("Out of memory allocating rail peer page");
+        }
+        __atomic_store_n(&shmem_transport_ofi_rail_peer_pages[page_idx], page, __ATOMIC_RELEASE);
+    }
+
+    peer = &page[page_off];
+
+    if (peer->nrails == 0) {
+        SHMEM_MUTEX_LOCK(shmem_internal_mutex_runtime);
+
+        ret = shmem_runtime_get(pe, "fi_nrails", &remote_nrails, sizeof(int));
+        if (ret != 0) {
+            RAISE_ERROR_MSG("Runtime get of 'fi_nrails' for PE %d failed\n", pe);
+        }
+
+        for (j = 0; j < shmem_transport_ofi_num_rails; j++) {
+            struct shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[j];
+            char epname[rail->addrlen];
+
+            k = pair_rail(pe, j, remote_nrails, used);
+            if (k < 0) break;
+
+            snprintf(key, sizeof(key), "fi_epname_r%d", k);
+            ret = shmem_runtime_get(pe, key, epname, rail->addrlen);
+            if (ret != 0) {
+                RAISE_ERROR_MSG("Runtime get of '%s' for PE %d failed\n", key, pe);
+            }
+
+            ret = fi_av_insert(rail->av, epname, 1, &peer->addr[j], 0, NULL);
+            if (ret != 1) {
+                RAISE_ERROR_MSG("Rail %d AV insert of PE %d failed (%d)\n", j, pe, ret);
+            }
+
+#ifndef ENABLE_MR_SCALABLE
+            snprintf(key, sizeof(key), "fi_heap_key_r%d", k);
+            ret = shmem_runtime_get(pe, key, &peer->heap_key[j], sizeof(uint64_t));
+            if (ret != 0) {
+                RAISE_ERROR_MSG("Runtime get of '%s' for PE %d failed\n", key, pe);
+            }
+
+            snprintf(key, sizeof(key), "fi_data_key_r%d", k);
+            ret = shmem_runtime_get(pe, key, &peer->data_key[j], sizeof(uint64_t));
+            if (ret != 0) {
+                RAISE_ERROR_MSG("Runtime get of '%s' for PE %d failed\n", key, pe);
+            }
+#endif
+        }
+
+        SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_runtime);
+
+        if (j < shmem_transport_ofi_num_rails)
+            DEBUG_MSG("Striping to PE %d over %d of %d NICs\n", pe, j + 1,
+                      shmem_transport_ofi_num_rails + 1);
+
+        __atomic_store_n(&peer->nrails, j + 1, __ATOMIC_RELEASE);
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_av_lock);
+
+    return peer;
+}
+
+static
+int populate_rails(void)
+{
+    int i, j, ret, err;
+    char key[32];
+    int nrails = shmem_transport_ofi_info.nrails;
+    int *remote_rail;
+
+    if (nrails == 0)
+        return 0;
+
+    /* With lazy AV insertion, rails are paired with each peer on the first
+     * striped transfer to it, see shmem_transport_ofi_rail_peer_insert */
+    if (shmem_transport_ofi_lazy_av) {
+        shmem_transport_ofi_rail_peer_pages = calloc(shmem_transport_ofi_av_npages,
+                                                     sizeof(struct shmem_transport_ofi_rail_peer_t *));
+        if (shmem_transport_ofi_rail_peer_pages == NULL) {
+            RAISE_WARN_STR("Out of memory allocating rail peer table");
+            return 1;
+        }
+        shmem_transport_ofi_num_rails = nrails;
+        return 0;
+    }
+
+    /* remote_rail[j * npes + i] is the rail of PE i paired with local rail j */
+    remote_rail = malloc(sizeof(int) * nrails * shmem_internal_num_pes);
+    if (remote_rail == NULL) {
+        RAISE_WARN_STR("Out of memory allocating rail pairing table");
+        return 1;
+    }
+
+    /* Only stripe across rails that can be paired on every PE, so that AV
+     * indices and keys are valid for all targets.  Rails after the first one
+     * that cannot be paired are not used. */
+    for (i = 0; i < shmem_internal_num_pes && nrails > 0; i++) {
+        int remote_nrails;
+        int used[SHMEM_TRANSPORT_OFI_MAX_RAILS] = {0};
+
+        err = shmem_runtime_get(i, "fi_nrails", &remote_nrails, sizeof(int));
+        if (err) {
+            RAISE_WARN_STR("Get of rail count from runtime KVS failed");
+            free(remote_rail);
+            return 1;
+        }
+
+        for (j = 0; j < nrails; j++) {
+            remote_rail[j * shmem_internal_num_pes + i] = pair_rail(i, j, remote_nrails, used);
+            if (remote_rail[j * shmem_internal_num_pes + i] < 0) {
+                nrails = j;
+                break;
+            }
+        }
+    }
+
+    if (nrails < shmem_transport_ofi_info.nrails)
+        DEBUG_MSG("Striping over %d of %d NICs, limited by remote PEs\n",
+                  nrails + 1, shmem_transport_ofi_info.nrails + 1);
+
+    for (j = 0; j < nrails; j++) {
+        struct shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[j];
+        int *pair = &remote_rail[j * shmem_internal_num_pes];
+        char *alladdrs = malloc(shmem_internal_num_pes * rail->addrlen);
+
+        if (alladdrs == NULL) {
+            RAISE_WARN_STR("Out of memory allocating rail 'alladdrs'");
+            free(remote_rail);
+            return 1;
+        }
+
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            snprintf(key, sizeof(key), "fi_epname_r%d", pair[i]);
+            err = shmem_runtime_get(i, key, alladdrs + i * rail->addrlen, rail->addrlen);
+            if (err != 0) {
+                RAISE_ERROR_MSG("Runtime get of '%s' failed\n", key);
+            }
+        }
+
+        ret = fi_av_insert(rail->av, alladdrs, shmem_internal_num_pes,
+                           rail->addr_table, 0, NULL);
+        free(alladdrs);
+        if (ret != shmem_internal_num_pes) {
+            RAISE_WARN_STR("rail av insert failed");
+            free(remote_rail);
+            return 1;
+        }
+
+#ifndef ENABLE_MR_SCALABLE
+        rail->heap_keys = malloc(sizeof(uint64_t) * shmem_internal_num_pes);
+        rail->data_keys = malloc(sizeof(uint64_t) * shmem_internal_num_pes);
+        if (rail->heap_keys == NULL || rail->data_keys == NULL) {
+            RAISE_WARN_STR("Out of memory allocating rail keytables");
+            free(remote_rail);
+            return 1;
+        }
+
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            snprintf(key, sizeof(key), "fi_heap_key_r%d", pair[i]);
+            err = shmem_runtime_get(i, key, &rail->heap_keys[i], sizeof(uint64_t));
+            if (err) {
+                RAISE_WARN_MSG("Get of %s from runtime KVS failed\n", key);
+                free(remote_rail);
+                return 1;
+            }
+            snprintf(key, sizeof(key), "fi_data_key_r%d", pair[i]);
+            err = shmem_runtime_get(i, key, &rail->data_keys[i], sizeof(uint64_t));
+            if (err) {
+                RAISE_WARN_MSG("Get of %s from runtime KVS failed\n", key);
+                free(remote_rail);
+                return 1;
+            }
+        }
+#endif
+    }
+
+    free(remote_rail);
+    shmem_transport_ofi_num_rails = nrails;
+
+    return 0;
+}
+
+static void shmem_transport_ofi_rails_fini(void)
+{
+    int i, ret;
+
+    for (i = 0; i < shmem_transport_ofi_info.nrails && shmem_transport_ofi_rails; i++) {
+        struct shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[i];
+
+#ifndef ENABLE_MR_SCALABLE
+        free(rail->heap_keys);
+        free(rail->data_keys);
+#endif
+
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+        if (rail->mr) {
+            ret = fi_close(&rail->mr->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail MR close failed (%s)\n", fi_strerror(errno));
+        }
+#else
+        if (rail->heap_mr) {
+            ret = fi_close(&rail->heap_mr->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail heap MR close failed (%s)\n", fi_strerror(errno));
+        }
+        if (rail->data_mr) {
+            ret = fi_close(&rail->data_mr->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail data MR close failed (%s)\n", fi_strerror(errno));
+        }
+#endif
+
+        if (rail->target_ep) {
+            ret = fi_close(&rail->target_ep->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail target endpoint close failed (%s)\n", fi_strerror(errno));
+        }
+
+        if (rail->target_cq) {
+            ret = fi_close(&rail->target_cq->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail target CQ close failed (%s)\n", fi_strerror(errno));
+        }
+
+#if ENABLE_TARGET_CNTR
+        if (rail->target_cntr) {
+            ret = fi_close(&rail->target_cntr->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail target CNTR close failed (%s)\n", fi_strerror(errno));
+        }
+#endif
+
+        if (rail->av) {
+            ret = fi_close(&rail->av->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail AV close failed (%s)\n", fi_strerror(errno));
+        }
+
+        if (rail->domain) {
+            ret = fi_close(&rail->domain->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail domain close failed (%s)\n", fi_strerror(errno));
+        }
+
+        if (rail->fabric) {
+            ret = fi_close(&rail->fabric->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Rail fabric close failed (%s)\n", fi_strerror(errno));
+        }
+
+        free(rail->addr_table);
+    }
+
+    if (shmem_transport_ofi_rail_peer_pages) {
+        for (size_t j = 0; j < shmem_transport_ofi_av_npages; j++)
+            free(shmem_transport_ofi_rail_peer_pages[j]);
+        free(shmem_transport_ofi_rail_peer_pages);
+        shmem_transport_ofi_rail_peer_pages = NULL;
+    }
+
+    free(shmem_transport_ofi_rails);
+    shmem_transport_ofi_rails = NULL;
+    shmem_transport_ofi_num_rails = 0;
+}
+
+static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
+{
+    int ret = 0;
+
+    struct fi_cntr_attr cntr_put_attr = {0};
+    struct fi_cntr_attr cntr_get_attr = {0};
+    cntr_put_attr.events   = FI_CNTR_EVENTS_COMP;
+    cntr_get_attr.events   = FI_CNTR_EVENTS_COMP;
+
+    /* Set FI_WAIT based on the wait policy and the put and get polling
+     * limits defined above */
+    if (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_SPIN ||
+        (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_AUTO &&
+         shmem_transport_ofi_put_poll_limit < 0)) {
+        cntr_put_attr.wait_obj = FI_WAIT_NONE;
+    } else {
+        cntr_put_attr.wait_obj = FI_WAIT_UNSPEC;
+    }
+    if (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_SPIN ||
+        (shmem_internal_wait_policy == SHMEM_INTERNAL_WAIT_POLICY_AUTO &&
+         shmem_transport_ofi_get_poll_limit < 0)) {
+        cntr_get_attr.wait_obj = FI_WAIT_NONE;
+    } else {
+        cntr_get_attr.wait_obj = FI_WAIT_UNSPEC;
+    }
+
+    /* Allow provider to choose CQ size, since we are using FI_RM_ENABLED.
+     * Context format is used to return bounce buffer pointers in the event
+     * so that they can be inserted back into to the free list. */
+    struct fi_cq_attr cq_attr = {0};
+    cq_attr.format = FI_CQ_FORMAT_CONTEXT;
+
+    struct fabric_info* info = &shmem_transport_ofi_info;
+
+    info->p_info->ep_attr->tx_ctx_cnt = shmem_transport_ofi_stx_max > 0 ? FI_SHARED_CONTEXT : 0;
+    info->p_info->caps = FI_RMA | FI_WRITE | FI_READ | shmem_transport_ofi_atomic_caps | FI_RECV;
+    info->p_info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
+    info->p_info->mode = 0;
+    info->p_info->tx_attr->mode = 0;
+    info->p_info->rx_attr->mode = 0;
+    info->p_info->tx_attr->caps = info->p_info->caps;
+    info->p_info->rx_attr->caps = FI_RECV; /* to drive progress on the CQ */;
+
+    ctx->id = id;
+#ifdef USE_CTX_LOCK
+    SHMEM_MUTEX_INIT(ctx->lock);
+#endif
+    shmem_internal_wait_state_init(&ctx->put_wait_state);
+    shmem_internal_wait_state_init(&ctx->get_wait_state);
+
+    ret = fi_cntr_open(shmem_transport_ofi_domainfd, &cntr_put_attr,
+                       &ctx->put_cntr, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "put_cntr creation failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_cntr_open(shmem_transport_ofi_domainfd, &cntr_get_attr,
+                       &ctx->get_cntr, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "get_cntr creation failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_cq_open(shmem_transport_ofi_domainfd, &cq_attr, &ctx->cq, NULL);
+    if (ret && errno == FI_EMFILE) {
+        DEBUG_STR("Context creation failed because of open files limit, consider increasing with 'ulimit' command");
+    }
+    OFI_CHECK_RETURN_MSG(ret, "cq_open failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_endpoint(shmem_transport_ofi_domainfd,
+                      info->p_info, &ctx->ep, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "ep creation failed (%s)\n", fi_strerror(errno));
 
     /* TODO: Fill in TX attr */
 
@@ -1778,6 +2891,12 @@ static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
     ret = bind_enable_ep_resources(ctx);
     OFI_CHECK_RETURN_MSG(ret, "context bind/enable endpoint failed (%s)\n", fi_strerror(errno));
 
+    ret = ctx_shards_init(ctx, &cntr_put_attr, &cntr_get_attr);
+    OFI_CHECK_RETURN_STR(ret, "context shard endpoint creation failed");
+
+    ret = ctx_rails_init(ctx);
+    OFI_CHECK_RETURN_STR(ret, "context rail endpoint creation failed");
+
     if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER &&
         shmem_transport_ofi_bounce_buffer_size > 0 &&
         shmem_transport_ofi_max_bounce_buffers > 0)
@@ -1796,6 +2915,335 @@ static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
 }
 
 
+/* Registration cache.  All functions below expect the cache lock to be held,
+ * unless otherwise noted. */
+
+static void shmem_transport_ofi_mr_cache_update(size_t idx)
+{
+    for (size_t i = idx; i < shmem_transport_ofi_mr_cache_cnt; i++) {
+        uint8_t *end = shmem_transport_ofi_mr_cache[i]->end;
+
+        if (i > 0 && shmem_transport_ofi_mr_cache_max_end[i-1] > end)
+            end = shmem_transport_ofi_mr_cache_max_end[i-1];
+        shmem_transport_ofi_mr_cache_max_end[i] = end;
+    }
+}
+
+/* Index of the first entry whose start address is greater than addr */
+static size_t shmem_transport_ofi_mr_cache_upper(const uint8_t *addr)
+{
+    size_t lo = 0, hi = shmem_transport_ofi_mr_cache_cnt;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (shmem_transport_ofi_mr_cache[mid]->start <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static shmem_transport_ofi_mr_cache_entry_t *
+shmem_transport_ofi_mr_cache_find(const uint8_t *start, const uint8_t *end)
+{
+    size_t i = shmem_transport_ofi_mr_cache_upper(start);
+
+    /* Walk left over entries that start at or below start, stopping once no
+     * remaining entry can reach end */
+    while (i > 0 && shmem_transport_ofi_mr_cache_max_end[i-1] >= end) {
+        shmem_transport_ofi_mr_cache_entry_t *e = shmem_transport_ofi_mr_cache[--i];
+
+        if (e->end >= end && !e->invalid)
+            return e;
+    }
+
+    return NULL;
+}
+
+static void shmem_transport_ofi_mr_cache_remove(size_t idx)
+{
+    shmem_transport_ofi_mr_cache_entry_t *e = shmem_transport_ofi_mr_cache[idx];
+    int ret;
+
+    for (int i = 0; i < shmem_transport_ofi_num_rails; i++) {
+        ret = fi_close(&e->rail_mr[i]->fid);
+        OFI_CHECK_ERROR_MSG(ret, "Cached rail MR close failed (%s)\n", fi_strerror(errno));
+    }
+
+    ret = fi_close(&e->mr->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Cached MR close failed (%s)\n", fi_strerror(errno));
+    free(e);
+
+    shmem_transport_ofi_mr_cache_cnt--;
+    memmove(&shmem_transport_ofi_mr_cache[idx], &shmem_transport_ofi_mr_cache[idx+1],
+            (shmem_transport_ofi_mr_cache_cnt - idx) * sizeof(shmem_transport_ofi_mr_cache_entry_t *));
+    shmem_transport_ofi_mr_cache_update(idx);
+}
+
+static shmem_transport_ofi_mr_cache_entry_t *
+shmem_transport_ofi_mr_cache_insert(const void *buf, size_t len)
+{
+    shmem_transport_ofi_mr_cache_entry_t *e;
+    uintptr_t page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+    uint8_t *start = (uint8_t *) ((uintptr_t) buf & ~(page_size - 1));
+    uint8_t *end = (uint8_t *) (((uintptr_t) buf + len + page_size - 1) & ~(page_size - 1));
+    size_t idx;
+    int ret;
+
+    if (shmem_transport_ofi_mr_cache_cnt == shmem_transport_ofi_mr_cache_len) {
+        size_t new_len = shmem_transport_ofi_mr_cache_len ? 2 * shmem_transport_ofi_mr_cache_len : 16;
+        void *cache, *max_end;
+
+        cache = realloc(shmem_transport_ofi_mr_cache,
+                        new_len * sizeof(shmem_transport_ofi_mr_cache_entry_t *));
+        if (cache == NULL) return NULL;
+        shmem_transport_ofi_mr_cache = cache;
+
+        max_end = realloc(shmem_transport_ofi_mr_cache_max_end, new_len * sizeof(uint8_t *));
+        if (max_end == NULL) return NULL;
+        shmem_transport_ofi_mr_cache_max_end = max_end;
+
+        shmem_transport_ofi_mr_cache_len = new_len;
+    }
+
+    e = calloc(1, sizeof(shmem_transport_ofi_mr_cache_entry_t) +
+                  shmem_transport_ofi_num_rails * sizeof(struct fid_mr *));
+    if (e == NULL) return NULL;
+
+    /* Keys below the cache base are used by the symmetric data, heap,
+     * external heap, and spaces */
+    ret = fi_mr_reg(shmem_transport_ofi_domainfd, start, end - start,
+                    FI_READ | FI_WRITE, 0, shmem_transport_ofi_mr_cache_key++, 0,
+                    &e->mr, NULL);
+    if (ret) {
+        DEBUG_MSG("Registration cache fi_mr_reg failed for %p (%zu bytes): %s\n",
+                  (void *) start, (size_t) (end - start), fi_strerror(-ret));
+        free(e);
+        return NULL;
+    }
+
+    /* Striped transfers use the same range on the secondary rails */
+    for (int i = 0; i < shmem_transport_ofi_num_rails; i++) {
+        ret = fi_mr_reg(shmem_transport_ofi_rails[i].domain, start, end - start,
+                        FI_READ | FI_WRITE, 0, shmem_transport_ofi_mr_cache_key - 1, 0,
+                        &e->rail_mr[i], NULL);
+        if (ret) {
+            DEBUG_MSG("Registration cache fi_mr_reg failed on rail %d for %p (%zu bytes): %s\n",
+                      i, (void *) start, (size_t) (end - start), fi_strerror(-ret));
+            while (i-- > 0)
+                fi_close(&e->rail_mr[i]->fid);
+            fi_close(&e->mr->fid);
+            free(e);
+            return NULL;
+        }
+    }
+
+    e->start  = start;
+    e->end    = end;
+    e->desc   = fi_mr_desc(e->mr);
+
+    idx = shmem_transport_ofi_mr_cache_upper(start);
+    memmove(&shmem_transport_ofi_mr_cache[idx+1], &shmem_transport_ofi_mr_cache[idx],
+            (shmem_transport_ofi_mr_cache_cnt - idx) * sizeof(shmem_transport_ofi_mr_cache_entry_t *));
+    shmem_transport_ofi_mr_cache[idx] = e;
+    shmem_transport_ofi_mr_cache_cnt++;
+    shmem_transport_ofi_mr_cache_update(idx);
+
+    return e;
+}
+
+/* Takes the cache lock.  The entry must be handed back with
+ * shmem_transport_ofi_mr_cache_release once the operation has been issued. */
+shmem_transport_ofi_mr_cache_entry_t *shmem_transport_ofi_mr_cache_lookup(const void *buf, size_t len)
+{
+    shmem_transport_ofi_mr_cache_entry_t *e;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_mr_cache_lock);
+
+    e = shmem_transport_ofi_mr_cache_find((const uint8_t *) buf, (const uint8_t *) buf + len);
+    if (e)
+        e->busy++;
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_mr_cache_lock);
+
+    return e;
+}
+
+/* Takes the cache lock */
+void shmem_transport_ofi_mr_cache_release(shmem_transport_ofi_mr_cache_entry_t *e)
+{
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_mr_cache_lock);
+
+    if (--e->busy == 0 && e->invalid) {
+        size_t i = shmem_transport_ofi_mr_cache_upper(e->start);
+
+        while (shmem_transport_ofi_mr_cache[--i] != e)
+            ;
+        shmem_transport_ofi_mr_cache_remove(i);
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_mr_cache_lock);
+}
+
+static void shmem_transport_ofi_mr_cache_fini(void)
+{
+    if (shmem_transport_ofi_mr_cache_mode == SHMEM_TRANSPORT_OFI_MR_CACHE_OFF)
+        return;
+
+    DEBUG_MSG("Registration cache holds %zu entries at finalize\n",
+              shmem_transport_ofi_mr_cache_cnt);
+
+    while (shmem_transport_ofi_mr_cache_cnt > 0)
+        shmem_transport_ofi_mr_cache_remove(shmem_transport_ofi_mr_cache_cnt - 1);
+
+    free(shmem_transport_ofi_mr_cache);
+    free(shmem_transport_ofi_mr_cache_max_end);
+    SHMEM_MUTEX_DESTROY(shmem_transport_ofi_mr_cache_lock);
+}
+
+int shmem_transport_register_buffer(const void *addr, size_t len)
+{
+    shmem_transport_ofi_mr_cache_entry_t *e;
+    int ret = 0;
+
+    if (shmem_transport_ofi_mr_cache_mode == SHMEM_TRANSPORT_OFI_MR_CACHE_OFF || len == 0 ||
+        shmem_transport_ofi_get_mr_desc_index(addr) >= 0)
+        return 0;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_mr_cache_lock);
+
+    e = shmem_transport_ofi_mr_cache_find((const uint8_t *) addr, (const uint8_t *) addr + len);
+    if (e == NULL && NULL == shmem_transport_ofi_mr_cache_insert(addr, len))
+        ret = 1;
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_mr_cache_lock);
+
+    return ret;
+}
+
+int shmem_transport_unregister_buffer(const void *addr, size_t len)
+{
+    const uint8_t *start = (const uint8_t *) addr;
+    const uint8_t *end = start + len;
+    size_t i;
+
+    if (shmem_transport_ofi_mr_cache_mode == SHMEM_TRANSPORT_OFI_MR_CACHE_OFF || len == 0)
+        return 0;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_mr_cache_lock);
+
+    /* Drop every entry overlapping the range.  Entries in use by another
+     * thread are closed when that thread releases them. */
+    for (i = shmem_transport_ofi_mr_cache_upper(end - 1); i > 0; i--) {
+        shmem_transport_ofi_mr_cache_entry_t *e = shmem_transport_ofi_mr_cache[i-1];
+
+        if (shmem_transport_ofi_mr_cache_max_end[i-1] <= start)
+            break;
+        if (e->end <= start)
+            continue;
+
+        if (e->busy)
+            e->invalid = 1;
+        else
+            shmem_transport_ofi_mr_cache_remove(i-1);
+    }
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_mr_cache_lock);
+
+    return 0;
+}
+
+int shmem_transport_space_register(shmem_internal_space_t *space, int id)
+{
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    /* Already covered by the all-memory MR */
+    space->mr   = NULL;
+    space->key  = 0;
+    space->addr = space->base;
+
+    return 0;
+#else
+    struct fid_mr *mr;
+    uint64_t key = SHMEM_TRANSPORT_OFI_SPACE_MR_BASE + id;
+    uint64_t flags = 0;
+    uint64_t mr_mode = shmem_transport_ofi_info.p_info->domain_attr->mr_mode;
+    int ret;
+#if ENABLE_TARGET_CNTR
+    int enable = 0;
+#endif
+
+    shmem_internal_assert(key < SHMEM_TRANSPORT_OFI_MR_CACHE_KEY_BASE);
+
+#if ENABLE_TARGET_CNTR && defined(ENABLE_MR_RMA_EVENT)
+    if (shmem_transport_ofi_mr_rma_event) {
+        flags |= FI_RMA_EVENT;
+        enable = 1;
+    }
+#endif
+
+    ret = fi_mr_reg(shmem_transport_ofi_domainfd, space->base, space->length,
+                    FI_REMOTE_READ | FI_REMOTE_WRITE, 0, key, flags, &mr, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "target memory (space %d) registration failed (%s)\n",
+                         id, fi_strerror(ret));
+
+#if ENABLE_TARGET_CNTR
+    ret = fi_mr_bind(mr, &shmem_transport_ofi_target_cntrfd->fid, FI_REMOTE_WRITE);
+    if (ret) {
+        RAISE_WARN_MSG("target CNTR binding to space %d MR failed\n", id);
+        goto err;
+    }
+
+#ifdef ENABLE_MR_ENDPOINT
+    if (mr_mode & FI_MR_ENDPOINT) {
+        ret = fi_mr_bind(mr, &shmem_transport_ofi_target_ep->fid, FI_REMOTE_WRITE);
+        if (ret) {
+            RAISE_WARN_MSG("target EP binding to space %d MR failed\n", id);
+            goto err;
+        }
+        enable = 1;
+    }
+#endif
+
+    if (enable) {
+        ret = fi_mr_enable(mr);
+        if (ret) {
+            RAISE_WARN_MSG("target space %d MR enable failed\n", id);
+            goto err;
+        }
+    }
+#endif /* ENABLE_TARGET_CNTR */
+
+    space->mr   = mr;
+    space->key  = (mr_mode & FI_MR_PROV_KEY) ? fi_mr_key(mr) : key;
+    space->addr = (mr_mode & FI_MR_VIRT_ADDR) ? (uint8_t *) space->base : NULL;
+    shmem_transport_ofi_mrfd_list[SHMEM_TRANSPORT_OFI_SPACE_MR_BASE + id] = mr;
+
+    return 0;
+
+#if ENABLE_TARGET_CNTR
+ err:
+    fi_close(&mr->fid);
+    return ret;
+#endif
+#endif
+}
+
+void shmem_transport_space_unregister(shmem_internal_space_t *space, int id)
+{
+    int ret;
+
+    if (NULL == space->mr) return;
+
+    ret = fi_close(&((struct fid_mr *) space->mr)->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Space %d MR close failed (%s)\n", id, fi_strerror(errno));
+
+    shmem_transport_ofi_mrfd_list[SHMEM_TRANSPORT_OFI_SPACE_MR_BASE + id] = NULL;
+    space->mr = NULL;
+}
+
 int shmem_transport_init(void)
 {
     int ret = 0;
@@ -1838,7 +3286,27 @@ int shmem_transport_init(void)
         }
         shmem_transport_ofi_stx_max = shmem_internal_params.OFI_STX_MAX;
     }
-    shmem_transport_ofi_stx_threshold = shmem_internal_params.OFI_STX_THRESHOLD;
+    shmem_transport_ofi_stx_threshold = shmem_internal_params.OFI_STX_THRESHOLD;
+
+    char *amo_emulation = shmem_internal_params.OFI_ATOMIC_EMULATION;
+    if (0 == strcmp(amo_emulation, "on")) {
+        shmem_transport_ofi_amo_mode = SHMEM_TRANSPORT_OFI_AMO_EMULATION_ON;
+        /* Native atomics are never used, so do not require them */
+        shmem_transport_ofi_atomic_caps = 0;
+    } else if (0 == strcmp(amo_emulation, "off")) {
+        shmem_transport_ofi_amo_mode = SHMEM_TRANSPORT_OFI_AMO_EMULATION_OFF;
+    } else if (0 != strcmp(amo_emulation, "auto")) {
+        RAISE_WARN_MSG("Ignoring bad atomic emulation mode '%s', using 'auto'\n", amo_emulation);
+    }
+
+#ifndef ENABLE_THREADS
+    /* The progress thread shares transport state with the application, which
+     * is only protected when thread support is enabled */
+    if (shmem_internal_params.PROGRESS_INTERVAL > 0) {
+        RAISE_WARN_STR("Progress thread requires thread support, ignoring SHMEM_PROGRESS_INTERVAL");
+        shmem_internal_params.PROGRESS_INTERVAL = 0;
+    }
+#endif
 
     ret = query_for_fabric(&shmem_transport_ofi_info);
     if (ret != 0) return ret;
@@ -1853,11 +3321,52 @@ int shmem_transport_init(void)
     } else if (0 == strcmp(type, "random")) {
         shmem_transport_ofi_stx_allocator = RANDOM;
         shmem_transport_ofi_stx_rand_init();
+    } else if (0 == strcmp(type, "numa")) {
+        shmem_transport_ofi_stx_allocator = NUMA;
+#ifndef USE_HWLOC
+        DEBUG_STR("NUMA STX allocator requires hwloc; STXs will not be grouped");
+#endif
     } else {
         RAISE_WARN_MSG("Ignoring bad STX share algorithm '%s', using 'round-robin'\n", type);
         shmem_transport_ofi_stx_allocator = ROUNDROBIN;
     }
 
+    char *mr_cache = shmem_internal_params.OFI_MR_CACHE;
+    if (0 == strcmp(mr_cache, "hint")) {
+        shmem_transport_ofi_mr_cache_mode = SHMEM_TRANSPORT_OFI_MR_CACHE_HINT;
+    } else if (0 != strcmp(mr_cache, "off")) {
+        RAISE_WARN_MSG("Ignoring bad registration cache mode '%s', using 'off'\n", mr_cache);
+    }
+#ifdef ENABLE_MR_ENDPOINT
+    /* Cached registrations would need to be bound to every endpoint */
+    if (shmem_transport_ofi_mr_cache_mode != SHMEM_TRANSPORT_OFI_MR_CACHE_OFF &&
+        shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_ENDPOINT) {
+        DEBUG_STR("Registration cache is not supported with FI_MR_ENDPOINT; disabling");
+        shmem_transport_ofi_mr_cache_mode = SHMEM_TRANSPORT_OFI_MR_CACHE_OFF;
+    }
+#endif
+    if (shmem_transport_ofi_mr_cache_mode != SHMEM_TRANSPORT_OFI_MR_CACHE_OFF) {
+        SHMEM_MUTEX_INIT(shmem_transport_ofi_mr_cache_lock);
+        shmem_transport_ofi_mr_cache_threshold = shmem_internal_params.OFI_MR_CACHE_THRESHOLD;
+        shmem_transport_ofi_mr_cache_key = SHMEM_TRANSPORT_OFI_MR_CACHE_KEY_BASE;
+    }
+
+    if (shmem_internal_params.OFI_QUIET_SHARDS > 1) {
+        shmem_transport_ofi_num_shards = shmem_internal_params.OFI_QUIET_SHARDS;
+    } else if (shmem_internal_params.OFI_QUIET_SHARDS < 1) {
+        RAISE_WARN_MSG("Ignoring bad quiet shard count '%ld', using 1\n",
+                       shmem_internal_params.OFI_QUIET_SHARDS);
+    }
+
+#ifdef ENABLE_THREADS
+    char *thread_ctx = shmem_internal_params.THREAD_DEFAULT_CTX;
+    if (0 == strcmp(thread_ctx, "per_thread")) {
+        if (shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE)
+            shmem_transport_ofi_thread_default_ctx = 1;
+    } else if (0 != strcmp(thread_ctx, "shared")) {
+        RAISE_WARN_MSG("Ignoring bad default context mapping '%s', using 'shared'\n", thread_ctx);
+    }
+#endif
 
     /* The current bounce buffering implementation is only compatible with
      * providers that don't require FI_CONTEXT or FI_CONTEXT2 */
@@ -1892,15 +3401,324 @@ int shmem_transport_init(void)
     ret = shmem_transport_ofi_target_ep_init();
     if (ret != 0) return ret;
 
+    ret = shmem_transport_ofi_rails_init();
+    if (ret != 0) return ret;
+
     ret = publish_mr_info();
     if (ret != 0) return ret;
 
     ret = publish_av_info(&shmem_transport_ofi_info);
     if (ret != 0) return ret;
 
+    ret = publish_rail_info();
+    if (ret != 0) return ret;
+
+    return 0;
+}
+
+#define SHMEM_TRANSPORT_OFI_AMO_INT_OPS                                         \
+                case FI_BAND:  new_v = old_v & op_v; break;                     \
+                case FI_BOR:   new_v = old_v | op_v; break;                     \
+                case FI_BXOR:  new_v = old_v ^ op_v; break;                     \
+                case FI_MSWAP: new_v = (op_v & cmp_v) | (old_v & ~cmp_v); break;
+
+/* Apply one request with a compare-and-swap loop, so that it is also atomic
+ * with respect to shared memory atomics issued by PEs on this node */
+#define SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_TYPE, TYPE, UTYPE, INT_OPS)            \
+    case FI_TYPE: {                                                             \
+        UTYPE *p = (UTYPE *) ptr;                                               \
+        UTYPE cur = __atomic_load_n(p, __ATOMIC_ACQUIRE), next;                 \
+        TYPE old_v, new_v, op_v, cmp_v;                                         \
+        memcpy(&op_v, req->operand, sizeof(TYPE));                              \
+        memcpy(&cmp_v, req->compare, sizeof(TYPE));                             \
+        do {                                                                    \
+            memcpy(&old_v, &cur, sizeof(TYPE));                                 \
+            new_v = old_v;                                                      \
+            switch (req->op) {                                                  \
+                case FI_SUM:          new_v = old_v + op_v; break;              \
+                case FI_PROD:         new_v = old_v * op_v; break;              \
+                case FI_MIN:          new_v = op_v < old_v ? op_v : old_v; break; \
+                case FI_MAX:          new_v = op_v > old_v ? op_v : old_v; break; \
+                case FI_ATOMIC_WRITE: new_v = op_v; break;                      \
+                case FI_ATOMIC_READ:  break;                                    \
+                case FI_CSWAP:        if (old_v == cmp_v) new_v = op_v; break;  \
+                INT_OPS                                                         \
+                default:                                                        \
+                    RAISE_ERROR_MSG("Emulated atomic op %d not supported on type %d\n", \
+                                    req->op, req->datatype);                    \
+            }                                                                   \
+            memcpy(&next, &new_v, sizeof(TYPE));                                \
+        } while (!__atomic_compare_exchange_n(p, &cur, next, 0, __ATOMIC_ACQ_REL, \
+                                              __ATOMIC_ACQUIRE));               \
+        memcpy(result, &old_v, sizeof(TYPE));                                   \
+        break;                                                                  \
+    }
+
+static void shmem_transport_ofi_amo_apply(const shmem_transport_ofi_amo_req_t *req,
+                                          void *result)
+{
+    void *ptr = (req->seg == 0 ? (uint8_t *) shmem_internal_data_base :
+                 req->seg == 1 ? (uint8_t *) shmem_internal_heap_base :
+                 (uint8_t *) shmem_internal_spaces[req->seg - 2].base) + req->offset;
+
+    switch (req->datatype) {
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_INT32,  int32_t,  uint32_t, SHMEM_TRANSPORT_OFI_AMO_INT_OPS)
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_UINT32, uint32_t, uint32_t, SHMEM_TRANSPORT_OFI_AMO_INT_OPS)
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_INT64,  int64_t,  uint64_t, SHMEM_TRANSPORT_OFI_AMO_INT_OPS)
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_UINT64, uint64_t, uint64_t, SHMEM_TRANSPORT_OFI_AMO_INT_OPS)
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_FLOAT,  float,    uint32_t, )
+        SHMEM_TRANSPORT_OFI_AMO_APPLY(FI_DOUBLE, double,   uint64_t, )
+        default:
+            RAISE_ERROR_MSG("Emulated atomics not supported on type %d\n", req->datatype);
+    }
+}
+
+#undef SHMEM_TRANSPORT_OFI_AMO_APPLY
+#undef SHMEM_TRANSPORT_OFI_AMO_INT_OPS
+
+/* Apply newly posted requests; expects shmem_transport_ofi_amo_lock */
+static void shmem_transport_ofi_amo_service_locked(void)
+{
+    shmem_transport_ofi_amo_rep_t *rep = &shmem_transport_ofi_amo_rep[shmem_internal_my_pe];
+    uint8_t result[sizeof(rep->result)];
+    int i;
+
+#if ENABLE_TARGET_CNTR
+    /* Requests arrive as RMA writes; skip the scan if none have landed */
+    uint64_t cnt = shmem_transport_ofi_target_cntr_read();
+    if (cnt == shmem_transport_ofi_amo_target_cnt)
+        return;
+    shmem_transport_ofi_amo_target_cnt = cnt;
+#endif
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        shmem_transport_ofi_amo_req_t *req = &shmem_transport_ofi_amo_req[i];
+        uint64_t seq = __atomic_load_n(&req->seq, __ATOMIC_ACQUIRE);
+
+        if (seq == shmem_transport_ofi_amo_done[i])
+            continue;
+
+        shmem_transport_ofi_amo_apply(req, result);
+        shmem_transport_ofi_amo_done[i] = seq;
+
+        /* Return the prior value, then release the source */
+        shmem_transport_put_nbi(shmem_transport_ofi_amo_ctx, rep->result, result,
+                                sizeof(result), i);
+        shmem_transport_put_quiet(shmem_transport_ofi_amo_ctx);
+        shmem_transport_put_nbi(shmem_transport_ofi_amo_ctx, &rep->seq, &seq,
+                                sizeof(uint64_t), i);
+        shmem_transport_put_quiet(shmem_transport_ofi_amo_ctx);
+    }
+}
+
+void shmem_transport_ofi_amo_service(void)
+{
+    if (0 == pthread_mutex_trylock(&shmem_transport_ofi_amo_lock)) {
+        shmem_transport_ofi_amo_service_locked();
+        pthread_mutex_unlock(&shmem_transport_ofi_amo_lock);
+    }
+}
+
+void shmem_transport_ofi_amo_emulate(shmem_transport_ctx_t *ctx, void *target,
+                                     const void *source, void *dest,
+                                     const void *operand, size_t len, int pe,
+                                     int op, int datatype)
+{
+    shmem_transport_ofi_amo_req_t req;
+    shmem_transport_ofi_amo_rep_t *rep = &shmem_transport_ofi_amo_rep[pe];
+    uint64_t seq;
+    int space;
+
+    shmem_internal_assert(len <= sizeof(req.operand));
+
+    memset(&req, 0, sizeof(req));
+
+    if ((void *) target >= shmem_internal_data_base &&
+        (uint8_t *) target < (uint8_t *) shmem_internal_data_base + shmem_internal_data_length) {
+        req.seg = 0;
+        req.offset = (uint8_t *) target - (uint8_t *) shmem_internal_data_base;
+    } else if ((void *) target >= shmem_internal_heap_base &&
+               (uint8_t *) target < (uint8_t *) shmem_internal_heap_base + shmem_internal_heap_length) {
+        req.seg = 1;
+        req.offset = (uint8_t *) target - (uint8_t *) shmem_internal_heap_base;
+    } else if ((space = shmem_internal_space_index(target)) >= 0) {
+        req.seg = 2 + space;
+        req.offset = (uint8_t *) target - (uint8_t *) shmem_internal_spaces[space].base;
+    } else {
+        RAISE_ERROR_MSG("address (%p) outside of symmetric areas\n", target);
+    }
+
+    req.op = op;
+    req.datatype = SHMEM_TRANSPORT_DTYPE(datatype);
+    if (source) memcpy(req.operand, source, len);
+    if (operand) memcpy(req.compare, operand, len);
+
+    /* Requests are carried on the engine's context; complete the caller's
+     * prior operations to pe so that fence ordering still holds */
+    shmem_transport_quiet_pe(ctx, pe);
+
+    pthread_mutex_lock(&shmem_transport_ofi_amo_lock);
+
+    if (pe == shmem_internal_my_pe) {
+        uint8_t result[sizeof(rep->result)];
+
+        shmem_transport_ofi_amo_apply(&req, result);
+        pthread_mutex_unlock(&shmem_transport_ofi_amo_lock);
+
+        if (dest) memcpy(dest, result, len);
+        return;
+    }
+
+    seq = ++shmem_transport_ofi_amo_seq[pe];
+
+    /* The body must be visible at the target before the sequence number */
+    shmem_transport_put_nbi(shmem_transport_ofi_amo_ctx,
+                            &shmem_transport_ofi_amo_req[shmem_internal_my_pe], &req,
+                            offsetof(shmem_transport_ofi_amo_req_t, seq), pe);
+    shmem_transport_put_quiet(shmem_transport_ofi_amo_ctx);
+    shmem_transport_put_nbi(shmem_transport_ofi_amo_ctx,
+                            &shmem_transport_ofi_amo_req[shmem_internal_my_pe].seq, &seq,
+                            sizeof(uint64_t), pe);
+    shmem_transport_put_quiet(shmem_transport_ofi_amo_ctx);
+
+    /* Keep serving other PEs while waiting, since they may in turn be
+     * waiting on this PE */
+    while (__atomic_load_n(&rep->seq, __ATOMIC_ACQUIRE) != seq) {
+        shmem_transport_ofi_amo_service_locked();
+        shmem_transport_probe();
+        SPINLOCK_BODY();
+    }
+
+    if (dest) memcpy(dest, rep->result, len);
+
+    pthread_mutex_unlock(&shmem_transport_ofi_amo_lock);
+}
+
+static int shmem_transport_ofi_amo_init(void)
+{
+    int ret;
+    size_t npes = shmem_internal_num_pes;
+
+    shmem_transport_ctx_t *ctxp = malloc(sizeof(shmem_transport_ctx_t));
+
+    if (ctxp == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI atomics engine ctx");
+    }
+
+    memset(ctxp, 0, sizeof(shmem_transport_ctx_t));
+
+#ifndef USE_CTX_LOCK
+    shmem_internal_cntr_write(&ctxp->pending_put_cntr, 0);
+    shmem_internal_cntr_write(&ctxp->pending_get_cntr, 0);
+#endif
+
+    /* Serialized by shmem_transport_ofi_amo_lock */
+    ctxp->stx_idx = -1;
+    ctxp->options = SHMEM_CTX_SERIALIZED;
+    ctxp->team = &shmem_internal_team_world;
+
+    ret = shmem_transport_ofi_ctx_init(ctxp, SHMEM_TRANSPORT_CTX_AMO_ID);
+    if (ret) {
+        shmem_transport_ctx_destroy(ctxp);
+        return ret;
+    }
+    shmem_transport_ofi_amo_ctx = ctxp;
+
+    /* Every PE allocates the slots at the same point during startup, so they
+     * are symmetric */
+    shmem_transport_ofi_amo_req = shmem_internal_shmalloc(npes * sizeof(shmem_transport_ofi_amo_req_t));
+    shmem_transport_ofi_amo_rep = shmem_internal_shmalloc(npes * sizeof(shmem_transport_ofi_amo_rep_t));
+    shmem_transport_ofi_amo_seq = calloc(npes, sizeof(uint64_t));
+    shmem_transport_ofi_amo_done = calloc(npes, sizeof(uint64_t));
+
+    if (shmem_transport_ofi_amo_req == NULL || shmem_transport_ofi_amo_rep == NULL ||
+        shmem_transport_ofi_amo_seq == NULL || shmem_transport_ofi_amo_done == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI atomics engine buffers");
+    }
+
+    memset(shmem_transport_ofi_amo_req, 0, npes * sizeof(shmem_transport_ofi_amo_req_t));
+    memset(shmem_transport_ofi_amo_rep, 0, npes * sizeof(shmem_transport_ofi_amo_rep_t));
+
+    shmem_transport_ofi_amo_emulated = 1;
+
     return 0;
 }
 
+static void shmem_transport_ofi_amo_fini(void)
+{
+    if (shmem_transport_ofi_amo_ctx == NULL)
+        return;
+
+    shmem_transport_ofi_amo_emulated = 0;
+
+    shmem_transport_quiet(shmem_transport_ofi_amo_ctx);
+    shmem_transport_ctx_destroy(shmem_transport_ofi_amo_ctx);
+    shmem_transport_ofi_amo_ctx = NULL;
+
+    shmem_internal_free(shmem_transport_ofi_amo_req);
+    shmem_internal_free(shmem_transport_ofi_amo_rep);
+    shmem_transport_ofi_amo_req = NULL;
+    shmem_transport_ofi_amo_rep = NULL;
+
+    free(shmem_transport_ofi_amo_seq);
+    free(shmem_transport_ofi_amo_done);
+}
+
+/* Asynchronous progress for providers that only make progress when their
+ * completion objects are polled.  The target endpoint is polled under the
+ * progress lock, so the thread does not contend with shmem_transport_probe
+ * in FI_THREAD_COMPLETION builds; reading the default context's counters
+ * progresses its outstanding operations. */
+#ifdef ENABLE_THREADS
+static void *shmem_transport_ofi_progress_thread_func(void *arg)
+{
+    struct fi_cq_entry buf;
+    long cpu = shmem_internal_params.PROGRESS_THREAD_CPU;
+    /* usleep() may reject intervals of a second or more, so use nanosleep() */
+    const struct timespec interval = {
+        .tv_sec  = shmem_internal_params.PROGRESS_INTERVAL / 1000000,
+        .tv_nsec = (shmem_internal_params.PROGRESS_INTERVAL % 1000000) * 1000
+    };
+
+    if (cpu >= 0) {
+        cpu_set_t set;
+        int ret;
+
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (ret != 0)
+            RAISE_WARN_MSG("Unable to bind progress thread to CPU %ld (%s)\n",
+                           cpu, strerror(ret));
+    }
+
+    while (__atomic_load_n(&shmem_transport_ofi_progress_thread_enabled, __ATOMIC_ACQUIRE)) {
+        if (0 == pthread_mutex_trylock(&shmem_transport_ofi_progress_lock)) {
+            if (fi_cq_read(shmem_transport_ofi_target_cq, &buf, 1) == 1)
+                RAISE_WARN_STR("Unexpected event");
+            for (int i = 0; i < shmem_transport_ofi_num_rails; i++) {
+                if (fi_cq_read(shmem_transport_ofi_rails[i].target_cq, &buf, 1) == 1)
+                    RAISE_WARN_STR("Unexpected event");
+            }
+#if ENABLE_TARGET_CNTR
+            shmem_transport_ofi_target_cntr_read();
+#endif
+            pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
+        }
+
+        fi_cntr_read(shmem_transport_ctx_default.put_cntr);
+        fi_cntr_read(shmem_transport_ctx_default.get_cntr);
+
+        if (shmem_transport_ofi_amo_emulated)
+            shmem_transport_ofi_amo_service();
+
+        nanosleep(&interval, NULL);
+    }
+
+    return NULL;
+}
+#endif /* ENABLE_THREADS */
+
 int shmem_transport_startup(void)
 {
     int ret;
@@ -1963,15 +3781,48 @@ int shmem_transport_startup(void)
         OFI_CHECK_RETURN_MSG(ret, "STX context creation failed (%s)\n", fi_strerror(ret));
         shmem_transport_ofi_stx_pool[i].ref_cnt = 0;
         shmem_transport_ofi_stx_pool[i].is_private = 0;
+        shmem_transport_ofi_stx_pool[i].ctx_cnt = 0;
+        shmem_transport_ofi_stx_pool[i].put_cnt = 0;
+        shmem_transport_ofi_stx_pool[i].get_cnt = 0;
+        shmem_transport_ofi_stx_pool[i].ctxs = NULL;
     }
 
+    if (shmem_transport_ofi_stx_max > 0)
+        shmem_transport_ofi_stx_group_init();
+
+    ret = populate_rails();
+    if (ret != 0) return ret;
+
     shmem_transport_ctx_default.team = &shmem_internal_team_world;
 
     ret = shmem_transport_ofi_ctx_init(&shmem_transport_ctx_default, SHMEM_TRANSPORT_CTX_DEFAULT_ID);
     if (ret != 0) return ret;
 
-    ret = atomic_limitations_check();
-    if (ret != 0) return ret;
+#ifdef ENABLE_THREADS
+    if (shmem_transport_ofi_thread_default_ctx) {
+        ret = pthread_key_create(&shmem_transport_ofi_thread_ctx_key,
+                                 shmem_transport_ofi_thread_ctx_release);
+        if (ret != 0) {
+            RAISE_WARN_MSG("Unable to create thread ctx key (%s), using a shared default context\n",
+                           strerror(ret));
+            shmem_transport_ofi_thread_default_ctx = 0;
+        }
+        /* The initializing thread uses the default context directly */
+        shmem_transport_ofi_thread_ctx = &shmem_transport_ctx_default;
+    }
+#endif
+
+    if (shmem_transport_ofi_amo_mode == SHMEM_TRANSPORT_OFI_AMO_EMULATION_ON) {
+        init_ofi_tables();
+    } else {
+        ret = atomic_limitations_check();
+        if (ret != 0) {
+            if (shmem_transport_ofi_amo_mode == SHMEM_TRANSPORT_OFI_AMO_EMULATION_OFF)
+                return ret;
+            RAISE_WARN_STR("Falling back to software emulation of atomic operations");
+            shmem_transport_ofi_amo_mode = SHMEM_TRANSPORT_OFI_AMO_EMULATION_ON;
+        }
+    }
 
     ret = populate_mr_tables();
     if (ret != 0) return ret;
@@ -1979,6 +3830,23 @@ int shmem_transport_startup(void)
     ret = populate_av();
     if (ret != 0) return ret;
 
+    if (shmem_transport_ofi_amo_mode == SHMEM_TRANSPORT_OFI_AMO_EMULATION_ON) {
+        ret = shmem_transport_ofi_amo_init();
+        if (ret != 0) return ret;
+    }
+
+#ifdef ENABLE_THREADS
+    if (shmem_internal_params.PROGRESS_INTERVAL > 0) {
+        __atomic_store_n(&shmem_transport_ofi_progress_thread_enabled, 1, __ATOMIC_RELEASE);
+        ret = pthread_create(&shmem_transport_ofi_progress_thread, NULL,
+                             &shmem_transport_ofi_progress_thread_func, NULL);
+        if (ret != 0) {
+            RAISE_WARN_MSG("Unable to start progress thread (%s)\n", strerror(ret));
+            shmem_transport_ofi_progress_thread_enabled = 0;
+        }
+    }
+#endif
+
     return 0;
 }
 
@@ -2077,13 +3945,36 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
         OFI_CHECK_ERROR_MSG(ret, "Context endpoint close failed (%s)\n", fi_strerror(errno));
     }
 
+    for (int i = 0; ctx->shards && i < shmem_transport_ofi_num_shards - 1; i++) {
+        if (ctx->shards[i].ep) {
+            ret = fi_close(&ctx->shards[i].ep->fid);
+            OFI_CHECK_ERROR_MSG(ret, "Context shard endpoint close failed (%s)\n", fi_strerror(errno));
+        }
+    }
+
     if (ctx->bounce_buffers) {
         shmem_free_list_destroy(ctx->bounce_buffers);
     }
 
     if (ctx->stx_idx >= 0) {
         SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
-        if (shmem_transport_ofi_is_private(ctx->options)) {
+        shmem_transport_ofi_stx_pool[ctx->stx_idx].put_cnt +=
+            SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+            shmem_transport_ofi_shards_cnt(ctx, 1, 0);
+        shmem_transport_ofi_stx_pool[ctx->stx_idx].get_cnt +=
+            SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr) +
+            shmem_transport_ofi_shards_cnt(ctx, 0, 0);
+        if (ctx->stx_prev)
+            ctx->stx_prev->stx_next = ctx->stx_next;
+        else
+            shmem_transport_ofi_stx_pool[ctx->stx_idx].ctxs = ctx->stx_next;
+        if (ctx->stx_next)
+            ctx->stx_next->stx_prev = ctx->stx_prev;
+        /* Thread contexts drop SHMEM_CTX_PRIVATE after allocating their STX */
+        int private_stx = (ctx->id == SHMEM_TRANSPORT_CTX_THREAD_ID) ?
+                          shmem_transport_ofi_stx_pool[ctx->stx_idx].is_private :
+                          shmem_transport_ofi_is_private(ctx->options);
+        if (private_stx) {
             shmem_transport_ofi_stx_kvs_t *e;
             HASH_FIND(hh, shmem_transport_ofi_stx_kvs, &ctx->tid,
                       sizeof(struct shmem_internal_tid), e);
@@ -2109,6 +4000,23 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
         SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
     }
 
+    if (ctx->shards) {
+        for (int i = 0; i < shmem_transport_ofi_num_shards - 1; i++) {
+            struct shmem_transport_ofi_ctx_shard_t *shard = &ctx->shards[i];
+
+            if (shard->put_cntr) {
+                ret = fi_close(&shard->put_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context shard put CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+            if (shard->get_cntr) {
+                ret = fi_close(&shard->get_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context shard get CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+        }
+        free(ctx->shards);
+        ctx->shards = NULL;
+    }
+
     if (ctx->put_cntr) {
         ret = fi_close(&ctx->put_cntr->fid);
         OFI_CHECK_ERROR_MSG(ret, "Context put CNTR close failed (%s)\n", fi_strerror(errno));
@@ -2124,6 +4032,31 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
         OFI_CHECK_ERROR_MSG(ret, "Context CQ close failed (%s)\n", fi_strerror(errno));
     }
 
+    if (ctx->rails) {
+        for (int i = 0; i < shmem_transport_ofi_num_rails; i++) {
+            struct shmem_transport_ofi_ctx_rail_t *rail = &ctx->rails[i];
+
+            if (rail->ep) {
+                ret = fi_close(&rail->ep->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail endpoint close failed (%s)\n", fi_strerror(errno));
+            }
+            if (rail->put_cntr) {
+                ret = fi_close(&rail->put_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail put CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+            if (rail->get_cntr) {
+                ret = fi_close(&rail->get_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail get CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+            if (rail->cq) {
+                ret = fi_close(&rail->cq->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail CQ close failed (%s)\n", fi_strerror(errno));
+            }
+        }
+        free(ctx->rails);
+        ctx->rails = NULL;
+    }
+
 #ifdef USE_CTX_LOCK
     SHMEM_MUTEX_DESTROY(ctx->lock);
 #endif
@@ -2134,17 +4067,211 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
         SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
         free(ctx);
     }
+    else if (ctx->id == SHMEM_TRANSPORT_CTX_THREAD_ID ||
+             ctx->id == SHMEM_TRANSPORT_CTX_AMO_ID) {
+        free(ctx);
+    }
     else if (ctx->id != SHMEM_TRANSPORT_CTX_DEFAULT_ID) {
         RAISE_ERROR_MSG("Attempted to destroy an invalid context (%d)\n", ctx->id);
     }
 }
 
+#ifdef ENABLE_THREADS
+shmem_transport_ctx_t *shmem_transport_ofi_thread_ctx_create(void)
+{
+    int ret;
+    size_t id;
+
+    shmem_transport_ctx_t *ctxp = malloc(sizeof(shmem_transport_ctx_t));
+
+    if (ctxp == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI thread ctx object");
+    }
+
+    memset(ctxp, 0, sizeof(shmem_transport_ctx_t));
+
+#ifndef USE_CTX_LOCK
+    shmem_internal_cntr_write(&ctxp->pending_put_cntr, 0);
+    shmem_internal_cntr_write(&ctxp->pending_get_cntr, 0);
+#endif
+
+    /* Request a private STX keyed on this thread's TID, but keep the context
+     * locked afterward, since quiet on the default context may complete it
+     * from another thread */
+    ctxp->stx_idx = -1;
+    ctxp->options = SHMEM_CTX_PRIVATE | SHMEMX_CTX_BOUNCE_BUFFER;
+    ctxp->team = &shmem_internal_team_world;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+
+    ret = shmem_transport_ofi_ctx_init(ctxp, SHMEM_TRANSPORT_CTX_THREAD_ID);
+    ctxp->options &= ~SHMEM_CTX_PRIVATE;
+
+    if (ret) {
+        SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+        shmem_transport_ctx_destroy(ctxp);
+        RAISE_WARN_STR("Thread context creation failed, using the shared default context");
+        shmem_transport_ofi_thread_ctx = &shmem_transport_ctx_default;
+        return shmem_transport_ofi_thread_ctx;
+    }
+
+    for (id = 0; id < shmem_transport_ofi_thread_ctxs_len; id++)
+        if (shmem_transport_ofi_thread_ctxs[id] == NULL) break;
+
+    if (id >= shmem_transport_ofi_thread_ctxs_len) {
+        size_t i = shmem_transport_ofi_thread_ctxs_len;
+        shmem_transport_ofi_thread_ctxs_len += shmem_transport_ofi_grow_size;
+        shmem_transport_ofi_thread_ctxs = realloc(shmem_transport_ofi_thread_ctxs,
+                                                  shmem_transport_ofi_thread_ctxs_len *
+                                                  sizeof(shmem_transport_ctx_t*));
+
+        if (shmem_transport_ofi_thread_ctxs == NULL) {
+            RAISE_ERROR_STR("Out of memory when allocating OFI thread ctx array");
+        }
+
+        for ( ; i < shmem_transport_ofi_thread_ctxs_len; i++)
+            shmem_transport_ofi_thread_ctxs[i] = NULL;
+    }
+
+    shmem_transport_ofi_thread_ctxs[id] = ctxp;
+    ctxp->thread_refs = 1;
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    pthread_setspecific(shmem_transport_ofi_thread_ctx_key, ctxp);
+    shmem_transport_ofi_thread_ctx = ctxp;
+
+    return ctxp;
+}
+
+/* Called on thread exit; the thread can no longer issue operations, so its
+ * context is completed before it is removed from the list.  A quiet running
+ * on another thread may still hold a reference, in which case that quiet
+ * destroys the context. */
+static void shmem_transport_ofi_thread_ctx_release(void *arg)
+{
+    shmem_transport_ctx_t *ctx = (shmem_transport_ctx_t *) arg;
+    int refs;
+
+    shmem_transport_quiet(ctx);
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+    for (size_t i = 0; i < shmem_transport_ofi_thread_ctxs_len; i++) {
+        if (shmem_transport_ofi_thread_ctxs[i] == ctx) {
+            shmem_transport_ofi_thread_ctxs[i] = NULL;
+            break;
+        }
+    }
+    refs = --ctx->thread_refs;
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    if (refs == 0)
+        shmem_transport_ctx_destroy(ctx);
+}
+
+/* Complete the operations of every per-thread context.  The list is copied
+ * under the OFI lock, with a reference taken on each context, and the
+ * contexts are quieted after the lock is dropped so that a long quiet does
+ * not stall thread creation and exit. */
+void shmem_transport_ofi_thread_ctx_quiet(int pe)
+{
+    shmem_transport_ctx_t **ctxs;
+    size_t i, n = 0;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+    if (shmem_transport_ofi_thread_ctxs_len == 0) {
+        SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+        return;
+    }
+
+    ctxs = malloc(shmem_transport_ofi_thread_ctxs_len * sizeof(shmem_transport_ctx_t *));
+    if (ctxs == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI thread ctx snapshot");
+    }
+
+    for (i = 0; i < shmem_transport_ofi_thread_ctxs_len; i++) {
+        if (shmem_transport_ofi_thread_ctxs[i] == NULL)
+            continue;
+        shmem_transport_ofi_thread_ctxs[i]->thread_refs++;
+        ctxs[n++] = shmem_transport_ofi_thread_ctxs[i];
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    for (i = 0; i < n; i++) {
+        if (pe < 0)
+            shmem_transport_quiet(ctxs[i]);
+        else
+            shmem_transport_quiet_pe(ctxs[i], pe);
+    }
+
+    /* Contexts whose threads exited during the quiet are destroyed here */
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+    for (i = 0; i < n; i++) {
+        if (--ctxs[i]->thread_refs > 0)
+            ctxs[i] = NULL;
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    for (i = 0; i < n; i++) {
+        if (ctxs[i] != NULL)
+            shmem_transport_ctx_destroy(ctxs[i]);
+    }
+
+    free(ctxs);
+}
+
+static void shmem_transport_ofi_thread_ctx_fini(void)
+{
+    shmem_transport_ctx_t **ctxs;
+    size_t len;
+
+    if (!shmem_transport_ofi_thread_default_ctx)
+        return;
+
+    /* Contexts of threads that are still running are destroyed here.  Once
+     * the key is deleted, exiting threads no longer release their context. */
+    pthread_key_delete(shmem_transport_ofi_thread_ctx_key);
+    shmem_transport_ofi_thread_default_ctx = 0;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+    ctxs = shmem_transport_ofi_thread_ctxs;
+    len = shmem_transport_ofi_thread_ctxs_len;
+    shmem_transport_ofi_thread_ctxs = NULL;
+    shmem_transport_ofi_thread_ctxs_len = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        if (ctxs[i] != NULL && --ctxs[i]->thread_refs > 0)
+            ctxs[i] = NULL;
+    }
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    for (size_t i = 0; i < len; i++) {
+        if (ctxs[i] != NULL) {
+            shmem_transport_quiet(ctxs[i]);
+            shmem_transport_ctx_destroy(ctxs[i]);
+        }
+    }
+    free(ctxs);
+}
+#endif
+
 int shmem_transport_fini(void)
 {
     int ret;
     shmem_transport_ofi_stx_kvs_t* e;
     int stx_len = 0;
 
+#ifdef ENABLE_THREADS
+    if (shmem_transport_ofi_progress_thread_enabled) {
+        __atomic_store_n(&shmem_transport_ofi_progress_thread_enabled, 0, __ATOMIC_RELEASE);
+        pthread_join(shmem_transport_ofi_progress_thread, NULL);
+    }
+
+    shmem_transport_ofi_thread_ctx_fini();
+#endif
+
+    shmem_transport_ofi_amo_fini();
+
     /* The default context is not inserted into the list of contexts on
      * SHMEM_TEAM_WORLD, so it must be destroyed here */
     shmem_transport_quiet(&shmem_transport_ctx_default);
@@ -2161,6 +4288,10 @@ int shmem_transport_fini(void)
         RAISE_WARN_MSG("Key/value store contained %d unfreed private contexts\n", stx_len);
     }
 
+    shmem_transport_ofi_dump_stx();
+
+    shmem_transport_ofi_mr_cache_fini();
+
     for (long i = 0; i < shmem_transport_ofi_stx_max; ++i) {
         if (shmem_transport_ofi_stx_pool[i].ref_cnt != 0)
             RAISE_WARN_MSG("Closing a %s STX (%zu) with nonzero ref. count (%ld)\n",
@@ -2186,6 +4317,13 @@ int shmem_transport_fini(void)
     free(shmem_transport_ofi_target_heap_keys);
     free(shmem_transport_ofi_target_data_keys);
 
+    if (shmem_transport_ofi_mr_pages) {
+        for (size_t i = 0; i < shmem_transport_ofi_mr_npages; i++)
+            free(shmem_transport_ofi_mr_pages[i]);
+        free(shmem_transport_ofi_mr_pages);
+        SHMEM_MUTEX_DESTROY(shmem_transport_ofi_mr_lock);
+    }
+
 #if !defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
     free(shmem_transport_ofi_target_heap_addrs);
     free(shmem_transport_ofi_target_data_addrs);
@@ -2207,6 +4345,8 @@ int shmem_transport_fini(void)
     }
 #endif
 
+    shmem_transport_ofi_rails_fini();
+
     ret = fi_close(&shmem_transport_ofi_target_ep->fid);
     OFI_CHECK_ERROR_MSG(ret, "Target endpoint close failed (%s)\n", fi_strerror(errno));
 
@@ -2231,6 +4371,13 @@ int shmem_transport_fini(void)
     free(addr_table);
 #endif
 
+    if (shmem_transport_ofi_av_pages) {
+        for (size_t i = 0; i < shmem_transport_ofi_av_npages; i++)
+            free(shmem_transport_ofi_av_pages[i]);
+        free(shmem_transport_ofi_av_pages);
+        SHMEM_MUTEX_DESTROY(shmem_transport_ofi_av_lock);
+    }
+
     fi_freeinfo(shmem_transport_ofi_info.fabrics);
 
     SHMEM_MUTEX_DESTROY(shmem_transport_ofi_lock);
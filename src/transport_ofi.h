@@ -31,6 +31,7 @@
 #include "shmem_internal.h"
 #include "shmem_atomic.h"
 #include "shmem_team.h"
+#include "shmem_wait.h"
 #include <sys/types.h>
 
 
@@ -55,14 +56,58 @@ extern int                              shmem_transport_ofi_use_absolute_address
 extern uint8_t**                        shmem_transport_ofi_target_heap_addrs;
 extern uint8_t**                        shmem_transport_ofi_target_data_addrs;
 #endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+
+/* Lazily resolved remote MR information (SHMEM_OFI_LAZY_MR_TABLES).  Entries
+ * are grouped into pages of consecutive PEs that are allocated on first
+ * communication with any PE in the page. */
+struct shmem_transport_ofi_mr_entry_t {
+    uint64_t                            heap_key;
+    uint64_t                            data_key;
+#ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+    uint8_t*                            heap_addr;
+    uint8_t*                            data_addr;
+#endif
+    int                                 valid;
+};
+typedef struct shmem_transport_ofi_mr_entry_t shmem_transport_ofi_mr_entry_t;
+
+#define SHMEM_TRANSPORT_OFI_MR_PAGE_SHIFT 8
+#define SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE  (1 << SHMEM_TRANSPORT_OFI_MR_PAGE_SHIFT)
+
+/* NULL unless lazy MR tables are enabled */
+extern shmem_transport_ofi_mr_entry_t** shmem_transport_ofi_mr_pages;
 #endif /* ENABLE_MR_SCALABLE */
 
+/* Scalable MRs with remote virtual addressing register the whole address
+ * space, so the symmetric heap can grow without new registrations */
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 1
+#else
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 0
+#endif
+
+/* Memory spaces are covered by the all-memory MR in that configuration, so
+ * they must be at the same address on every PE.  Otherwise each space has
+ * its own MR, using keys and MR descriptors after the data segment, heap and
+ * external heap. */
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+#define SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA 1
+#else
+#define SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA 0
+#endif
+#define SHMEM_TRANSPORT_OFI_SPACE_MR_BASE 3
+
+/* Registration cache keys start after the keys reserved for spaces */
+#define SHMEM_TRANSPORT_OFI_MR_CACHE_KEY_BASE \
+    (SHMEM_TRANSPORT_OFI_SPACE_MR_BASE + SHMEM_INTERNAL_MAX_SPACES)
+
 #ifdef USE_FI_HMEM
 extern uint64_t*                        shmem_transport_ofi_external_heap_keys;
 extern uint8_t**                        shmem_transport_ofi_external_heap_addrs;
 #endif
 
-extern struct fid_mr*                   shmem_transport_ofi_mrfd_list[3];
+extern struct fid_mr*                   shmem_transport_ofi_mrfd_list[SHMEM_TRANSPORT_OFI_SPACE_MR_BASE +
+                                                                  SHMEM_INTERNAL_MAX_SPACES];
 extern uint64_t                         shmem_transport_ofi_max_poll;
 extern long                             shmem_transport_ofi_put_poll_limit;
 extern long                             shmem_transport_ofi_get_poll_limit;
@@ -70,6 +115,9 @@ extern size_t                           shmem_transport_ofi_max_buffered_send;
 extern size_t                           shmem_transport_ofi_max_msg_size;
 extern size_t                           shmem_transport_ofi_bounce_buffer_size;
 extern long                             shmem_transport_ofi_max_bounce_buffers;
+extern int                              shmem_transport_ofi_num_rails;
+extern int                              shmem_transport_ofi_num_shards;
+extern size_t                           shmem_transport_ofi_stripe_threshold;
 
 extern pthread_mutex_t                  shmem_transport_ofi_progress_lock;
 
@@ -138,6 +186,8 @@ int shmem_transport_ofi_get_mr_desc_index(const void *addr) {
     } else if ((void*) addr >= shmem_internal_heap_base &&
                (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
         ret = 1;
+    } else if ((ret = shmem_internal_space_index(addr)) >= 0) {
+        ret += SHMEM_TRANSPORT_OFI_SPACE_MR_BASE;
     } else {
         ret = -1;
     }
@@ -154,6 +204,8 @@ int shmem_transport_ofi_get_mr_desc_index(const void *addr) {
     } else if ((void*) addr >= shmem_internal_heap_base &&
                (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
         ret = 1;
+    } else if ((ret = shmem_internal_space_index(addr)) >= 0) {
+        ret += SHMEM_TRANSPORT_OFI_SPACE_MR_BASE;
     }
 #ifdef USE_FI_HMEM
     else if (shmem_external_heap_pre_initialized) {
@@ -178,6 +230,8 @@ void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
     *key = 0;
     *mr_addr = (uint8_t*) addr;
 #else
+    int space;
+
     if ((void*) addr >= shmem_internal_data_base &&
         (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
 
@@ -189,6 +243,10 @@ void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
 
         *key = 1;
         *mr_addr = (uint8_t*) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
+    } else if ((space = shmem_internal_space_index(addr)) >= 0) {
+        *key = shmem_internal_spaces[space].keys[dest_pe];
+        *mr_addr = shmem_internal_spaces[space].addrs[dest_pe] +
+            ((uint8_t *) addr - (uint8_t *) shmem_internal_spaces[space].base);
     } else {
         *key = 0;
         *mr_addr = NULL;
@@ -199,36 +257,75 @@ void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
 }
 
 #else
+shmem_transport_ofi_mr_entry_t *shmem_transport_ofi_mr_fetch(int pe);
+
+/* Fast path lookup of a lazily resolved MR entry; falls back to the runtime
+ * KVS on the first access to the given PE */
+static inline
+shmem_transport_ofi_mr_entry_t *shmem_transport_ofi_mr_lookup(int pe)
+{
+    shmem_transport_ofi_mr_entry_t *page =
+        __atomic_load_n(&shmem_transport_ofi_mr_pages[pe >> SHMEM_TRANSPORT_OFI_MR_PAGE_SHIFT],
+                        __ATOMIC_ACQUIRE);
+
+    if (page != NULL) {
+        shmem_transport_ofi_mr_entry_t *e = &page[pe & (SHMEM_TRANSPORT_OFI_MR_PAGE_SIZE - 1)];
+        if (__atomic_load_n(&e->valid, __ATOMIC_ACQUIRE))
+            return e;
+    }
+
+    return shmem_transport_ofi_mr_fetch(pe);
+}
+
 static inline
 void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
                                 uint8_t **mr_addr, uint64_t *key) {
+    shmem_transport_ofi_mr_entry_t *e = NULL;
+    int space;
+
     if ((void*) addr >= shmem_internal_data_base &&
         (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
-        *key = shmem_transport_ofi_target_data_keys[dest_pe];
+        if (shmem_transport_ofi_mr_pages) {
+            e = shmem_transport_ofi_mr_lookup(dest_pe);
+            *key = e->data_key;
+        } else {
+            *key = shmem_transport_ofi_target_data_keys[dest_pe];
+        }
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
         if (shmem_transport_ofi_use_absolute_address)
             *mr_addr = (uint8_t *) addr;
         else
             *mr_addr = (void *) ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
 #else
-        *mr_addr = shmem_transport_ofi_target_data_addrs[dest_pe] +
+        *mr_addr = (e ? e->data_addr : shmem_transport_ofi_target_data_addrs[dest_pe]) +
             ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
 #endif
     }
 
     else if ((void*) addr >= shmem_internal_heap_base &&
              (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
-        *key = shmem_transport_ofi_target_heap_keys[dest_pe];
+        if (shmem_transport_ofi_mr_pages) {
+            e = shmem_transport_ofi_mr_lookup(dest_pe);
+            *key = e->heap_key;
+        } else {
+            *key = shmem_transport_ofi_target_heap_keys[dest_pe];
+        }
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
         if (shmem_transport_ofi_use_absolute_address)
             *mr_addr = (uint8_t *) addr;
         else
             *mr_addr = (void *) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
 #else
-        *mr_addr = shmem_transport_ofi_target_heap_addrs[dest_pe] +
+        *mr_addr = (e ? e->heap_addr : shmem_transport_ofi_target_heap_addrs[dest_pe]) +
             ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
 #endif
     }
+
+    else if ((space = shmem_internal_space_index(addr)) >= 0) {
+        *key = shmem_internal_spaces[space].keys[dest_pe];
+        *mr_addr = shmem_internal_spaces[space].addrs[dest_pe] +
+            ((uint8_t *) addr - (uint8_t *) shmem_internal_spaces[space].base);
+    }
 #ifdef USE_FI_HMEM
     else if (shmem_external_heap_pre_initialized) {
         if ((void*) addr >= shmem_external_heap_base &&
@@ -269,12 +366,114 @@ typedef enum fi_op       shm_internal_op_t;
 
 extern fi_addr_t *addr_table;
 
+/* Lazily populated AV (SHMEM_OFI_LAZY_AV).  Peers are inserted into the AV on
+ * first use and their fi_addr is cached in pages of consecutive PEs.  Entries
+ * hold fi_addr + 1, so that zero-filled pages denote PEs not yet inserted. */
+#define SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT 8
+#define SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE  (1 << SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT)
+
+/* NULL unless lazy AV insertion is enabled */
+extern fi_addr_t **shmem_transport_ofi_av_pages;
+
+fi_addr_t shmem_transport_ofi_av_insert_pe(int pe);
+
+static inline
+fi_addr_t shmem_transport_ofi_av_lookup(int pe)
+{
+    fi_addr_t *page = __atomic_load_n(&shmem_transport_ofi_av_pages[pe >> SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT],
+                                      __ATOMIC_ACQUIRE);
+
+    if (page != NULL) {
+        fi_addr_t addr = __atomic_load_n(&page[pe & (SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE - 1)],
+                                         __ATOMIC_ACQUIRE);
+        if (addr != 0)
+            return addr - 1;
+    }
+
+    return shmem_transport_ofi_av_insert_pe(pe);
+}
+
+#ifdef USE_AV_MAP
+#define GET_DEST(dest) (shmem_transport_ofi_av_pages ? shmem_transport_ofi_av_lookup(dest) : \
+                        (fi_addr_t)(addr_table[(dest)]))
+#else
+#define GET_DEST(dest) (shmem_transport_ofi_av_pages ? shmem_transport_ofi_av_lookup(dest) : \
+                        (fi_addr_t)(dest))
+#endif
+
+/* Secondary NICs used to stripe large transfers.  Each rail has its own fabric
+ * resources and target endpoint; the primary NIC is not included. */
+struct shmem_transport_ofi_rail_t {
+    struct fi_info*                 info;
+    struct fid_fabric*              fabric;
+    struct fid_domain*              domain;
+    struct fid_av*                  av;
+    struct fid_ep*                  target_ep;
+    struct fid_cq*                  target_cq;
+#if ENABLE_TARGET_CNTR
+    /* Counts incoming writes on this rail */
+    struct fid_cntr*                target_cntr;
+#endif
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    struct fid_mr*                  mr;
+#else
+    struct fid_mr*                  heap_mr;
+    struct fid_mr*                  data_mr;
+#endif
+#ifndef ENABLE_MR_SCALABLE
+    uint64_t*                       heap_keys;
+    uint64_t*                       data_keys;
+#endif
+    fi_addr_t*                      addr_table;
+    size_t                          addrlen;
+};
+
+extern struct shmem_transport_ofi_rail_t *shmem_transport_ofi_rails;
+
 #ifdef USE_AV_MAP
-#define GET_DEST(dest) ((fi_addr_t)(addr_table[(dest)]))
+#define GET_RAIL_DEST(rail, dest) ((fi_addr_t)(shmem_transport_ofi_rails[(rail)].addr_table[(dest)]))
 #else
-#define GET_DEST(dest) ((fi_addr_t)(dest))
+#define GET_RAIL_DEST(rail, dest) ((fi_addr_t)(dest))
 #endif
 
+/* Maximum number of secondary NICs used for striping */
+#define SHMEM_TRANSPORT_OFI_MAX_RAILS 7
+
+/* Stripe rails of one peer, resolved on the first striped transfer to it
+ * when lazy AV insertion is enabled.  The pages use the same layout as
+ * shmem_transport_ofi_av_pages.  nrails holds the number of rails paired with
+ * the peer plus one, so that zero-filled entries denote unresolved peers. */
+struct shmem_transport_ofi_rail_peer_t {
+    int                             nrails;
+    fi_addr_t                       addr[SHMEM_TRANSPORT_OFI_MAX_RAILS];
+#ifndef ENABLE_MR_SCALABLE
+    uint64_t                        heap_key[SHMEM_TRANSPORT_OFI_MAX_RAILS];
+    uint64_t                        data_key[SHMEM_TRANSPORT_OFI_MAX_RAILS];
+#endif
+};
+
+/* NULL unless lazy AV insertion is enabled and striping is active */
+extern struct shmem_transport_ofi_rail_peer_t **shmem_transport_ofi_rail_peer_pages;
+
+struct shmem_transport_ofi_rail_peer_t *shmem_transport_ofi_rail_peer_insert(int pe);
+
+static inline
+struct shmem_transport_ofi_rail_peer_t *shmem_transport_ofi_rail_peer(int pe)
+{
+    struct shmem_transport_ofi_rail_peer_t *page =
+        __atomic_load_n(&shmem_transport_ofi_rail_peer_pages[pe >> SHMEM_TRANSPORT_OFI_AV_PAGE_SHIFT],
+                        __ATOMIC_ACQUIRE);
+
+    if (page != NULL) {
+        struct shmem_transport_ofi_rail_peer_t *peer =
+            &page[pe & (SHMEM_TRANSPORT_OFI_AV_PAGE_SIZE - 1)];
+        if (__atomic_load_n(&peer->nrails, __ATOMIC_ACQUIRE) != 0)
+            return peer;
+    }
+
+    return shmem_transport_ofi_rail_peer_insert(pe);
+}
+
 #ifdef USE_FI_HMEM
 #define GET_MR_DESC(index) ((index == -1) ? NULL : (void *) shmem_transport_ofi_mrfd_list[index])
 #define GET_MR_DESC_ADDR(index) ((index == -1) ? NULL : (void **) &shmem_transport_ofi_mrfd_list[index])
@@ -283,6 +482,29 @@ extern fi_addr_t *addr_table;
 #define GET_MR_DESC_ADDR(index) NULL
 #endif
 
+/* Registration cache for non-symmetric local buffers (SHMEM_OFI_MR_CACHE).
+ * Only ranges passed to shmemx_register_buffer are cached, since the library
+ * cannot tell when other memory is freed or unmapped.  Entries are indexed by
+ * address range. */
+enum shmem_transport_ofi_mr_cache_mode_t {
+    SHMEM_TRANSPORT_OFI_MR_CACHE_OFF = 0,
+    SHMEM_TRANSPORT_OFI_MR_CACHE_HINT       /* Only shmemx_register_buffer ranges */
+};
+
+struct shmem_transport_ofi_mr_cache_entry_t {
+    uint8_t                        *start;
+    uint8_t                        *end;
+    struct fid_mr                  *mr;
+    void                           *desc;
+    int                             busy;       /* Lookups not yet released */
+    int                             invalid;    /* Unregistered, close when idle */
+    struct fid_mr                  *rail_mr[];  /* Same range on each stripe rail */
+};
+typedef struct shmem_transport_ofi_mr_cache_entry_t shmem_transport_ofi_mr_cache_entry_t;
+
+extern int    shmem_transport_ofi_mr_cache_mode;
+extern size_t shmem_transport_ofi_mr_cache_threshold;
+
 struct shmem_transport_ofi_frag_t {
     shmem_free_list_item_t item;
     uint8_t mytype;
@@ -310,6 +532,35 @@ struct shmem_internal_tid
     } val;
 };
 
+#ifdef USE_CTX_LOCK
+typedef uint64_t shmem_transport_ofi_pending_cntr_t;
+#else
+typedef shmem_internal_cntr_t shmem_transport_ofi_pending_cntr_t;
+#endif
+
+/* Per-context endpoint on a secondary rail */
+struct shmem_transport_ofi_ctx_rail_t {
+    struct fid_ep*                  ep;
+    struct fid_cntr*                put_cntr;
+    struct fid_cntr*                get_cntr;
+    struct fid_cq*                  cq;
+    shmem_transport_ofi_pending_cntr_t pending_put_cntr;
+    shmem_transport_ofi_pending_cntr_t pending_get_cntr;
+    /* Pending counts known to be complete, so that waits can skip idle rails */
+    shmem_transport_ofi_pending_cntr_t completed_put_cntr;
+    shmem_transport_ofi_pending_cntr_t completed_get_cntr;
+};
+
+/* Additional endpoint of a context that carries the operations to a subset
+ * of the destination PEs, so that they can be completed separately */
+struct shmem_transport_ofi_ctx_shard_t {
+    struct fid_ep*                  ep;
+    struct fid_cntr*                put_cntr;
+    struct fid_cntr*                get_cntr;
+    shmem_transport_ofi_pending_cntr_t pending_put_cntr;
+    shmem_transport_ofi_pending_cntr_t pending_get_cntr;
+};
+
 struct shmem_transport_ctx_t {
     int                             id;
 #ifdef USE_CTX_LOCK
@@ -335,6 +586,21 @@ struct shmem_transport_ctx_t {
     int                             stx_idx;
     struct shmem_internal_tid       tid;
     struct shmem_internal_team_t   *team;
+    /* Completion wait history, used by the wait policy engine */
+    shmem_internal_wait_state_t     put_wait_state;
+    shmem_internal_wait_state_t     get_wait_state;
+    /* Secondary rail endpoints, NULL when striping is disabled */
+    struct shmem_transport_ofi_ctx_rail_t *rails;
+    /* Endpoints for destination shards 1..SHMEM_OFI_QUIET_SHARDS-1, NULL
+     * when sharding is disabled.  Shard 0 uses the fields above. */
+    struct shmem_transport_ofi_ctx_shard_t *shards;
+    /* Per-thread contexts only: one reference held by the owning thread and
+     * one by each quiet in progress on other threads.  Protected by the OFI
+     * lock; the context is destroyed when the count drops to zero. */
+    int                             thread_refs;
+    /* Other live contexts on the same STX, protected by the OFI lock */
+    struct shmem_transport_ctx_t   *stx_prev;
+    struct shmem_transport_ctx_t   *stx_next;
 };
 
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
@@ -342,6 +608,42 @@ extern shmem_transport_ctx_t shmem_transport_ctx_default;
 
 extern struct fid_ep* shmem_transport_ofi_target_ep;
 
+/* Destination PEs are spread over SHMEM_OFI_QUIET_SHARDS endpoints per
+ * context.  Returns NULL when the PE is served by the context's own
+ * endpoint. */
+static inline
+struct shmem_transport_ofi_ctx_shard_t *shmem_transport_ofi_shard(shmem_transport_ctx_t *ctx, int pe)
+{
+    int idx;
+
+    if (ctx->shards == NULL)
+        return NULL;
+
+    idx = pe % shmem_transport_ofi_num_shards;
+    return idx ? &ctx->shards[idx - 1] : NULL;
+}
+
+static inline
+struct fid_ep *shmem_transport_ofi_ep(shmem_transport_ctx_t *ctx, int pe)
+{
+    struct shmem_transport_ofi_ctx_shard_t *shard = shmem_transport_ofi_shard(ctx, pe);
+    return shard ? shard->ep : ctx->ep;
+}
+
+static inline
+shmem_transport_ofi_pending_cntr_t *shmem_transport_ofi_pending_put(shmem_transport_ctx_t *ctx, int pe)
+{
+    struct shmem_transport_ofi_ctx_shard_t *shard = shmem_transport_ofi_shard(ctx, pe);
+    return shard ? &shard->pending_put_cntr : &ctx->pending_put_cntr;
+}
+
+static inline
+shmem_transport_ofi_pending_cntr_t *shmem_transport_ofi_pending_get(shmem_transport_ctx_t *ctx, int pe)
+{
+    struct shmem_transport_ofi_ctx_shard_t *shard = shmem_transport_ofi_shard(ctx, pe);
+    return shard ? &shard->pending_get_cntr : &ctx->pending_get_cntr;
+}
+
 #ifdef USE_CTX_LOCK
 #define SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx)                                       \
     do {                                                                        \
@@ -356,12 +658,14 @@ extern struct fid_ep* shmem_transport_ofi_target_ep;
     } while (0)
 
 #define SHMEM_TRANSPORT_OFI_CNTR_READ(cntr) *(cntr)
+#define SHMEM_TRANSPORT_OFI_CNTR_WRITE(cntr, val) (*(cntr) = (val))
 #define SHMEM_TRANSPORT_OFI_CNTR_INC(cntr) (*(cntr))++
 
 #else
 #define SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx)
 #define SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx)
 #define SHMEM_TRANSPORT_OFI_CNTR_READ(cntr) shmem_internal_cntr_read(cntr)
+#define SHMEM_TRANSPORT_OFI_CNTR_WRITE(cntr, val) shmem_internal_cntr_write(cntr, val)
 #define SHMEM_TRANSPORT_OFI_CNTR_INC(cntr) shmem_internal_cntr_inc(cntr)
 #endif /* USE_CTX_LOCK */
 
@@ -378,6 +682,18 @@ extern struct fid_ep* shmem_transport_ofi_target_ep;
             shmem_free_list_unlock(ctx->bounce_buffers);                        \
     } while (0)
 
+/* Software emulation of atomics (SHMEM_OFI_ATOMIC_EMULATION).  When active,
+ * every AMO is posted to a request slot in the target PE's symmetric heap and
+ * applied by the target while it progresses the library, so that all atomics
+ * on a given location are serialized by the same engine. */
+extern int shmem_transport_ofi_amo_emulated;
+
+void shmem_transport_ofi_amo_emulate(shmem_transport_ctx_t *ctx, void *target,
+                                     const void *source, void *dest,
+                                     const void *operand, size_t len, int pe,
+                                     int op, int datatype);
+void shmem_transport_ofi_amo_service(void);
+
 static inline
 void shmem_transport_probe(void)
 {
@@ -389,18 +705,51 @@ void shmem_transport_probe(void)
         int ret = fi_cq_read(shmem_transport_ofi_target_cq, &buf, 1);
         if (ret == 1)
             RAISE_WARN_STR("Unexpected event");
+        for (int i = 0; i < shmem_transport_ofi_num_rails; i++) {
+            ret = fi_cq_read(shmem_transport_ofi_rails[i].target_cq, &buf, 1);
+            if (ret == 1)
+                RAISE_WARN_STR("Unexpected event");
+        }
 #  ifdef USE_THREAD_COMPLETION
         pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
     }
 #  endif
 #endif
 
+    if (shmem_transport_ofi_amo_emulated)
+        shmem_transport_ofi_amo_service();
+
     return;
 }
 
 int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx);
 void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx);
 
+#ifdef ENABLE_THREADS
+extern int shmem_transport_ofi_thread_default_ctx;
+extern __thread shmem_transport_ctx_t *shmem_transport_ofi_thread_ctx;
+
+shmem_transport_ctx_t *shmem_transport_ofi_thread_ctx_create(void);
+/* Quiet all thread contexts, or only their operations to pe if pe >= 0 */
+void shmem_transport_ofi_thread_ctx_quiet(int pe);
+
+/* With SHMEM_THREAD_DEFAULT_CTX=per_thread, operations on the default
+ * context are issued on a context owned by the calling thread */
+static inline
+shmem_transport_ctx_t *shmem_transport_ofi_ctx_resolve(shmem_transport_ctx_t *ctx)
+{
+    if (ctx == &shmem_transport_ctx_default && shmem_transport_ofi_thread_default_ctx) {
+        if (shmem_transport_ofi_thread_ctx == NULL)
+            return shmem_transport_ofi_thread_ctx_create();
+        return shmem_transport_ofi_thread_ctx;
+    }
+
+    return ctx;
+}
+
+#define SHMEM_TRANSPORT_CTX(ctx) shmem_transport_ofi_ctx_resolve((shmem_transport_ctx_t *)(ctx))
+#endif
+
 int shmem_transport_init(void);
 int shmem_transport_startup(void);
 int shmem_transport_fini(void);
@@ -409,6 +758,33 @@ extern size_t SHMEM_Dtsize[FI_DATATYPE_LAST];
 
 static inline void shmem_transport_get_wait(shmem_transport_ctx_t* ctx);
 
+shmem_transport_ofi_mr_cache_entry_t *shmem_transport_ofi_mr_cache_lookup(const void *buf, size_t len);
+void shmem_transport_ofi_mr_cache_release(shmem_transport_ofi_mr_cache_entry_t *entry);
+int shmem_transport_register_buffer(const void *addr, size_t len);
+int shmem_transport_unregister_buffer(const void *addr, size_t len);
+int shmem_transport_space_register(shmem_internal_space_t *space, int id);
+void shmem_transport_space_unregister(shmem_internal_space_t *space, int id);
+
+/* Return a cached registration covering a large, non-symmetric local buffer
+ * and set desc to its descriptor, or return NULL */
+static inline
+shmem_transport_ofi_mr_cache_entry_t *shmem_transport_ofi_mr_cache_get(const void *buf, size_t len,
+                                                                      void **desc)
+{
+    shmem_transport_ofi_mr_cache_entry_t *entry;
+
+    if (shmem_transport_ofi_mr_cache_mode == SHMEM_TRANSPORT_OFI_MR_CACHE_OFF ||
+        len < shmem_transport_ofi_mr_cache_threshold ||
+        shmem_transport_ofi_get_mr_desc_index(buf) >= 0)
+        return NULL;
+
+    entry = shmem_transport_ofi_mr_cache_lookup(buf, len);
+    if (entry)
+        *desc = entry->desc;
+
+    return entry;
+}
+
 /* Drain all available events from the CQ.  Note, ctx->bounce_buffers must be
  * locked before calling this routine */
 static inline
@@ -475,6 +851,141 @@ shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t
     return buff;
 }
 
+/* Wait for a completion counter to reach the pending count according to
+ * SHMEM_WAIT_POLICY.  Must be called with the ctx lock held. */
+static inline
+void shmem_transport_ofi_cntr_wait_policy(shmem_transport_ctx_t *ctx,
+                                          struct fid_cntr *cntr,
+                                          shmem_transport_ofi_pending_cntr_t *pending,
+                                          shmem_internal_wait_state_t *state)
+{
+    uint64_t success, fail, cnt, cnt_new;
+    shmem_internal_waiter_t waiter;
+    int started = 0, can_block = 1;
+
+#ifdef USE_CTX_LOCK
+    /* Sleeping in the provider while holding a shared context's lock would
+     * stall every other thread using the context */
+    if (shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE &&
+        !(ctx->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED)))
+        can_block = 0;
+#endif
+
+    for (;;) {
+        success = fi_cntr_read(cntr);
+        fail = fi_cntr_readerr(cntr);
+        cnt = SHMEM_TRANSPORT_OFI_CNTR_READ(pending);
+
+        shmem_transport_probe();
+
+        if (fail) {
+            RAISE_ERROR_MSG("Operations completed in error (%" PRIu64 ")\n", fail);
+        } else if (success >= cnt) {
+            break;
+        }
+
+        if (!started) {
+            shmem_internal_waiter_start(&waiter, state, can_block);
+            started = 1;
+        }
+
+        int mode = shmem_internal_waiter_next(&waiter);
+
+        if (mode == SHMEM_INTERNAL_WAIT_MODE_BLOCK) {
+            cnt_new = cnt;
+            do {
+                cnt = cnt_new;
+                ssize_t ret = fi_cntr_wait(cntr, cnt, -1);
+                cnt_new = SHMEM_TRANSPORT_OFI_CNTR_READ(pending);
+                OFI_CTX_CHECK_ERROR(ctx, ret);
+            } while (cnt < cnt_new);
+            shmem_internal_assert(cnt == cnt_new);
+            break;
+        }
+
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+        if (mode == SHMEM_INTERNAL_WAIT_MODE_YIELD)
+            sched_yield();
+        else
+            SPINLOCK_BODY();
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    }
+
+    if (started)
+        shmem_internal_waiter_end(&waiter);
+}
+
+/* Wait for striped operations on the secondary rails to complete.  Rails
+ * that have not been used since their last completed wait are skipped.  Must
+ * be called with the ctx lock held. */
+static inline
+void shmem_transport_ofi_rails_wait(shmem_transport_ctx_t *ctx, int is_put)
+{
+    int i;
+    uint64_t pending;
+
+    for (i = 0; i < shmem_transport_ofi_num_rails; i++) {
+        struct shmem_transport_ofi_ctx_rail_t *rail = &ctx->rails[i];
+
+        if (is_put) {
+            pending = SHMEM_TRANSPORT_OFI_CNTR_READ(&rail->pending_put_cntr);
+            if (pending == SHMEM_TRANSPORT_OFI_CNTR_READ(&rail->completed_put_cntr))
+                continue;
+
+            shmem_transport_ofi_cntr_wait_policy(ctx, rail->put_cntr, &rail->pending_put_cntr,
+                                                 &ctx->put_wait_state);
+            SHMEM_TRANSPORT_OFI_CNTR_WRITE(&rail->completed_put_cntr, pending);
+        } else {
+            pending = SHMEM_TRANSPORT_OFI_CNTR_READ(&rail->pending_get_cntr);
+            if (pending == SHMEM_TRANSPORT_OFI_CNTR_READ(&rail->completed_get_cntr))
+                continue;
+
+            shmem_transport_ofi_cntr_wait_policy(ctx, rail->get_cntr, &rail->pending_get_cntr,
+                                                 &ctx->get_wait_state);
+            SHMEM_TRANSPORT_OFI_CNTR_WRITE(&rail->completed_get_cntr, pending);
+        }
+    }
+}
+
+/* Wait for operations on the destination shard endpoints to complete.  Must
+ * be called with the ctx lock held. */
+static inline
+void shmem_transport_ofi_shards_wait(shmem_transport_ctx_t *ctx, int is_put)
+{
+    int i;
+
+    for (i = 0; i < shmem_transport_ofi_num_shards - 1; i++) {
+        struct shmem_transport_ofi_ctx_shard_t *shard = &ctx->shards[i];
+
+        if (is_put)
+            shmem_transport_ofi_cntr_wait_policy(ctx, shard->put_cntr, &shard->pending_put_cntr,
+                                                 &ctx->put_wait_state);
+        else
+            shmem_transport_ofi_cntr_wait_policy(ctx, shard->get_cntr, &shard->pending_get_cntr,
+                                                 &ctx->get_wait_state);
+    }
+}
+
+/* Wait for the operations issued to one PE to complete, along with any
+ * striped transfers.  Must be called with the ctx lock held. */
+static inline
+void shmem_transport_ofi_pe_wait(shmem_transport_ctx_t *ctx, int pe, int is_put)
+{
+    struct shmem_transport_ofi_ctx_shard_t *shard = shmem_transport_ofi_shard(ctx, pe);
+
+    if (ctx->rails)
+        shmem_transport_ofi_rails_wait(ctx, is_put);
+
+    if (is_put)
+        shmem_transport_ofi_cntr_wait_policy(ctx, shard ? shard->put_cntr : ctx->put_cntr,
+                                             shmem_transport_ofi_pending_put(ctx, pe),
+                                             &ctx->put_wait_state);
+    else
+        shmem_transport_ofi_cntr_wait_policy(ctx, shard ? shard->get_cntr : ctx->get_cntr,
+                                             shmem_transport_ofi_pending_get(ctx, pe),
+                                             &ctx->get_wait_state);
+}
+
 static inline
 void shmem_transport_put_quiet(shmem_transport_ctx_t* ctx)
 {
@@ -491,6 +1002,19 @@ void shmem_transport_put_quiet(shmem_transport_ctx_t* ctx)
         SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
     }
 
+    if (ctx->rails)
+        shmem_transport_ofi_rails_wait(ctx, 1);
+
+    if (ctx->shards)
+        shmem_transport_ofi_shards_wait(ctx, 1);
+
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO) {
+        shmem_transport_ofi_cntr_wait_policy(ctx, ctx->put_cntr, &ctx->pending_put_cntr,
+                                             &ctx->put_wait_state);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+        return;
+    }
+
     /* wait for put counter to meet outstanding count value */
 
     /* Note: the communication routines increment pending put counters before
@@ -536,6 +1060,10 @@ void shmem_transport_put_quiet(shmem_transport_ctx_t* ctx)
 static inline
 int shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 {
+#ifdef ENABLE_THREADS
+    if (ctx == &shmem_transport_ctx_default && shmem_transport_ofi_thread_default_ctx)
+        shmem_transport_ofi_thread_ctx_quiet(-1);
+#endif
 
     shmem_transport_put_quiet(ctx);
     shmem_transport_get_wait(ctx);
@@ -547,10 +1075,24 @@ int shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 static inline
 int shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
+#ifdef ENABLE_THREADS
+    /* Ordering is only required for the calling thread's operations */
+    if (ctx == &shmem_transport_ctx_default && shmem_transport_ofi_thread_default_ctx &&
+        shmem_transport_ofi_thread_ctx != NULL &&
+        shmem_transport_ofi_thread_ctx != &shmem_transport_ctx_default)
+        shmem_transport_fence(shmem_transport_ofi_thread_ctx);
+#endif
 #if WANT_TOTAL_DATA_ORDERING == 0
     /* Communication is unordered; must wait for puts and buffered (injected)
      * non-fetching atomics to be completed in order to ensure ordering. */
     shmem_transport_put_quiet(ctx);
+#else
+    /* Ordering is only provided within a rail; complete striped puts */
+    if (ctx->rails) {
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        shmem_transport_ofi_rails_wait(ctx, 1);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+    }
 #endif
     /* Complete fetching ops; needed to support nonblocking fetch-atomics */
     shmem_transport_get_wait(ctx);
@@ -558,6 +1100,47 @@ int shmem_transport_fence(shmem_transport_ctx_t* ctx)
     return 0;
 }
 
+/* Complete only the operations issued to pe.  Bounce buffers are not
+ * reclaimed here; their puts are still covered by the put counters. */
+static inline
+int shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+#ifdef ENABLE_THREADS
+    if (ctx == &shmem_transport_ctx_default && shmem_transport_ofi_thread_default_ctx)
+        shmem_transport_ofi_thread_ctx_quiet(pe);
+#endif
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    shmem_transport_ofi_pe_wait(ctx, pe, 1);
+    shmem_transport_ofi_pe_wait(ctx, pe, 0);
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    return 0;
+}
+
+static inline
+int shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+#ifdef ENABLE_THREADS
+    if (ctx == &shmem_transport_ctx_default && shmem_transport_ofi_thread_default_ctx &&
+        shmem_transport_ofi_thread_ctx != NULL &&
+        shmem_transport_ofi_thread_ctx != &shmem_transport_ctx_default)
+        shmem_transport_fence_pe(shmem_transport_ofi_thread_ctx, pe);
+#endif
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+#if WANT_TOTAL_DATA_ORDERING == 0
+    shmem_transport_ofi_pe_wait(ctx, pe, 1);
+#else
+    if (ctx->rails)
+        shmem_transport_ofi_rails_wait(ctx, 1);
+#endif
+    shmem_transport_ofi_pe_wait(ctx, pe, 0);
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    return 0;
+}
+
 
 /* Process RMA operation return code.  If libfabric returned -FI_EAGAIN, attempt
  * to reclaim resources and indicate that the operation should be retried.  If
@@ -606,6 +1189,178 @@ int try_again(shmem_transport_ctx_t *ctx, const int ret, uint64_t *polled) {
 }
 
 
+/* Counterpart of try_again for operations issued on a secondary rail, which
+ * never carry bounce buffers */
+static inline
+int shmem_transport_ofi_rail_try_again(struct shmem_transport_ofi_ctx_rail_t *rail,
+                                       const int ret, uint64_t *polled)
+{
+    if (ret) {
+        if (ret == -FI_EAGAIN) {
+            struct fi_cq_err_entry e = {0};
+            ssize_t err = fi_cq_readerr(rail->cq, (void *)&e, 0);
+            if (err == 1) {
+                const char *errmsg = fi_cq_strerror(rail->cq, e.prov_errno,
+                                                    e.err_data, NULL, 0);
+                RAISE_ERROR_MSG("Error in operation: %s\n", errmsg);
+            } else if (err && err != -FI_EAGAIN) {
+                RAISE_ERROR_MSG("Error reading from CQ (%zd)\n", err);
+            }
+
+            shmem_transport_probe();
+
+            (*polled)++;
+
+            if ((*polled) <= shmem_transport_ofi_max_poll) {
+                return 1;
+            }
+            else {
+                RAISE_ERROR_MSG("Operation retry limit exceeded (%" PRIu64 ")\n",
+                                shmem_transport_ofi_max_poll);
+            }
+        }
+        else {
+            OFI_CHECK_ERROR(ret);
+        }
+    }
+
+    return 0;
+}
+
+/* Memory spaces are not registered on the secondary rails */
+#define SHMEM_TRANSPORT_OFI_STRIPE(ctx, len, remote)                            \
+    ((ctx)->rails != NULL && (len) >= shmem_transport_ofi_stripe_threshold &&  \
+     shmem_transport_ofi_get_mr_desc_index(remote) >= 0 &&                     \
+     shmem_internal_space_index(remote) < 0)
+
+#ifdef ENABLE_MR_SCALABLE
+static inline
+uint64_t shmem_transport_ofi_get_rail_key(const void *addr, int dest_pe, int rail,
+                                          uint64_t key,
+                                          struct shmem_transport_ofi_rail_peer_t *peer)
+{
+    /* Requested keys are the same in every domain */
+    return key;
+}
+#else
+static inline
+uint64_t shmem_transport_ofi_get_rail_key(const void *addr, int dest_pe, int rail,
+                                          uint64_t key,
+                                          struct shmem_transport_ofi_rail_peer_t *peer)
+{
+    /* Virtual addresses or segment offsets are the same on every rail, only
+     * the provider selected keys differ */
+    if (shmem_transport_ofi_get_mr_desc_index(addr) == 0)
+        return peer ? peer->data_key[rail] : shmem_transport_ofi_rails[rail].data_keys[dest_pe];
+    else
+        return peer ? peer->heap_key[rail] : shmem_transport_ofi_rails[rail].heap_keys[dest_pe];
+}
+#endif
+
+/* Descriptor of a local buffer in the domain of the given rail, or NULL if
+ * the buffer is not registered there */
+static inline
+void *shmem_transport_ofi_get_rail_desc(const void *local, int rail,
+                                        shmem_transport_ofi_mr_cache_entry_t *mr_entry)
+{
+    int idx;
+
+    if (mr_entry != NULL)
+        return fi_mr_desc(mr_entry->rail_mr[rail]);
+
+    idx = shmem_transport_ofi_get_mr_desc_index(local);
+
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    if (idx == 0 || idx == 1)
+        return fi_mr_desc(shmem_transport_ofi_rails[rail].mr);
+#else
+    if (idx == 0)
+        return fi_mr_desc(shmem_transport_ofi_rails[rail].data_mr);
+    else if (idx == 1)
+        return fi_mr_desc(shmem_transport_ofi_rails[rail].heap_mr);
+#endif
+
+    return NULL;
+}
+
+/* Split a large put or get into equal, cache line aligned stripes and issue
+ * all but the first on the secondary rails.  Returns the length of the first
+ * stripe, which the caller transfers on the primary rail.  If the local
+ * buffer is not registered on a rail whose provider requires local
+ * descriptors, the whole transfer is left to the primary rail.  Must be
+ * called with the ctx lock held. */
+static inline
+size_t shmem_transport_ofi_stripe(shmem_transport_ctx_t *ctx, uint8_t *local,
+                                  const void *remote, size_t len, int pe, int is_put,
+                                  shmem_transport_ofi_mr_cache_entry_t *mr_entry)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled = 0;
+    uint64_t key, rail_key;
+    uint8_t *addr;
+    struct shmem_transport_ofi_rail_peer_t *peer = NULL;
+    int nrails = shmem_transport_ofi_num_rails;
+    size_t stripe;
+    int i;
+
+    if (shmem_transport_ofi_rail_peer_pages) {
+        peer = shmem_transport_ofi_rail_peer(pe);
+        nrails = peer->nrails - 1;
+        if (nrails == 0)
+            return len;
+    }
+
+    stripe = (len / (nrails + 1) + 63) & ~((size_t) 63);
+
+    for (i = 0; i < nrails; i++) {
+        if ((shmem_transport_ofi_rails[i].info->domain_attr->mr_mode & FI_MR_LOCAL) &&
+            shmem_transport_ofi_get_rail_desc(local, i, mr_entry) == NULL)
+            return len;
+    }
+
+    shmem_transport_ofi_get_mr(remote, pe, &addr, &key);
+
+    for (i = 0; i < nrails; i++) {
+        struct shmem_transport_ofi_ctx_rail_t *rail = &ctx->rails[i];
+        size_t offset = (i + 1) * stripe;
+        size_t end = MIN(offset + stripe, len);
+        fi_addr_t rail_dest = peer ? peer->addr[i] : GET_RAIL_DEST(i, dst);
+        void *desc;
+
+        if (offset >= len) break;
+
+        rail_key = shmem_transport_ofi_get_rail_key(remote, pe, i, key, peer);
+        desc = shmem_transport_ofi_get_rail_desc(local, i, mr_entry);
+
+        while (offset < end) {
+            size_t frag_len = MIN(shmem_transport_ofi_max_msg_size, end - offset);
+            polled = 0;
+
+            if (is_put) {
+                SHMEM_TRANSPORT_OFI_CNTR_INC(&rail->pending_put_cntr);
+                do {
+                    ret = fi_write(rail->ep, local + offset, frag_len, desc,
+                                   rail_dest, (uint64_t) addr + offset,
+                                   rail_key, NULL);
+                } while (shmem_transport_ofi_rail_try_again(rail, ret, &polled));
+            } else {
+                SHMEM_TRANSPORT_OFI_CNTR_INC(&rail->pending_get_cntr);
+                do {
+                    ret = fi_read(rail->ep, local + offset, frag_len, desc,
+                                  rail_dest, (uint64_t) addr + offset,
+                                  rail_key, NULL);
+                } while (shmem_transport_ofi_rail_try_again(rail, ret, &polled));
+            }
+
+            offset += frag_len;
+        }
+    }
+
+    return MIN(stripe, len);
+}
+
+
 static inline
 void shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const
                                void *source, size_t len, int pe)
@@ -621,11 +1376,11 @@ void shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const
     shmem_internal_assert(len <= shmem_transport_ofi_max_buffered_send);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
     do {
 
-        ret = fi_inject_write(ctx->ep,
+        ret = fi_inject_write(shmem_transport_ofi_ep(ctx, pe),
                               source,
                               len,
                               GET_DEST(dst),
@@ -645,8 +1400,11 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    void *desc = GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source));
+    shmem_transport_ofi_mr_cache_entry_t *mr_entry;
 
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
+    mr_entry = shmem_transport_ofi_mr_cache_get(source, len, &desc);
 
     uint8_t *frag_source = (uint8_t *) source;
     uint64_t frag_target = (uint64_t) addr;
@@ -655,17 +1413,21 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
     /* operation generates counting events and must be completed by
      * quiet. */
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    if (SHMEM_TRANSPORT_OFI_STRIPE(ctx, len, target))
+        len = shmem_transport_ofi_stripe(ctx, (uint8_t *) source, target, len, pe, 1,
+                                         mr_entry);
+
     while (frag_source < ((uint8_t *) source) + len) {
         frag_len = MIN(shmem_transport_ofi_max_msg_size,
                        (size_t) (((uint8_t *) source) + len - frag_source));
         polled = 0;
 
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
         do {
-            ret = fi_write(ctx->ep,
+            ret = fi_write(shmem_transport_ofi_ep(ctx, pe),
                            frag_source, frag_len,
-                           GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source)),
+                           desc,
                            GET_DEST(dst), frag_target,
                            key, NULL);
         } while (try_again(ctx, ret, &polled));
@@ -673,6 +1435,8 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
         frag_source += frag_len;
         frag_target += frag_len;
     }
+    if (mr_entry)
+        shmem_transport_ofi_mr_cache_release(mr_entry);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
@@ -695,7 +1459,7 @@ void shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void
     } else if (len <= shmem_transport_ofi_bounce_buffer_size && ctx->bounce_buffers) {
 
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
         shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
         shmem_transport_ofi_bounce_buffer_t *buff =
@@ -715,7 +1479,7 @@ void shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void
                                             .data          = 0
                                           };
         do {
-            ret = fi_writemsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+            ret = fi_writemsg(shmem_transport_ofi_ep(ctx, pe), &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
         } while (try_again(ctx, ret, &polled));
         SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
@@ -741,7 +1505,7 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
         uint8_t *src_buf = (uint8_t *) source;
 
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
         const struct iovec msg_iov = {
                                        .iov_base = src_buf,
@@ -764,7 +1528,7 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
                                       };
 
         do {
-            ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE | FI_INJECT);
+            ret = fi_writemsg(shmem_transport_ofi_ep(ctx, pe), &msg, FI_DELIVERY_COMPLETE | FI_INJECT);
         } while (try_again(ctx, ret, &polled));
 
         SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
@@ -809,10 +1573,10 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
             msg.rma_iov = &rma_iov;
             msg.context = frag_source;
 
-            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+            SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
             do {
-                ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE);
+                ret = fi_writemsg(shmem_transport_ofi_ep(ctx, pe), &msg, FI_DELIVERY_COMPLETE);
             } while (try_again(ctx, ret, &polled));
 
             frag_source += frag_len;
@@ -831,13 +1595,21 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
 #endif 
 
     /* Transmit the signal */
+    int atomic_op = (sig_op == SHMEM_SIGNAL_ADD) ? FI_SUM : FI_ATOMIC_WRITE;
+
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, sig_addr, &signal, NULL, NULL,
+                                        sizeof(uint64_t), pe, atomic_op,
+                                        SHM_INTERNAL_UINT64);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(sig_addr, pe, &addr, &key);
     polled = 0;
     ret = 0;
-    int atomic_op = (sig_op == SHMEM_SIGNAL_ADD) ? FI_SUM : FI_ATOMIC_WRITE;
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
     const struct fi_ioc msg_iov_signal = {
                                           .addr = (uint8_t *) &signal,
@@ -862,7 +1634,7 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
                                          };
 
     do {
-        ret = fi_atomicmsg(ctx->ep, &msg_signal, flags_signal);
+        ret = fi_atomicmsg(shmem_transport_ofi_ep(ctx, pe), &msg_signal, flags_signal);
     } while (try_again(ctx, ret, &polled));
 
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
@@ -903,18 +1675,25 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    void *desc = GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(target));
+    shmem_transport_ofi_mr_cache_entry_t *mr_entry;
 
     shmem_transport_ofi_get_mr(source, pe, &addr, &key);
+    mr_entry = shmem_transport_ofi_mr_cache_get(target, len, &desc);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    if (SHMEM_TRANSPORT_OFI_STRIPE(ctx, len, source))
+        len = shmem_transport_ofi_stripe(ctx, (uint8_t *) target, source, len, pe, 0,
+                                         mr_entry);
+
     if (len <= shmem_transport_ofi_max_msg_size) {
 
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
         do {
-            ret = fi_read(ctx->ep,
+            ret = fi_read(shmem_transport_ofi_ep(ctx, pe),
                           target,
                           len,
-                          GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(target)),
+                          desc,
                           GET_DEST(dst),
                           (uint64_t) addr,
                           key,
@@ -931,12 +1710,12 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
                            (size_t) (((uint8_t *) target) + len - frag_target));
             polled = 0;
 
-            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+            SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
             do {
-                ret = fi_read(ctx->ep,
+                ret = fi_read(shmem_transport_ofi_ep(ctx, pe),
                               frag_target, frag_len,
-                              GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(target)),
+                              desc,
                               GET_DEST(dst), frag_source,
                               key, NULL);
             } while (try_again(ctx, ret, &polled));
@@ -945,6 +1724,8 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
             frag_target += frag_len;
         }
     }
+    if (mr_entry)
+        shmem_transport_ofi_mr_cache_release(mr_entry);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
@@ -965,6 +1746,19 @@ void shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
 
+    if (ctx->rails)
+        shmem_transport_ofi_rails_wait(ctx, 0);
+
+    if (ctx->shards)
+        shmem_transport_ofi_shards_wait(ctx, 0);
+
+    if (shmem_internal_wait_policy != SHMEM_INTERNAL_WAIT_POLICY_AUTO) {
+        shmem_transport_ofi_cntr_wait_policy(ctx, ctx->get_cntr, &ctx->pending_get_cntr,
+                                             &ctx->get_wait_state);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+        return;
+    }
+
     while (poll_count < shmem_transport_ofi_get_poll_limit ||
            shmem_transport_ofi_get_poll_limit < 0) {
         success = fi_cntr_read(ctx->get_cntr);
@@ -1009,6 +1803,12 @@ void shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, dest, operand, len, pe,
+                                        FI_CSWAP, datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
     shmem_internal_assert(len <= sizeof(double _Complex));
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
@@ -1031,10 +1831,10 @@ void shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const
                                };
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
     do {
-        ret = fi_compare_atomicmsg(ctx->ep,
+        ret = fi_compare_atomicmsg(shmem_transport_ofi_ep(ctx, pe),
                                    &msg,
                                    &comparev,
                                    NULL,
@@ -1066,16 +1866,22 @@ void shmem_transport_cswap(shmem_transport_ctx_t* ctx, void *target, const void
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, dest, operand, len, pe,
+                                        FI_CSWAP, datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(len <= sizeof(double _Complex));
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
     do {
-        ret = fi_compare_atomic(ctx->ep,
+        ret = fi_compare_atomic(shmem_transport_ofi_ep(ctx, pe),
                                 source,
                                 1,
                                 GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source)),
@@ -1105,16 +1911,22 @@ void shmem_transport_mswap(shmem_transport_ctx_t* ctx, void *target, const void
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, dest, mask, len, pe,
+                                        FI_MSWAP, datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(len <= sizeof(double _Complex));
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
     do {
-        ret = fi_compare_atomic(ctx->ep,
+        ret = fi_compare_atomic(shmem_transport_ofi_ep(ctx, pe),
                                 source,
                                 1,
                                 GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source)),
@@ -1143,15 +1955,21 @@ void shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, NULL, NULL, len, pe, op,
+                                        datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
     do {
-        ret = fi_inject_atomic(ctx->ep,
+        ret = fi_inject_atomic(shmem_transport_ofi_ep(ctx, pe),
                                source,
                                1,
                                GET_DEST(dst),
@@ -1181,8 +1999,16 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
 
     shmem_internal_assert(SHMEM_Dtsize[dt] * len == full_len);
 
+    if (shmem_transport_ofi_amo_emulated) {
+        for (size_t i = 0; i < len; i++)
+            shmem_transport_ofi_amo_emulate(ctx, (uint8_t *) target + i * SHMEM_Dtsize[dt],
+                                            (const uint8_t *) source + i * SHMEM_Dtsize[dt],
+                                            NULL, NULL, SHMEM_Dtsize[dt], pe, op, datatype);
+        return;
+    }
+
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    ret = fi_atomicvalid(ctx->ep, dt, op,
+    ret = fi_atomicvalid(shmem_transport_ofi_ep(ctx, pe), dt, op,
                          &max_atomic_size);
     max_atomic_size = max_atomic_size * SHMEM_Dtsize[dt];
     if (max_atomic_size > shmem_transport_ofi_max_msg_size
@@ -1199,10 +2025,10 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
 
         polled = 0;
 
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
         do {
-            ret = fi_inject_atomic(ctx->ep,
+            ret = fi_inject_atomic(shmem_transport_ofi_ep(ctx, pe),
                                    source,
                                    len,
                                    GET_DEST(dst),
@@ -1220,7 +2046,7 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
             create_bounce_buffer(ctx, source, full_len);
 
         polled = 0;
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
 
         const struct fi_ioc        msg_iov = { .addr = buff->data, .count = len };
         const struct fi_rma_ioc    rma_iov = { .addr = (uint64_t) addr, .count = len, .key = key };
@@ -1237,7 +2063,7 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
                                                .data          = 0
                                              };
         do {
-            ret = fi_atomicmsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+            ret = fi_atomicmsg(shmem_transport_ofi_ep(ctx, pe), &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
         } while (try_again(ctx, ret, &polled));
 
     } else {
@@ -1248,9 +2074,9 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
             size_t chunksize = MIN((len-sent),
                                    (max_atomic_size/SHMEM_Dtsize[dt]));
             polled = 0;
-            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+            SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
             do {
-                ret = fi_atomic(ctx->ep,
+                ret = fi_atomic(shmem_transport_ofi_ep(ctx, pe),
                                 (void *)((char *)source +
                                          (sent*SHMEM_Dtsize[dt])),
                                 chunksize,
@@ -1285,6 +2111,12 @@ void shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target,
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, dest, NULL, len, pe, op,
+                                        datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
     shmem_internal_assert(len <= sizeof(double _Complex));
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
@@ -1306,10 +2138,10 @@ void shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target,
                                };
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
     do {
-        ret = fi_fetch_atomicmsg(ctx->ep,
+        ret = fi_fetch_atomicmsg(shmem_transport_ofi_ep(ctx, pe),
                                  &msg,
                                  &resultv,
                                  GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(dest)),
@@ -1339,16 +2171,22 @@ void shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target,
     uint64_t key;
     uint8_t *addr;
 
+    if (shmem_transport_ofi_amo_emulated) {
+        shmem_transport_ofi_amo_emulate(ctx, target, source, dest, NULL, len, pe, op,
+                                        datatype);
+        return;
+    }
+
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(len <= sizeof(double _Complex));
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
 
     do {
-        ret = fi_fetch_atomic(ctx->ep,
+        ret = fi_fetch_atomic(shmem_transport_ofi_ep(ctx, pe),
                               source,
                               1,
                               GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source)),
@@ -1366,6 +2204,159 @@ void shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target,
 }
 
 
+/* Elements of an atomic batch whose remote addresses and keys are resolved
+ * before each acquisition of the context lock */
+#define SHMEM_TRANSPORT_OFI_BATCH_CHUNK 64
+
+/* Issue a run of non-fetching atomics to a single PE.  Element i updates
+ * targets[i] with the value at source + i * len.  The remote keys are
+ * resolved outside of the context lock, which is then taken once per
+ * SHMEM_TRANSPORT_OFI_BATCH_CHUNK elements. */
+static inline
+void shmem_transport_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                  const void *source, size_t count, size_t len,
+                                  int pe, int op, int datatype)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled;
+    uint64_t keys[SHMEM_TRANSPORT_OFI_BATCH_CHUNK];
+    uint8_t *addrs[SHMEM_TRANSPORT_OFI_BATCH_CHUNK];
+    size_t i, j, n;
+
+    shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
+
+    if (count == 0) return;
+
+    if (shmem_transport_ofi_amo_emulated) {
+        for (i = 0; i < count; i++)
+            shmem_transport_ofi_amo_emulate(ctx, targets[i], (const uint8_t *) source + i * len,
+                                            NULL, NULL, len, pe, op, datatype);
+        return;
+    }
+
+    for (i = 0; i < count; i += n) {
+        n = MIN(count - i, SHMEM_TRANSPORT_OFI_BATCH_CHUNK);
+
+        /* The first access to a peer may query the runtime for its keys */
+        for (j = 0; j < n; j++)
+            shmem_transport_ofi_get_mr(targets[i + j], pe, &addrs[j], &keys[j]);
+
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        struct fid_ep *ep = shmem_transport_ofi_ep(ctx, pe);
+        fi_addr_t dest = GET_DEST(dst);
+
+        for (j = 0; j < n; j++) {
+            polled = 0;
+            SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_put(ctx, pe));
+
+            do {
+                ret = fi_inject_atomic(ep,
+                                       (const uint8_t *) source + (i + j) * len,
+                                       1,
+                                       dest,
+                                       (uint64_t) addrs[j],
+                                       keys[j],
+                                       SHMEM_TRANSPORT_DTYPE(datatype),
+                                       op);
+            } while (try_again(ctx, ret, &polled));
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+    }
+}
+
+
+/* Fetching counterpart of shmem_transport_atomic_batch; the prior value of
+ * targets[i] is returned at dest + i * len.  Like the single element routine,
+ * the source and dest buffers must remain valid until get_wait. */
+static inline
+void shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                        const void *source, void *dest, size_t count,
+                                        size_t len, int pe, int op, int datatype)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled;
+    uint64_t keys[SHMEM_TRANSPORT_OFI_BATCH_CHUNK];
+    uint8_t *addrs[SHMEM_TRANSPORT_OFI_BATCH_CHUNK];
+    size_t i, j, n;
+
+    shmem_internal_assert(len <= sizeof(double _Complex));
+    shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
+
+    if (count == 0) return;
+
+    if (shmem_transport_ofi_amo_emulated) {
+        for (i = 0; i < count; i++)
+            shmem_transport_ofi_amo_emulate(ctx, targets[i], (const uint8_t *) source + i * len,
+                                            (uint8_t *) dest + i * len, NULL, len, pe, op,
+                                            datatype);
+        return;
+    }
+
+    for (i = 0; i < count; i += n) {
+        n = MIN(count - i, SHMEM_TRANSPORT_OFI_BATCH_CHUNK);
+
+        /* The first access to a peer may query the runtime for its keys */
+        for (j = 0; j < n; j++)
+            shmem_transport_ofi_get_mr(targets[i + j], pe, &addrs[j], &keys[j]);
+
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        struct fid_ep *ep = shmem_transport_ofi_ep(ctx, pe);
+        fi_addr_t fi_dest = GET_DEST(dst);
+
+        for (j = 0; j < n; j++) {
+            const void *src = (const uint8_t *) source + (i + j) * len;
+            void *res = (uint8_t *) dest + (i + j) * len;
+
+            polled = 0;
+            SHMEM_TRANSPORT_OFI_CNTR_INC(shmem_transport_ofi_pending_get(ctx, pe));
+
+#ifdef ENABLE_MR_ENDPOINT
+            /* See shmem_transport_fetch_atomic; CXI requires the injected form */
+            struct fi_ioc resultv = { .addr = res, .count = 1 };
+            const struct fi_ioc sourcev = { .addr = (void *) src, .count = 1 };
+            const struct fi_rma_ioc rmav = { .addr = (uint64_t) addrs[j], .count = 1, .key = keys[j] };
+            const struct fi_msg_atomic msg = {
+                                         .msg_iov       = &sourcev,
+                                         .desc          = GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(source)),
+                                         .iov_count     = 1,
+                                         .addr          = fi_dest,
+                                         .rma_iov       = &rmav,
+                                         .rma_iov_count = 1,
+                                         .datatype      = SHMEM_TRANSPORT_DTYPE(datatype),
+                                         .op            = op,
+                                         .context       = NULL,
+                                         .data          = 0
+                                       };
+
+            do {
+                ret = fi_fetch_atomicmsg(ep, &msg, &resultv,
+                                         GET_MR_DESC_ADDR(shmem_transport_ofi_get_mr_desc_index(dest)),
+                                         1, FI_INJECT);
+            } while (try_again(ctx, ret, &polled));
+#else
+            do {
+                ret = fi_fetch_atomic(ep,
+                                      src,
+                                      1,
+                                      GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(source)),
+                                      res,
+                                      GET_MR_DESC(shmem_transport_ofi_get_mr_desc_index(dest)),
+                                      fi_dest,
+                                      (uint64_t) addrs[j],
+                                      keys[j],
+                                      SHMEM_TRANSPORT_DTYPE(datatype),
+                                      op,
+                                      NULL);
+            } while (try_again(ctx, ret, &polled));
+#endif
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+    }
+}
+
+
 static inline
 void shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target,
                           const void *source, void *dest,
@@ -1429,6 +2420,10 @@ int shmem_transport_atomic_supported(shm_internal_op_t op,
 #else
     size_t size = 0;
 
+    /* Emulated atomics are issued one element at a time */
+    if (shmem_transport_ofi_amo_emulated)
+        return 0;
+
     /* NOTE-MT: It's not clear from the OFI documentation whether this mutex is
      * actually required by FI_THREAD_COMPLETION. */
 
@@ -1489,6 +2484,30 @@ void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
     RAISE_ERROR_STR("OFI transport does not currently support CT operations");
 }
 
+/* Sum of the incoming write counters of the primary NIC and the stripe
+ * rails */
+static inline
+uint64_t shmem_transport_ofi_target_cntr_read(void)
+{
+    uint64_t cnt = 0;
+#if ENABLE_TARGET_CNTR
+    cnt = fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+    for (int i = 0; i < shmem_transport_ofi_num_rails; i++)
+        cnt += fi_cntr_read(shmem_transport_ofi_rails[i].target_cntr);
+#endif
+    return cnt;
+}
+
+/* Emulated atomics are serviced only while this PE polls, so a PE blocked in
+ * the target counter wait would never answer a peer's atomic request.  Rail
+ * counters belong to other domains, so a single counter wait cannot observe
+ * striped writes either. */
+static inline
+int shmem_transport_received_cntr_can_wait(void)
+{
+    return !shmem_transport_ofi_amo_emulated && shmem_transport_ofi_num_rails == 0;
+}
+
 static inline
 uint64_t shmem_transport_received_cntr_get(void)
 {
@@ -1496,7 +2515,7 @@ uint64_t shmem_transport_received_cntr_get(void)
     shmem_internal_assert(shmem_internal_thread_level == SHMEM_THREAD_SINGLE);
     /* NOTE-MT: This is only reachable in single-threaded runs, otherwise
      * we would need a mutex to support FI_THREAD_COMPLETION builds. */
-    return fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+    return shmem_transport_ofi_target_cntr_read();
 #else
     RAISE_ERROR_STR("OFI transport configured for hard polling");
     return 0;
@@ -1510,6 +2529,7 @@ void shmem_transport_received_cntr_wait(uint64_t ge_val)
     shmem_internal_assert(shmem_internal_thread_level == SHMEM_THREAD_SINGLE);
     /* NOTE-MT: This is only reachable in single-threaded runs, otherwise
      * we would need a mutex to support FI_THREAD_COMPLETION builds. */
+    shmem_internal_assert(shmem_transport_ofi_num_rails == 0);
     int ret = fi_cntr_wait(shmem_transport_ofi_target_cntrfd, ge_val, -1);
 
     OFI_CHECK_ERROR(ret);
@@ -1527,12 +2547,34 @@ void shmem_transport_syncmem(void)
      */
 }
 
+/* Sum the issued (pending) or completed counts of the shard endpoints.  Must
+ * be called with the ctx lock held. */
+static inline
+uint64_t shmem_transport_ofi_shards_cnt(shmem_transport_ctx_t *ctx, int is_put, int completed)
+{
+    uint64_t cnt = 0;
+    int i;
+
+    for (i = 0; ctx->shards && i < shmem_transport_ofi_num_shards - 1; i++) {
+        struct shmem_transport_ofi_ctx_shard_t *shard = &ctx->shards[i];
+
+        if (completed)
+            cnt += fi_cntr_read(is_put ? shard->put_cntr : shard->get_cntr);
+        else
+            cnt += SHMEM_TRANSPORT_OFI_CNTR_READ(is_put ? &shard->pending_put_cntr :
+                                                          &shard->pending_get_cntr);
+    }
+
+    return cnt;
+}
+
 static inline
 uint64_t shmem_transport_pcntr_get_issued_write(shmem_transport_ctx_t *ctx)
 {
     uint64_t cnt;
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
     cnt = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr);
+    cnt += shmem_transport_ofi_shards_cnt(ctx, 1, 0);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
     if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER) {
@@ -1549,6 +2591,7 @@ uint64_t shmem_transport_pcntr_get_issued_read(shmem_transport_ctx_t *ctx)
     uint64_t cnt;
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
     cnt = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+    cnt += shmem_transport_ofi_shards_cnt(ctx, 0, 0);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
     return cnt;
 }
@@ -1559,6 +2602,7 @@ uint64_t shmem_transport_pcntr_get_completed_write(shmem_transport_ctx_t *ctx)
     uint64_t cnt;
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
     cnt = fi_cntr_read(ctx->put_cntr);
+    cnt += shmem_transport_ofi_shards_cnt(ctx, 1, 1);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
     if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER) {
@@ -1575,6 +2619,7 @@ uint64_t shmem_transport_pcntr_get_completed_read(shmem_transport_ctx_t *ctx)
     uint64_t cnt;
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
     cnt = fi_cntr_read(ctx->get_cntr);
+    cnt += shmem_transport_ofi_shards_cnt(ctx, 0, 1);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
     return cnt;
 }
@@ -1587,7 +2632,7 @@ uint64_t shmem_transport_pcntr_get_completed_target(void)
 #  ifdef USE_THREAD_COMPLETION
     if (0 == pthread_mutex_lock(&shmem_transport_ofi_progress_lock)) {
 #  endif
-        cnt = fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+        cnt = shmem_transport_ofi_target_cntr_read();
 #  ifdef USE_THREAD_COMPLETION
         pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
     }
@@ -1611,14 +2656,24 @@ void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *p
         pcntr->pending_put = ctx->pending_bb_cntr;
         SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
     }
-    pcntr->completed_put += fi_cntr_read(ctx->put_cntr);
-    pcntr->completed_get = fi_cntr_read(ctx->get_cntr);
+    pcntr->completed_put += fi_cntr_read(ctx->put_cntr) + shmem_transport_ofi_shards_cnt(ctx, 1, 1);
+    pcntr->completed_get = fi_cntr_read(ctx->get_cntr) + shmem_transport_ofi_shards_cnt(ctx, 0, 1);
 
-    pcntr->pending_put += SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr);
-    pcntr->pending_get = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+    pcntr->pending_put += SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+                          shmem_transport_ofi_shards_cnt(ctx, 1, 0);
+    pcntr->pending_get = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr) +
+                         shmem_transport_ofi_shards_cnt(ctx, 0, 0);
 
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
     pcntr->target = shmem_transport_pcntr_get_completed_target();
 }
 
+static inline
+void shmem_transport_pcntr_get_wait(shmem_transport_ctx_t *ctx, shmemx_pcntr_wait_t *wait)
+{
+    wait->spin_ns = wait->yield_ns = wait->block_ns = wait->count = 0;
+    shmem_internal_wait_state_get(&ctx->put_wait_state, wait);
+    shmem_internal_wait_state_get(&ctx->get_wait_state, wait);
+}
+
 #endif /* TRANSPORT_OFI_H */
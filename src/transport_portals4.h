@@ -31,6 +31,17 @@
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #endif
 
+/* With remote virtual addressing a single LE covers all of memory, so the
+ * symmetric heap can grow without appending new LEs */
+#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 1
+#else
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 0
+#endif
+
+/* Memory spaces are not supported by this transport */
+#define SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA 0
+
 extern int shmem_transport_dtype_table[];
 #define SHMEM_TRANSPORT_DTYPE(DTYPE) shmem_transport_dtype_table[(DTYPE)]
 
@@ -1293,6 +1304,12 @@ void shmem_transport_ct_wait(shmem_transport_ct_t *ct, long wait_for)
     }
 }
 
+static inline
+int shmem_transport_received_cntr_can_wait(void)
+{
+    return 1;
+}
+
 static inline
 uint64_t shmem_transport_received_cntr_get(void)
 {
@@ -1420,4 +1437,72 @@ void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *p
     pcntr->target = shmem_transport_pcntr_get_completed_target(); 
 }
 
+static inline
+void shmem_transport_pcntr_get_wait(shmem_transport_ctx_t *ctx, shmemx_pcntr_wait_t *wait)
+{
+    wait->spin_ns = wait->yield_ns = wait->block_ns = wait->count = 0;
+    return;
+}
+
+static inline
+int shmem_transport_register_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_unregister_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_space_register(shmem_internal_space_t *space, int id)
+{
+    RAISE_WARN_STR("Memory spaces are not supported by the Portals 4 transport");
+    return 1;
+}
+
+static inline
+void shmem_transport_space_unregister(shmem_internal_space_t *space, int id)
+{
+    return;
+}
+
+static inline
+int shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_quiet(ctx);
+}
+
+static inline
+int shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_fence(ctx);
+}
+
+static inline
+void shmem_transport_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                  const void *source, size_t count, size_t len,
+                                  int pe, ptl_op_t op, ptl_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_atomic(ctx, targets[i], (const uint8_t *) source + i * len,
+                               len, pe, op, datatype);
+}
+
+static inline
+void shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                        const void *source, void *dest, size_t count,
+                                        size_t len, int pe, ptl_op_t op, ptl_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_fetch_atomic(ctx, targets[i], (const uint8_t *) source + i * len,
+                                     (uint8_t *) dest + i * len, len, pe, op, datatype);
+}
+
 #endif /* TRANSPORT_PORTALS_H */
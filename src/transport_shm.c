@@ -0,0 +1,262 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define SHMEM_INTERNAL_INCLUDE
+#include "shmem.h"
+#include "shmem_internal.h"
+#include "shmem_comm.h"
+#include "runtime.h"
+
+/* Kept short, the share info is exchanged through the runtime KVS */
+#define SHM_PATH_MAX 128
+
+struct share_info_t {
+    char path[SHM_PATH_MAX];
+    int posix;              /* path names a shm_open() object, else a file */
+    size_t heap_len;
+};
+
+struct shmem_transport_shm_peer_info_t *shmem_transport_shm_peers = NULL;
+int shmem_transport_shm_my_rank = -1;
+struct shmem_transport_shm_wake_t *shmem_transport_shm_wake = NULL;
+struct timespec shmem_transport_shm_wake_timeout;
+static struct share_info_t my_info;
+static int my_info_linked = 0;
+
+
+static void
+shmem_transport_shm_heap_unlink(void)
+{
+    if (!my_info_linked) return;
+
+    if (my_info.posix)
+        shm_unlink(my_info.path);
+    else
+        unlink(my_info.path);
+
+    my_info_linked = 0;
+}
+
+
+/* Create the shared memory object backing the local symmetric heap.  Returns
+ * a file descriptor to be mapped by the caller, or -1 on error.  The name
+ * includes a hash of the runtime's job id, so that PIDs reused across jobs do
+ * not collide; an existing object is never removed, since it may belong to a
+ * live job. */
+int
+shmem_transport_shm_heap_create(size_t len)
+{
+    int fd;
+    char errmsg[256];
+    const char *job_id = shmem_runtime_get_job_id();
+    uint64_t job_hash = 14695981039346656037ULL; /* FNV-1a */
+
+    for (; job_id != NULL && *job_id != '\0'; job_id++) {
+        job_hash ^= (unsigned char) *job_id;
+        job_hash *= 1099511628211ULL;
+    }
+
+    snprintf(my_info.path, SHM_PATH_MAX, "/SOS-heap.%d.%016llx.%d",
+             (int) getuid(), (unsigned long long) job_hash, (int) getpid());
+
+    fd = shm_open(my_info.path, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        RAISE_WARN_MSG("shm_open(%s) failed: %s\n", my_info.path,
+                       shmem_util_strerror(errno, errmsg, 256));
+        return -1;
+    }
+    my_info.posix = 1;
+    my_info_linked = 1;
+
+    if (0 != ftruncate(fd, len)) {
+        RAISE_WARN_MSG("Unable to size shared memory object %s to %zuB: %s\n",
+                       my_info.path, len, shmem_util_strerror(errno, errmsg, 256));
+        close(fd);
+        shmem_transport_shm_heap_unlink();
+        return -1;
+    }
+    my_info.heap_len = len;
+
+    return fd;
+}
+
+
+/* Share a symmetric heap that is backed by an existing file (e.g., on a
+ * hugetlbfs mount) */
+int
+shmem_transport_shm_heap_register(const char *path, size_t len)
+{
+    if (strlen(path) >= SHM_PATH_MAX) {
+        RAISE_WARN_MSG("Heap file path too long to share (%s)\n", path);
+        return 1;
+    }
+
+    strcpy(my_info.path, path);
+    my_info.posix = 0;
+    my_info.heap_len = len;
+    my_info_linked = 1;
+
+    return 0;
+}
+
+
+int
+shmem_transport_shm_init(void)
+{
+    int ret;
+
+    if (0 == my_info.heap_len) {
+        RETURN_ERROR_STR("Symmetric heap is not backed by shared memory "
+                         "(SHMEM_SYMMETRIC_HEAP_USE_MALLOC is not supported)");
+        return 1;
+    }
+
+    ret = shmem_runtime_put("shm-heap", &my_info, sizeof(struct share_info_t));
+    if (0 != ret) {
+        RETURN_ERROR_MSG("runtime_put failed: %d\n", ret);
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int
+shmem_transport_shm_startup(void)
+{
+    int ret, i, fd, peer_num, num_on_node;
+    char errmsg[256];
+    struct share_info_t info;
+    void *ptr;
+
+    num_on_node = shmem_runtime_get_node_size();
+    shmem_transport_shm_my_rank = shmem_runtime_get_node_rank(shmem_internal_my_pe);
+
+    /* allocate space for local peers */
+    shmem_transport_shm_peers = calloc(num_on_node,
+                                       sizeof(struct shmem_transport_shm_peer_info_t));
+    if (NULL == shmem_transport_shm_peers) return 1;
+
+    /* get local peer info and map their heaps into our address space ... */
+    for (i = 0 ; i < shmem_internal_num_pes; ++i) {
+        peer_num = shmem_runtime_get_node_rank(i);
+        if (-1 == peer_num) continue;
+
+        if (shmem_internal_my_pe == i) {
+            shmem_transport_shm_peers[peer_num].heap_ptr =
+                shmem_internal_heap_base;
+            continue;
+        }
+
+        ret = shmem_runtime_get(i, "shm-heap", &info, sizeof(struct share_info_t));
+        if (0 != ret) {
+            RETURN_ERROR_MSG("runtime_get failed: %d\n", ret);
+            return 1;
+        }
+
+        if (info.posix)
+            fd = shm_open(info.path, O_RDWR, 0);
+        else
+            fd = open(info.path, O_RDWR);
+        if (fd < 0) {
+            RETURN_ERROR_MSG("could not open heap of PE %d (%s): %s\n", i,
+                             info.path, shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        ptr = mmap(NULL, info.heap_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (MAP_FAILED == ptr) {
+            RETURN_ERROR_MSG("could not map heap of PE %d: %s\n", i,
+                             shmem_util_strerror(errno, errmsg, 256));
+            return 1;
+        }
+
+        shmem_transport_shm_peers[peer_num].heap_ptr = ptr;
+        shmem_transport_shm_peers[peer_num].heap_len = info.heap_len;
+    }
+
+    /* Every PE allocates its wake word at this point, so that it has the
+     * same symmetric address on all PEs */
+    if (shmem_internal_params.SHM_WAIT_FUTEX) {
+#ifdef SHM_HAVE_FUTEX
+        long usec = shmem_internal_params.SHM_WAIT_FUTEX_USEC;
+
+        if (usec <= 0) {
+            RAISE_WARN_MSG("Ignoring bad futex wait timeout (%ld usec)\n", usec);
+            usec = 1000;
+        }
+        shmem_transport_shm_wake_timeout.tv_sec  = usec / 1000000;
+        shmem_transport_shm_wake_timeout.tv_nsec = (usec % 1000000) * 1000;
+
+        shmem_transport_shm_wake = shmem_internal_shmalloc(sizeof(struct shmem_transport_shm_wake_t));
+        if (NULL == shmem_transport_shm_wake) {
+            RETURN_ERROR_STR("Unable to allocate the futex wake word");
+            return 1;
+        }
+        memset(shmem_transport_shm_wake, 0, sizeof(struct shmem_transport_shm_wake_t));
+#else
+        RAISE_WARN_STR("Futex waits are not supported on this platform, "
+                       "ignoring SHMEM_SHM_WAIT_FUTEX");
+#endif
+    }
+
+    /* Once every local peer holds a mapping, drop the name so the segment
+     * is released when the last PE exits, even on abnormal termination */
+    shmem_runtime_barrier();
+    shmem_transport_shm_heap_unlink();
+
+    return 0;
+}
+
+
+int
+shmem_transport_shm_fini(void)
+{
+    int i, peer_num;
+
+    /* The wake word is released along with the heap */
+    shmem_transport_shm_wake = NULL;
+
+    if (NULL != shmem_transport_shm_peers) {
+        for (i = 0 ; i < shmem_internal_num_pes; ++i) {
+            peer_num = shmem_runtime_get_node_rank(i);
+            if (-1 == peer_num) continue;
+            if (shmem_internal_my_pe == i) continue;
+
+            if (NULL != shmem_transport_shm_peers[peer_num].heap_ptr) {
+                munmap(shmem_transport_shm_peers[peer_num].heap_ptr,
+                       shmem_transport_shm_peers[peer_num].heap_len);
+            }
+        }
+        free(shmem_transport_shm_peers);
+        shmem_transport_shm_peers = NULL;
+    }
+
+    shmem_transport_shm_heap_unlink();
+
+    return 0;
+}
@@ -0,0 +1,213 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+#ifndef TRANSPORT_SHM_H
+#define TRANSPORT_SHM_H
+
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "shmem_memcpy.h"
+
+#if defined(__linux__) && defined(SYS_futex)
+#define SHM_HAVE_FUTEX 1
+#endif
+
+/*
+ * POSIX shared memory on-node transport.  The symmetric heap of every PE is
+ * backed by a named shared memory object (see mmap_alloc()), which each
+ * on-node peer maps into its own address space at startup.  Only the heap
+ * can be shared this way; the data segment of a remote PE is not reachable,
+ * so accesses to it are left to the network transport.
+ */
+
+struct shmem_transport_shm_peer_info_t {
+    void *heap_ptr;
+    size_t heap_len;
+};
+
+/* Wake word of a PE whose threads park in waits on local memory (see
+ * SHMEM_SHM_WAIT_FUTEX).  It is allocated from the symmetric heap, so every
+ * on-node peer reaches it through its heap mapping, and because the heap is a
+ * shared mapping, the futex is keyed identically in all processes. */
+struct shmem_transport_shm_wake_t {
+    uint32_t seq;           /* Futex word, advanced by each wakeup */
+    uint32_t waiters;       /* Threads parked or about to park */
+};
+
+extern struct shmem_transport_shm_peer_info_t *shmem_transport_shm_peers;
+extern int shmem_transport_shm_my_rank;
+extern struct shmem_transport_shm_wake_t *shmem_transport_shm_wake;
+extern struct timespec shmem_transport_shm_wake_timeout;
+
+#define SHM_IN_HEAP(target)                                             \
+    (((void*) target >= shmem_internal_heap_base) &&                    \
+     ((char*) target < (char*) shmem_internal_heap_base + shmem_internal_heap_length))
+
+#define SHM_GET_REMOTE_ACCESS(target, rank, ptr)                        \
+    do {                                                                \
+        if (SHM_IN_HEAP(target)) {                                      \
+            ptr = (char*) target - (char*) shmem_internal_heap_base +   \
+                (char*) shmem_transport_shm_peers[rank].heap_ptr;       \
+        } else if (rank == shmem_transport_shm_my_rank) {               \
+            ptr = (void*) target;                                       \
+        } else {                                                        \
+            ptr = NULL;                                                 \
+        }                                                               \
+    } while (0)
+
+int shmem_transport_shm_heap_create(size_t len);
+
+int shmem_transport_shm_heap_register(const char *path, size_t len);
+
+int shmem_transport_shm_init(void);
+
+int shmem_transport_shm_startup(void);
+
+int shmem_transport_shm_fini(void);
+
+
+/* Whether the symmetric object at target on the PE with noderank ID can be
+ * accessed with loads and stores */
+static inline
+int
+shmem_transport_shm_reachable(const void *target, int noderank)
+{
+    return -1 != noderank &&
+           (noderank == shmem_transport_shm_my_rank || SHM_IN_HEAP(target));
+}
+
+
+static inline
+void *
+shmem_transport_shm_ptr(const void *target, int pe, int noderank)
+{
+    char *remote_ptr;
+
+    SHM_GET_REMOTE_ACCESS(target, noderank, remote_ptr);
+    return remote_ptr;
+}
+
+
+static inline
+void
+shmem_transport_shm_put(void *target, const void *source, size_t len,
+                        int pe, int noderank)
+{
+    char *remote_ptr;
+
+    SHM_GET_REMOTE_ACCESS(target, noderank, remote_ptr);
+#ifdef ENABLE_ERROR_CHECKING
+    if (NULL == remote_ptr) {
+        RAISE_ERROR_MSG("target (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) target);
+    }
+#endif
+
+    shmem_internal_shr_memcpy(remote_ptr, source, len);
+}
+
+
+static inline
+void
+shmem_transport_shm_get(void *target, const void *source, size_t len,
+                        int pe, int noderank)
+{
+    char *remote_ptr;
+
+    SHM_GET_REMOTE_ACCESS(source, noderank, remote_ptr);
+#ifdef ENABLE_ERROR_CHECKING
+    if (NULL == remote_ptr) {
+        RAISE_ERROR_MSG("source (0x%"PRIXPTR") outside of symmetric heap\n",
+                        (uintptr_t) source);
+    }
+#endif
+
+    shmem_internal_shr_memcpy(target, remote_ptr, len);
+}
+
+
+/* Wake the threads of the PE with noderank ID that are parked waiting for
+ * local memory to change.  Called after an on-node update of that PE's
+ * memory. */
+static inline
+void
+shmem_transport_shm_wake_peer(int noderank)
+{
+#ifdef SHM_HAVE_FUTEX
+    struct shmem_transport_shm_wake_t *wake;
+    void *ptr;
+
+    if (NULL == shmem_transport_shm_wake) return;
+
+    SHM_GET_REMOTE_ACCESS(shmem_transport_shm_wake, noderank, ptr);
+    wake = ptr;
+
+    /* Order the update before the load of waiters.  Pairs with the fence in
+     * shmem_transport_shm_park_begin(), so either the waiter observes the
+     * update or the update observes the waiter. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (0 == __atomic_load_n(&wake->waiters, __ATOMIC_RELAXED)) return;
+
+    __atomic_fetch_add(&wake->seq, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &wake->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+
+/* Announce a waiter that is about to park.  The caller must check its wait
+ * condition after this call and before shmem_transport_shm_park(), passing
+ * the returned sequence number. */
+static inline
+uint32_t
+shmem_transport_shm_park_begin(void)
+{
+    __atomic_fetch_add(&shmem_transport_shm_wake->waiters, 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return __atomic_load_n(&shmem_transport_shm_wake->seq, __ATOMIC_ACQUIRE);
+}
+
+
+/* Sleep until an on-node update wakes the PE, the wake word has moved past
+ * seq, or the timeout expires.  The timeout bounds the delay for updates
+ * that do not issue a wakeup, e.g., those arriving through the network. */
+static inline
+void
+shmem_transport_shm_park(uint32_t seq)
+{
+#ifdef SHM_HAVE_FUTEX
+    syscall(SYS_futex, &shmem_transport_shm_wake->seq, FUTEX_WAIT, seq,
+            &shmem_transport_shm_wake_timeout, NULL, 0);
+#endif
+}
+
+
+static inline
+void
+shmem_transport_shm_park_end(void)
+{
+    __atomic_fetch_sub(&shmem_transport_shm_wake->waiters, 1, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -47,6 +47,12 @@ struct shmem_transport_ctx_t {
 };
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 
+/* The heap is mapped with ucp_mem_map() at startup and cannot grow */
+#define SHMEM_TRANSPORT_HEAP_GROWABLE 0
+
+/* Memory spaces are not supported by this transport */
+#define SHMEM_TRANSPORT_SPACE_SYMMETRIC_VA 0
+
 typedef struct {
     size_t         addr_len;
     ucp_address_t *addr;
@@ -216,7 +222,7 @@ shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
     ucs_status_t status;
 
-#if defined(USE_CMA) || (defined(USE_XPMEM) && !defined(USE_SHR_ATOMICS))
+#if defined(USE_CMA) || defined(USE_SHM) || (defined(USE_XPMEM) && !defined(USE_SHR_ATOMICS))
     /* Put/get use shared memory and atomics use UCX. Flush to resolve a race
      * across transports. */
     status = ucp_worker_flush(shmem_transport_ucp_worker);
@@ -786,6 +792,15 @@ void shmem_transport_get_ct(shmem_transport_ct_t *ct, void
     RAISE_ERROR_STR("No path to peer");
 }
 
+/**
+ * Whether a waiting PE may block in shmem_transport_received_cntr_wait.
+ */
+static inline
+int shmem_transport_received_cntr_can_wait(void)
+{
+    return 0;
+}
+
 /**
  * Query the value of the transport's received messages counter.
  */
@@ -844,4 +859,72 @@ void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *p
     return;
 }
 
+static inline
+void shmem_transport_pcntr_get_wait(shmem_transport_ctx_t *ctx, shmemx_pcntr_wait_t *wait)
+{
+    wait->spin_ns = wait->yield_ns = wait->block_ns = wait->count = 0;
+    return;
+}
+
+static inline
+int shmem_transport_register_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_unregister_buffer(const void *addr, size_t len)
+{
+    return 0;
+}
+
+static inline
+int shmem_transport_space_register(shmem_internal_space_t *space, int id)
+{
+    RAISE_WARN_STR("Memory spaces are not supported by the UCX transport");
+    return 1;
+}
+
+static inline
+void shmem_transport_space_unregister(shmem_internal_space_t *space, int id)
+{
+    return;
+}
+
+static inline
+int shmem_transport_quiet_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_quiet(ctx);
+}
+
+static inline
+int shmem_transport_fence_pe(shmem_transport_ctx_t* ctx, int pe)
+{
+    return shmem_transport_fence(ctx);
+}
+
+static inline
+void shmem_transport_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                  const void *source, size_t count, size_t len,
+                                  int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_atomic(ctx, targets[i], (const uint8_t *) source + i * len,
+                               len, pe, op, datatype);
+}
+
+static inline
+void shmem_transport_fetch_atomic_batch(shmem_transport_ctx_t* ctx, void *const *targets,
+                                        const void *source, void *dest, size_t count,
+                                        size_t len, int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        shmem_transport_fetch_atomic(ctx, targets[i], (const uint8_t *) source + i * len,
+                                     (uint8_t *) dest + i * len, len, pe, op, datatype);
+}
+
 #endif /* TRANSPORT_UCX_H */
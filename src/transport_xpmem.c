@@ -39,6 +39,17 @@ struct share_info_t {
 struct shmem_transport_xpmem_peer_info_t *shmem_transport_xpmem_peers = NULL;
 static struct share_info_t my_info;
 
+static int num_on_node = 0;
+static int *peer_pes = NULL;            /* PE of each noderank */
+static uint64_t *peer_attach_seq = NULL;
+static uint64_t attach_seq = 0;
+static int num_attached = 0;
+static long max_attached = 0;
+
+#ifdef ENABLE_THREADS
+static shmem_internal_mutex_t shmem_transport_xpmem_attach_lock;
+#endif
+
 #define FIND_BASE(ptr, page_size) ((char*) (((uintptr_t) ptr / page_size) * page_size))
 #define FIND_LEN(ptr, len, page_size) ((((char*) ptr - FIND_BASE(ptr, page_size) + len - 1) / \
                                         page_size + 1) * page_size)
@@ -64,9 +75,9 @@ shmem_transport_xpmem_init(void)
     my_info.data_off = (char*) shmem_internal_data_base - (char*) base;
     my_info.data_len = len;
 
-    /* setup heap region */
+    /* setup heap region, including any address space reserved for growth */
     base = FIND_BASE(shmem_internal_heap_base, page_size);
-    len = FIND_LEN(shmem_internal_heap_base, shmem_internal_heap_length, page_size);
+    len = FIND_LEN(shmem_internal_heap_base, shmem_internal_heap_reserve, page_size);
     my_info.heap_seg = xpmem_make(base, len, XPMEM_PERMIT_MODE, (void*)0666);
     if (-1 == my_info.heap_seg) {
         RETURN_ERROR_MSG("xpmem_make failed: %s\n",
@@ -86,80 +97,155 @@ shmem_transport_xpmem_init(void)
 }
 
 
-int
-shmem_transport_xpmem_startup(void)
+/* Detach the peer with noderank ID.  Caller holds the attach lock. */
+static void
+shmem_transport_xpmem_detach(int rank)
 {
-    int ret, i, peer_num, num_on_node;
-    char errmsg[256];
+    struct shmem_transport_xpmem_peer_info_t *peer = &shmem_transport_xpmem_peers[rank];
+
+    if (NULL == peer->heap_ptr) return;
+
+    __atomic_store_n(&peer->heap_ptr, NULL, __ATOMIC_RELEASE);
+    peer->data_ptr = NULL;
+
+    if (NULL != peer->data_attach_ptr) xpmem_detach(peer->data_attach_ptr);
+    if (0 != peer->data_apid) xpmem_release(peer->data_apid);
+    if (NULL != peer->heap_attach_ptr) xpmem_detach(peer->heap_attach_ptr);
+    if (0 != peer->heap_apid) xpmem_release(peer->heap_apid);
+
+    peer->data_attach_ptr = peer->heap_attach_ptr = NULL;
+    peer->data_apid = peer->heap_apid = 0;
+    peer_attach_seq[rank] = 0;
+    num_attached--;
+}
+
+
+/* Detach the least recently attached peer whose pointers were not handed
+ * out to the user.  Caller holds the attach lock. */
+static void
+shmem_transport_xpmem_evict(void)
+{
+    int i, victim = -1;
+
+    for (i = 0; i < num_on_node; i++) {
+        if (NULL == shmem_transport_xpmem_peers[i].heap_ptr ||
+            shmem_transport_xpmem_peers[i].pinned)
+            continue;
+        if (-1 == victim || peer_attach_seq[i] < peer_attach_seq[victim])
+            victim = i;
+    }
+
+    if (-1 != victim) {
+        DEBUG_MSG("Detaching idle XPMEM peer PE %d\n", peer_pes[victim]);
+        shmem_transport_xpmem_detach(victim);
+    }
+}
+
+
+void
+shmem_transport_xpmem_attach(int rank)
+{
+    struct shmem_transport_xpmem_peer_info_t *peer = &shmem_transport_xpmem_peers[rank];
     struct share_info_t info;
     struct xpmem_addr addr;
+    char errmsg[256];
+    void *heap_ptr;
+    int ret;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_xpmem_attach_lock);
+
+    /* Another thread may have attached while we waited */
+    if (NULL != peer->heap_ptr) {
+        SHMEM_MUTEX_UNLOCK(shmem_transport_xpmem_attach_lock);
+        return;
+    }
+
+    if (max_attached > 0 && num_attached >= max_attached)
+        shmem_transport_xpmem_evict();
+
+    SHMEM_MUTEX_LOCK(shmem_internal_mutex_runtime);
+    ret = shmem_runtime_get(peer_pes[rank], "xpmem-segids", &info, sizeof(struct share_info_t));
+    SHMEM_MUTEX_UNLOCK(shmem_internal_mutex_runtime);
+    if (0 != ret) {
+        RAISE_ERROR_MSG("runtime_get failed: %d\n", ret);
+    }
+
+    peer->data_apid = xpmem_get(info.data_seg, XPMEM_RDWR, XPMEM_PERMIT_MODE, (void*)0666);
+    if (peer->data_apid < 0) {
+        RAISE_ERROR_MSG("could not get data apid: %s\n",
+                        shmem_util_strerror(errno, errmsg, 256));
+    }
+
+    addr.apid = peer->data_apid;
+    addr.offset = 0;
+
+    peer->data_attach_ptr = xpmem_attach(addr, info.data_len, NULL);
+    if ((void *) -1 == peer->data_attach_ptr) {
+        RAISE_ERROR_MSG("could not get data segment: %s\n",
+                        shmem_util_strerror(errno, errmsg, 256));
+    }
+    peer->data_ptr = (char*) peer->data_attach_ptr + info.data_off;
+
+    peer->heap_apid = xpmem_get(info.heap_seg, XPMEM_RDWR, XPMEM_PERMIT_MODE, (void*)0666);
+    if (peer->heap_apid < 0) {
+        RAISE_ERROR_MSG("could not get heap apid: %s\n",
+                        shmem_util_strerror(errno, errmsg, 256));
+    }
+
+    addr.apid = peer->heap_apid;
+    addr.offset = 0;
+
+    peer->heap_attach_ptr = xpmem_attach(addr, info.heap_len, NULL);
+    if ((void *) -1 == peer->heap_attach_ptr) {
+        RAISE_ERROR_MSG("could not get heap segment: %s\n",
+                        shmem_util_strerror(errno, errmsg, 256));
+    }
+    heap_ptr = (char*) peer->heap_attach_ptr + info.heap_off;
+
+    peer_attach_seq[rank] = ++attach_seq;
+    num_attached++;
+
+    /* Publish last; readers check heap_ptr before using data_ptr */
+    __atomic_store_n(&peer->heap_ptr, heap_ptr, __ATOMIC_RELEASE);
+
+    SHMEM_MUTEX_UNLOCK(shmem_transport_xpmem_attach_lock);
+}
+
+
+int
+shmem_transport_xpmem_startup(void)
+{
+    int i, peer_num;
 
     num_on_node = shmem_runtime_get_node_size();
 
-    /* allocate space for local peers */
+    /* allocate space for local peers, segments are attached on first use */
     shmem_transport_xpmem_peers = calloc(num_on_node,
                                          sizeof(struct shmem_transport_xpmem_peer_info_t));
-    if (NULL == shmem_transport_xpmem_peers) return 1;
+    peer_pes = malloc(num_on_node * sizeof(int));
+    peer_attach_seq = calloc(num_on_node, sizeof(uint64_t));
+    if (NULL == shmem_transport_xpmem_peers || NULL == peer_pes ||
+        NULL == peer_attach_seq)
+        return 1;
 
-    /* get local peer info and map into our address space ... */
     for (i = 0 ; i < shmem_internal_num_pes; ++i) {
         peer_num = shmem_runtime_get_node_rank(i);
         if (-1 == peer_num) continue;
+        peer_pes[peer_num] = i;
+    }
 
-        if (shmem_internal_my_pe == i) {
-            shmem_transport_xpmem_peers[peer_num].data_ptr =
-                shmem_internal_data_base;
-            shmem_transport_xpmem_peers[peer_num].heap_ptr =
-                shmem_internal_heap_base;
-        } else {
-            ret = shmem_runtime_get(i, "xpmem-segids", &info, sizeof(struct share_info_t));
-            if (0 != ret) {
-                RETURN_ERROR_MSG("runtime_get failed: %d\n", ret);
-                return 1;
-            }
-
-            shmem_transport_xpmem_peers[peer_num].data_apid =
-                xpmem_get(info.data_seg, XPMEM_RDWR, XPMEM_PERMIT_MODE, (void*)0666);
-            if (shmem_transport_xpmem_peers[peer_num].data_apid < 0) {
-                RETURN_ERROR_MSG("could not get data apid: %s\n",
-                                 shmem_util_strerror(errno, errmsg, 256));
-                return 1;
-            }
-
-            addr.apid = shmem_transport_xpmem_peers[peer_num].data_apid;
-            addr.offset = 0;
-
-            shmem_transport_xpmem_peers[peer_num].data_attach_ptr =
-                xpmem_attach(addr, info.data_len, NULL);
-            if ((size_t) shmem_transport_xpmem_peers[peer_num].data_ptr == XPMEM_MAXADDR_SIZE) {
-                RETURN_ERROR_MSG("could not get data segment: %s\n",
-                                 shmem_util_strerror(errno, errmsg, 256));
-                return 1;
-            }
-            shmem_transport_xpmem_peers[peer_num].data_ptr =
-                (char*) shmem_transport_xpmem_peers[peer_num].data_attach_ptr + info.data_off;
-
-            shmem_transport_xpmem_peers[peer_num].heap_apid =
-                xpmem_get(info.heap_seg, XPMEM_RDWR, XPMEM_PERMIT_MODE, (void*)0666);
-            if (shmem_transport_xpmem_peers[peer_num].heap_apid < 0) {
-                RETURN_ERROR_MSG("could not get heap apid: %s\n",
-                                 shmem_util_strerror(errno, errmsg, 256));
-                return 1;
-            }
-
-            addr.apid = shmem_transport_xpmem_peers[peer_num].heap_apid;
-            addr.offset = 0;
-
-            shmem_transport_xpmem_peers[peer_num].heap_attach_ptr =
-                xpmem_attach(addr, info.heap_len, NULL);
-            if ((size_t) shmem_transport_xpmem_peers[peer_num].heap_ptr == XPMEM_MAXADDR_SIZE) {
-                RETURN_ERROR_MSG("could not get data segment: %s\n",
-                                 shmem_util_strerror(errno, errmsg, 256));
-                return 1;
-            }
-            shmem_transport_xpmem_peers[peer_num].heap_ptr =
-                (char*) shmem_transport_xpmem_peers[peer_num].heap_attach_ptr + info.heap_off;
-        }
+    peer_num = shmem_runtime_get_node_rank(shmem_internal_my_pe);
+    shmem_transport_xpmem_peers[peer_num].data_ptr = shmem_internal_data_base;
+    shmem_transport_xpmem_peers[peer_num].heap_ptr = shmem_internal_heap_base;
+    shmem_transport_xpmem_peers[peer_num].pinned = 1;
+
+    SHMEM_MUTEX_INIT(shmem_transport_xpmem_attach_lock);
+
+    max_attached = shmem_internal_params.XPMEM_MAX_ATTACHED;
+    if (max_attached > 0 && shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE) {
+        /* Another thread could be copying through a mapping we detach */
+        RAISE_WARN_STR("Ignoring SHMEM_XPMEM_MAX_ATTACHED with SHMEM_THREAD_MULTIPLE");
+        max_attached = 0;
     }
 
     return 0;
@@ -169,31 +255,19 @@ shmem_transport_xpmem_startup(void)
 int
 shmem_transport_xpmem_fini(void)
 {
-    int i, peer_num;
+    int i;
 
     if (NULL != shmem_transport_xpmem_peers) {
-        for (i = 0 ; i < shmem_internal_num_pes; ++i) {
-            peer_num = shmem_runtime_get_node_rank(i);
-            if (-1 == peer_num) continue;
-            if (shmem_internal_my_pe == i) continue;
-
-            if (NULL != shmem_transport_xpmem_peers[peer_num].data_ptr) {
-                xpmem_detach(shmem_transport_xpmem_peers[peer_num].data_attach_ptr);
-            }
-
-            if (0 != shmem_transport_xpmem_peers[peer_num].data_apid) {
-                xpmem_release(shmem_transport_xpmem_peers[peer_num].data_apid);
-            }
-
-            if (NULL != shmem_transport_xpmem_peers[peer_num].heap_ptr) {
-                xpmem_detach(shmem_transport_xpmem_peers[peer_num].heap_attach_ptr);
-            }
-
-            if (0 != shmem_transport_xpmem_peers[peer_num].heap_apid) {
-                xpmem_release(shmem_transport_xpmem_peers[peer_num].heap_apid);
-            }
+        for (i = 0 ; i < num_on_node; ++i) {
+            if (peer_pes[i] == shmem_internal_my_pe) continue;
+            shmem_transport_xpmem_detach(i);
         }
         free(shmem_transport_xpmem_peers);
+        free(peer_pes);
+        free(peer_attach_seq);
+        shmem_transport_xpmem_peers = NULL;
+
+        SHMEM_MUTEX_DESTROY(shmem_transport_xpmem_attach_lock);
     }
 
     if (0 != my_info.data_seg) {
@@ -205,4 +279,3 @@ shmem_transport_xpmem_fini(void)
 
     return 0;
 }
-
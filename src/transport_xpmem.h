@@ -20,20 +20,34 @@
 #include <inttypes.h>
 #include <xpmem.h>
 
+#include "shmem_memcpy.h"
+
 struct shmem_transport_xpmem_peer_info_t {
     xpmem_apid_t data_apid;
     xpmem_apid_t heap_apid;
     void *data_attach_ptr;
     void *heap_attach_ptr;
     void *data_ptr;
-    void *heap_ptr;
+    void *heap_ptr;         /* NULL until the peer is attached */
+    int pinned;             /* Pointers were handed out by shmem_ptr() */
 };
 
 extern struct shmem_transport_xpmem_peer_info_t *shmem_transport_xpmem_peers;
 
+/* Attach the segments of the peer with noderank ID on first access */
+void shmem_transport_xpmem_attach(int rank);
+
+#define XPMEM_ENSURE_ATTACHED(rank)                                     \
+    do {                                                                \
+        if (__builtin_expect(NULL == __atomic_load_n(&shmem_transport_xpmem_peers[rank].heap_ptr, \
+                                                     __ATOMIC_ACQUIRE), 0)) \
+            shmem_transport_xpmem_attach(rank);                         \
+    } while (0)
+
 #ifdef ENABLE_ERROR_CHECKING
 #define XPMEM_GET_REMOTE_ACCESS(target, rank, ptr)                      \
     do {                                                                \
+        XPMEM_ENSURE_ATTACHED(rank);                                    \
         if (((void*) target > shmem_internal_data_base) &&              \
             ((char*) target < (char*) shmem_internal_data_base + shmem_internal_data_length)) { \
             ptr = (char*) target - (char*) shmem_internal_data_base +   \
@@ -49,6 +63,7 @@ extern struct shmem_transport_xpmem_peer_info_t *shmem_transport_xpmem_peers;
 #else
 #define XPMEM_GET_REMOTE_ACCESS(target, rank, ptr)                      \
     do {                                                                \
+        XPMEM_ENSURE_ATTACHED(rank);                                    \
         if ((void*) target < shmem_internal_heap_base) {                \
             ptr = (char*) target - (char*) shmem_internal_data_base +   \
                 (char*) shmem_transport_xpmem_peers[rank].data_ptr;     \
@@ -73,6 +88,11 @@ shmem_transport_xpmem_ptr(const void *target, int pe, int noderank)
     char *remote_ptr;
 
     XPMEM_GET_REMOTE_ACCESS(target, noderank, remote_ptr);
+
+    /* The caller may keep this pointer, never detach the peer */
+    if (!shmem_transport_xpmem_peers[noderank].pinned)
+        __atomic_store_n(&shmem_transport_xpmem_peers[noderank].pinned, 1, __ATOMIC_RELAXED);
+
     return remote_ptr;
 }
 
@@ -92,7 +112,7 @@ shmem_transport_xpmem_put(void *target, const void *source, size_t len,
     }
 #endif
 
-    memcpy(remote_ptr, source, len);
+    shmem_internal_shr_memcpy(remote_ptr, source, len);
 }
 
 
@@ -111,7 +131,7 @@ shmem_transport_xpmem_get(void *target, const void *source, size_t len,
     }
 #endif
 
-    memcpy(target, remote_ptr, len);
+    shmem_internal_shr_memcpy(target, remote_ptr, len);
 }
 
 #endif
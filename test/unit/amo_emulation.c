@@ -0,0 +1,99 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Atomics under software emulation (SHMEM_OFI_ATOMIC_EMULATION=on).  The
+ * target of an emulated atomic must service it while it is itself blocked
+ * in a barrier or a wait, so PE 0 only synchronizes while the other PEs
+ * update its memory.  Other transports ignore the setting.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define NITER 500
+
+int
+main(void)
+{
+    long *counter, *done, *ticket;
+    int me, npes, i, errors = 0;
+
+    setenv("SHMEM_OFI_ATOMIC_EMULATION", "on", 1);
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    counter = shmem_calloc(1, sizeof(long));
+    done = shmem_calloc(1, sizeof(long));
+    ticket = shmem_calloc(NITER, sizeof(long));
+
+    /* PE 0 waits in a barrier while the others update it */
+    if (me != 0) {
+        for (i = 0; i < NITER; i++)
+            shmem_long_atomic_inc(counter, 0);
+    }
+    shmem_barrier_all();
+
+    if (me == 0 && *counter != (long) (npes - 1) * NITER) {
+        printf("Counter is %ld after barrier, expected %ld\n", *counter,
+               (long) (npes - 1) * NITER);
+        errors++;
+    }
+    shmem_barrier_all();
+
+    /* Fetching atomics, with PE 0 waiting for the last one */
+    if (me != 0) {
+        for (i = 0; i < NITER; i++) {
+            long t = shmem_long_atomic_fetch_inc(counter, 0);
+
+            if (t < (long) (npes - 1) * NITER || t >= (long) 2 * (npes - 1) * NITER) {
+                printf("%d: fetched ticket %ld out of range\n", me, t);
+                errors++;
+            }
+        }
+        shmem_long_atomic_add(done, 1, 0);
+    } else {
+        shmem_long_wait_until(done, SHMEM_CMP_EQ, npes - 1);
+        if (*counter != (long) 2 * (npes - 1) * NITER) {
+            printf("Counter is %ld after wait, expected %ld\n", *counter,
+                   (long) 2 * (npes - 1) * NITER);
+            errors++;
+        }
+    }
+
+    /* Every PE, including PE 0, is both source and target; each ticket of
+     * each PE is incremented by exactly one PE */
+    shmem_barrier_all();
+    for (i = 0; i < NITER; i++)
+        shmem_long_atomic_inc(&ticket[i], (me + i) % npes);
+    shmem_barrier_all();
+
+    for (i = 0; i < NITER; i++) {
+        if (ticket[i] != 1) {
+            printf("%d: ticket %d is %ld, expected 1\n", me, i, ticket[i]);
+            errors++;
+        }
+    }
+
+    shmem_free(ticket);
+    shmem_free(done);
+    shmem_free(counter);
+    shmem_finalize();
+    return errors != 0;
+}
@@ -0,0 +1,108 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Batched scattered atomic add and fetch-add.  Batches are longer than the
+ * transport's internal chunk and scatter over all PEs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define NCOUNTERS 16
+#define NBATCH    200
+
+int
+main(void)
+{
+    long *counters, *slots;
+    long *targets[NBATCH];
+    long values[NBATCH], fetched[NBATCH], expected;
+    int pes[NBATCH];
+    int me, npes, i, k, errors = 0;
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    counters = shmem_calloc(NCOUNTERS, sizeof(long));
+    /* NBATCH slots per PE */
+    slots = shmem_calloc((size_t) npes * NBATCH, sizeof(long));
+
+    /* Contended adds; several entries of a batch hit the same counter */
+    for (k = 0; k < NBATCH; k++) {
+        targets[k] = &counters[k % NCOUNTERS];
+        values[k] = k + 1;
+        pes[k] = (me + k) % npes;
+    }
+
+    shmemx_long_atomic_add_batch(targets, values, pes, NBATCH);
+    shmem_barrier_all();
+
+    for (i = 0; i < NCOUNTERS; i++) {
+        expected = 0;
+        for (k = 0; k < NBATCH; k++) {
+            int src;
+
+            if (k % NCOUNTERS != i) continue;
+            for (src = 0; src < npes; src++)
+                if ((src + k) % npes == me) expected += k + 1;
+        }
+        if (counters[i] != expected) {
+            printf("%d: counter %d is %ld, expected %ld\n", me, i,
+                   counters[i], expected);
+            errors++;
+        }
+    }
+
+    /* Fetch-adds on slots owned by this PE, so the fetched values are known */
+    for (k = 0; k < NBATCH; k++) {
+        targets[k] = &slots[me * NBATCH + k];
+        values[k] = k + 1;
+        pes[k] = (me + k) % npes;
+    }
+
+    for (i = 0; i < 2; i++) {
+        shmemx_ctx_long_atomic_fetch_add_batch(SHMEM_CTX_DEFAULT, fetched,
+                                               targets, values, pes, NBATCH);
+        for (k = 0; k < NBATCH; k++) {
+            if (fetched[k] != (long) i * (k + 1)) {
+                printf("%d: round %d, fetched[%d] is %ld, expected %ld\n", me,
+                       i, k, fetched[k], (long) i * (k + 1));
+                errors++;
+            }
+        }
+    }
+
+    shmem_barrier_all();
+
+    for (i = 0; i < npes; i++) {
+        for (k = 0; k < NBATCH; k++) {
+            if ((i + k) % npes != me) continue;
+            if (slots[i * NBATCH + k] != 2 * (k + 1)) {
+                printf("%d: slot [%d][%d] is %ld, expected %d\n", me, i, k,
+                       slots[i * NBATCH + k], 2 * (k + 1));
+                errors++;
+            }
+        }
+    }
+
+    shmem_free(slots);
+    shmem_free(counters);
+    shmem_finalize();
+    return errors != 0;
+}
@@ -0,0 +1,93 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Mutual exclusion with the context lock routines.  Every PE increments a
+ * counter on PE 0 under each of several locks, through a private context,
+ * and then once more under each lock acquired with shmemx_ctx_test_lock.
+ * Built once per SHMEM_LOCK_PLACEMENT setting, see Makefile.am.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define NLOCKS 4
+#define NITER  100
+
+int
+main(void)
+{
+    shmem_ctx_t ctx;
+    long *locks, *counters;
+    int me, npes, i, j, errors = 0;
+
+#ifdef LOCK_PLACEMENT
+    setenv("SHMEM_LOCK_PLACEMENT", LOCK_PLACEMENT, 1);
+#endif
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    locks = shmem_calloc(NLOCKS, sizeof(long));
+    counters = shmem_calloc(NLOCKS, sizeof(long));
+
+    if (shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx))
+        ctx = SHMEM_CTX_DEFAULT;
+
+    for (i = 0; i < NITER; i++) {
+        for (j = 0; j < NLOCKS; j++) {
+            long val;
+
+            shmemx_ctx_set_lock(ctx, &locks[j]);
+            val = shmem_ctx_long_g(ctx, &counters[j], 0);
+            shmem_ctx_long_p(ctx, &counters[j], val + 1, 0);
+            /* Completes the update before the lock is released */
+            shmemx_ctx_clear_lock(ctx, &locks[j]);
+        }
+    }
+
+    for (j = 0; j < NLOCKS; j++) {
+        long val;
+
+        while (shmemx_ctx_test_lock(ctx, &locks[j]))
+            ;
+        val = shmem_ctx_long_g(ctx, &counters[j], 0);
+        shmem_ctx_long_p(ctx, &counters[j], val + 1, 0);
+        shmemx_ctx_clear_lock(ctx, &locks[j]);
+    }
+
+    shmem_barrier_all();
+
+    if (me == 0) {
+        for (j = 0; j < NLOCKS; j++) {
+            if (counters[j] != (long) npes * (NITER + 1)) {
+                printf("Lock %d: counter is %ld, expected %ld\n", j,
+                       counters[j], (long) npes * (NITER + 1));
+                errors++;
+            }
+        }
+    }
+
+    if (ctx != SHMEM_CTX_DEFAULT)
+        shmem_ctx_destroy(ctx);
+
+    shmem_free(counters);
+    shmem_free(locks);
+    shmem_finalize();
+    return errors != 0;
+}
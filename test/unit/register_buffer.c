@@ -0,0 +1,106 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Large puts and gets from registered non-symmetric buffers.  A buffer is
+ * registered, used, unregistered and freed, and a new buffer (often at the
+ * same address) is then registered and used, which must not reuse the stale
+ * registration.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define LEN (256 * 1024)
+
+static int
+check(const char *what, const unsigned char *buf, int pe, int round)
+{
+    size_t i;
+
+    for (i = 0; i < LEN; i++) {
+        if (buf[i] != (unsigned char) (pe * 16 + round + i)) {
+            printf("%d: %s round %d: byte %zu is %d, expected %d\n",
+                   shmem_my_pe(), what, round, i, buf[i],
+                   (unsigned char) (pe * 16 + round + i));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+transfer(unsigned char *dest, unsigned char *buf, int round)
+{
+    int me = shmem_my_pe(), npes = shmem_n_pes();
+    int next = (me + 1) % npes, prev = (me + npes - 1) % npes;
+    int errors = 0;
+    size_t i;
+
+    for (i = 0; i < LEN; i++)
+        buf[i] = (unsigned char) (me * 16 + round + i);
+
+    shmem_putmem(dest, buf, LEN, next);
+    shmem_barrier_all();
+    errors += check("put", dest, prev, round);
+
+    memset(buf, 0, LEN);
+    shmem_getmem(buf, dest, LEN, next);
+    errors += check("get", buf, me, round);
+
+    shmem_barrier_all();
+    return errors;
+}
+
+int
+main(void)
+{
+    unsigned char *dest, *buf;
+    int errors = 0;
+
+    setenv("SHMEM_OFI_MR_CACHE", "hint", 1);
+
+    shmem_init();
+
+    dest = shmem_malloc(LEN);
+
+    buf = malloc(LEN);
+    if (shmemx_register_buffer(buf, LEN)) errors++;
+    /* Registering a buffer again, or part of it, is allowed */
+    if (shmemx_register_buffer(buf, LEN)) errors++;
+    if (shmemx_register_buffer(buf + LEN / 2, LEN / 4)) errors++;
+    errors += transfer(dest, buf, 1);
+    if (shmemx_unregister_buffer(buf, LEN)) errors++;
+    free(buf);
+
+    buf = malloc(LEN);
+    if (shmemx_register_buffer(buf, LEN)) errors++;
+    errors += transfer(dest, buf, 2);
+    if (shmemx_unregister_buffer(buf, LEN)) errors++;
+
+    /* Unregistered buffers still work, and unregistering them is harmless */
+    errors += transfer(dest, buf, 3);
+    if (shmemx_unregister_buffer(buf, LEN)) errors++;
+    free(buf);
+
+    shmem_free(dest);
+    shmem_finalize();
+
+    return errors != 0;
+}
@@ -0,0 +1,143 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Point-to-point synchronization under a wait policy.  Each PE passes data
+ * around a ring with put-with-signal, atomics, and bulk puts, and waits for
+ * its predecessor with the wait and signal routines.  Built once per
+ * SHMEM_WAIT_POLICY setting and once with SHMEM_SHM_WAIT_FUTEX, see
+ * Makefile.am.
+ *
+ * With SHMEM_SHM_WAIT_FUTEX, a parked wait sleeps until it is woken by an
+ * on-node update or its timeout expires.  The timeout is made much longer
+ * than the test, so that an update path that does not wake the waiter
+ * (e.g., a bulk put) shows up as a failure rather than a slow run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define NITER     20
+#define NFLAGS    8
+#define BULK      (64 * 1024)
+#define MAX_SEC   10.0
+
+long src[BULK];
+
+static double
+now(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int
+main(void)
+{
+    uint64_t *sig;
+    long *data, *count, *bulk;
+    int *flags;
+    int me, npes, next, prev, i, j, errors = 0;
+    double start, elapsed;
+
+#ifdef WAIT_POLICY
+    setenv("SHMEM_WAIT_POLICY", WAIT_POLICY, 1);
+#endif
+#ifdef WAIT_FUTEX
+    setenv("SHMEM_SHM_WAIT_FUTEX", "1", 1);
+    setenv("SHMEM_SHM_WAIT_FUTEX_USEC", "5000000", 1);
+#endif
+
+    shmem_init();
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+    next = (me + 1) % npes;
+    prev = (me + npes - 1) % npes;
+
+    sig = shmem_calloc(1, sizeof(uint64_t));
+    data = shmem_calloc(16, sizeof(long));
+    count = shmem_calloc(1, sizeof(long));
+    flags = shmem_calloc(NFLAGS, sizeof(int));
+    bulk = shmem_calloc(BULK, sizeof(long));
+
+    shmem_barrier_all();
+    start = now();
+
+    for (i = 1; i <= NITER; i++) {
+        size_t idx;
+
+        /* Put-with-signal */
+        for (j = 0; j < 16; j++)
+            src[j] = me * 1000 + i * 16 + j;
+        shmem_long_put_signal(data, src, 16, sig, i, SHMEM_SIGNAL_SET, next);
+        shmem_signal_wait_until(sig, SHMEM_CMP_EQ, i);
+        for (j = 0; j < 16; j++) {
+            if (data[j] != prev * 1000 + i * 16 + j) {
+                printf("%d: iteration %d, data[%d] is %ld\n", me, i, j, data[j]);
+                errors++;
+            }
+        }
+
+        /* Atomic updates */
+        shmem_long_atomic_inc(count, next);
+        shmem_long_wait_until(count, SHMEM_CMP_EQ, i);
+
+        shmem_int_atomic_set(&flags[i % NFLAGS], 1, next);
+        idx = shmem_int_wait_until_any(flags, NFLAGS, NULL, SHMEM_CMP_NE, 0);
+        if (idx != (size_t) (i % NFLAGS)) {
+            printf("%d: iteration %d, wait_until_any returned %zu\n", me, i, idx);
+            errors++;
+        }
+        flags[idx] = 0;
+
+        /* Bulk put; the waiter polls the last element written */
+        for (j = 0; j < BULK; j++)
+            src[j] = i;
+        shmem_long_put(bulk, src, BULK, next);
+        shmem_long_wait_until(&bulk[BULK - 1], SHMEM_CMP_EQ, i);
+
+        /* Keeps the source and flags from being reused early */
+        shmem_barrier_all();
+    }
+
+    elapsed = now() - start;
+    if (elapsed > MAX_SEC) {
+        printf("%d: test took %.1f s, a waiter was probably not woken\n", me,
+               elapsed);
+        errors++;
+    }
+
+    for (j = 0; j < BULK; j++) {
+        if (bulk[j] != NITER) {
+            printf("%d: bulk[%d] is %ld, expected %d\n", me, j, bulk[j], NITER);
+            errors++;
+            break;
+        }
+    }
+
+    shmem_free(bulk);
+    shmem_free(flags);
+    shmem_free(count);
+    shmem_free(data);
+    shmem_free(sig);
+    shmem_finalize();
+    return errors != 0;
+}